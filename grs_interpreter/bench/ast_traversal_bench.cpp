@@ -0,0 +1,148 @@
+// Traversal time of the pointer AST against the flat (index-based) AST.
+// Build with -DGRS_BUILD_BENCHMARKS=ON and run ./ast_traversal_bench [lines].
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "ast/flat_ast.hpp"
+#include "ast/visitor.hpp"
+#include "interpreter/instruction_generator.hpp"
+#include "lexer/lexer.hpp"
+#include "lexer/source_buffer.hpp"
+#include "parser/parser.hpp"
+
+namespace {
+
+// Expression-heavy statements, like tests/general_system_test.txt
+std::string makeProgram(size_t lines){
+    std::string text = "DEF bench()\n";
+    text += "DECL POS P1 := {x 25, y 222.5, z 2, a 10.0, b 3.0, c 1000}\n";
+    text += "DECL REAL b := 20.6\n";
+    size_t line = 3;
+    while(line < lines){
+        const std::string n = std::to_string(line);
+        text += "DECL INT c" + n + " := " + n + " + 2 * 3\n";
+        text += "c" + n + " := b + c" + n + " * 2 - (b / 4)\n";
+        text += "IF (c" + n + " >= 61) OR (b < 20) AND NOT FALSE THEN\n";
+        text += "b := b + 1\n";
+        text += "ENDIF\n";
+        text += "LIN P1\n";
+        line += 6;
+    }
+    text += "END\n";
+    return text;
+}
+
+// Counts nodes and sums literals by chasing child pointers through accept()
+class PointerWalk : public grs_ast::ASTVisitorBase{
+    public:
+    size_t nodes = 0;
+    double literalSum = 0.0;
+
+    void walk(grs_ast::ASTNode* node){
+        if(node){
+            nodes++;
+            node->accept(*this);
+        }
+    }
+    void visit(grs_ast::FunctionBlock& node) override{
+        for(auto* statement : node.getStatements()) walk(statement);
+    }
+    void visit(grs_ast::FunctionDeclaration& node) override{ walk(node.getBody());}
+    void visit(grs_ast::BinaryExpression& node) override{ walk(node.getLeft()); walk(node.getRight());}
+    void visit(grs_ast::UnaryExpression& node) override{ walk(node.getExpression());}
+    void visit(grs_ast::LiteraExpression& node) override{
+        if(auto value = std::get_if<int>(&node.getValue())) literalSum += *value;
+        else if(auto value = std::get_if<double>(&node.getValue())) literalSum += *value;
+    }
+    void visit(grs_ast::VariableDeclaration& node) override{ walk(node.getInitializer());}
+    void visit(grs_ast::PositionDeclaration& node) override{
+        for(const auto& arg : node.getArgs()) walk(arg.second);
+    }
+    void visit(grs_ast::MotionCommand& node) override{
+        for(const auto& arg : node.getArgs()) walk(arg.second);
+    }
+    void visit(grs_ast::IfStatement& node) override{
+        walk(node.getCondition()); walk(node.getThenBranch()); walk(node.getElseBranch());
+    }
+    void visit(grs_ast::ForStatement& node) override{ walk(node.getStart()); walk(node.getEnd()); walk(node.getBody());}
+    void visit(grs_ast::WhileStatement& node) override{ walk(node.getCondition()); walk(node.getBody());}
+    void visit(grs_ast::RepeatStatement& node) override{ walk(node.getBody()); walk(node.getCondition());}
+    void visit(grs_ast::SwitchStatement& node) override{
+        walk(node.getSelector());
+        for(const auto& branch : node.getCases()) walk(branch.body);
+        walk(node.getDefault());
+    }
+    void visit(grs_ast::CallExpression& node) override{
+        for(auto* arg : node.getArgs()) walk(arg);
+    }
+    void visit(grs_ast::ReturnStatement& node) override{ walk(node.getValue());}
+};
+
+// The same question answered by sweeping the flat tables front to back
+void flatSweep(const grs_ast::FlatAst& flat, size_t& nodes, double& literalSum){
+    nodes = flat.size();
+    literalSum = 0.0;
+    for(const auto& value : flat.getLiterals()){
+        if(auto v = std::get_if<int>(&value)) literalSum += *v;
+        else if(auto v = std::get_if<double>(&value)) literalSum += *v;
+    }
+}
+
+template<typename Fn>
+double milliseconds(int repeats, Fn&& fn){
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < repeats; ++i) fn();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / repeats;
+}
+
+void report(const char* what, double ms){
+    std::cout << "  " << std::left << std::setw(28) << what
+              << std::right << std::fixed << std::setprecision(2) << ms << " ms\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+    const size_t lines = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    const grs_lexer::SourceBuffer source(makeProgram(lines));
+    grs_lexer::Lexer lexer;
+    const auto tokens = lexer.tokenize(source);
+    grs_parser::Parser parser;
+    // bodies parsed up front, so lowering times only the lowering
+    parser.setLazyBodies(false);
+    grs_ast::Program program = parser.parse(tokens);
+    grs_ast::FlatAst flat;
+    report("lower to flat", milliseconds(1, [&]{ flat = grs_ast::FlatAst::fromTree(*program); }));
+    std::cout << flat.size() << " nodes\n";
+
+    const int repeats = 5;
+    size_t nodes = 0;
+    double literalSum = 0.0;
+    report("pointer visitor walk", milliseconds(repeats, [&]{
+        PointerWalk walk;
+        walk.walk(program.get());
+        nodes = walk.nodes;
+        literalSum = walk.literalSum;
+    }));
+    std::cout << "    " << nodes << " nodes, literal sum " << literalSum << "\n";
+    report("flat linear sweep", milliseconds(repeats, [&]{ flatSweep(flat, nodes, literalSum); }));
+    std::cout << "    " << nodes << " nodes, literal sum " << literalSum << "\n";
+
+    size_t instructions = 0;
+    report("generator, pointer AST", milliseconds(repeats, [&]{
+        grs_interpreter::InstructionGenerator generator;
+        instructions = generator.generateInstructions(program.get()).size();
+    }));
+    report("generator, flat AST", milliseconds(repeats, [&]{
+        grs_interpreter::InstructionGenerator generator;
+        instructions = generator.generateInstructions(flat).size();
+    }));
+    std::cout << instructions << " instructions\n";
+    return 0;
+}
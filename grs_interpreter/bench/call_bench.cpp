@@ -0,0 +1,92 @@
+// Cost of a DEF call in the VM: a loop adds i * i + 1 to a sum inline,
+// through a call per turn, and through a recursive call chain `depth`
+// deep per turn (locals saved and restored on every nested call).
+// Build with -DGRS_BUILD_BENCHMARKS=ON and run ./call_bench [turns].
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "lexer/lexer.hpp"
+#include "lexer/source_buffer.hpp"
+#include "parser/parser.hpp"
+#include "vm/compiler.hpp"
+#include "vm/type_checker.hpp"
+#include "vm/vm.hpp"
+
+namespace {
+
+const char* const FUNCTIONS =
+    "DEF REAL term(REAL v)\n"
+    "DECL REAL t := v * v\n"
+    "RETURN t + 1\n"
+    "END\n"
+    "DEF REAL chain(INT n, REAL v)\n"
+    "DECL REAL t := 0\n"
+    "IF n > 1 THEN\n"
+    "t := chain(n - 1, v)\n"
+    "RETURN t\n"
+    "ENDIF\n"
+    "RETURN term(v)\n"
+    "END\n";
+
+// depth 0 is the inline form
+std::string makeProgram(int depth, long turns){
+    std::string text = "DEF bench()\nDECL INT i := 0\nDECL REAL s := 0\n";
+    text += "FOR i = 1 TO " + std::to_string(turns) + "\n";
+    if(depth == 0){
+        text += "s := s + i * i + 1\n";
+    } else if(depth == 1){
+        text += "s := s + term(i)\n";
+    } else {
+        text += "s := s + chain(" + std::to_string(depth) + ", i)\n";
+    }
+    text += "ENDFOR\nEND\n";
+    return text + FUNCTIONS;
+}
+
+// best of 5 runs, in nanoseconds per turn
+double run(int depth, long turns){
+    const std::string text = makeProgram(depth, turns);
+    grs_lexer::SourceBuffer buffer(text);
+    grs_lexer::Lexer lexer;
+    auto tokens = lexer.tokenize(buffer);
+    grs_parser::Parser parser;
+    parser.setLazyBodies(false);
+    auto program = parser.parse(tokens);
+    grs_vm::TypeChecker checker;
+    if(!parser.getErrors().empty() || !checker.check(program.get())){
+        std::cerr << "benchmark program does not compile\n";
+        std::exit(1);
+    }
+    const grs_vm::Chunk chunk = grs_vm::Compiler().compile(program.get());
+
+    grs_vm::Vm vm(chunk);
+    double best = 1e300;
+    for(int i = 0; i < 5; ++i){
+        vm.reset();
+        auto start = std::chrono::steady_clock::now();
+        while(vm.next()){
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best / static_cast<double>(turns);
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+    const long turns = argc > 1 ? std::strtol(argv[1], nullptr, 10) : 1000000;
+    std::cout << grs_vm::Vm::getDispatch() << " dispatch, " << turns << " turns, ns per turn\n";
+    const double inlined = run(0, turns);
+    std::cout << std::fixed << std::setprecision(2) << std::setw(12) << "inline" << std::setw(12) << inlined << '\n';
+    for(int depth : {1, 2, 4, 8, 16, 64}){
+        const double called = run(depth, turns);
+        std::cout << std::setw(8) << depth << " call" << (depth > 1 ? "s" : " ") << std::setw(12) << called
+                  << "  (" << (called - inlined) / depth << " per call)\n";
+    }
+    return 0;
+}
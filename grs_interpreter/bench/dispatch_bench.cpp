@@ -0,0 +1,74 @@
+// Cost of the VM's instruction dispatch: hand-built loops of cheap opcodes,
+// so the time is mostly fetching and jumping to the next handler.
+// dispatch_bench is built with the threaded (computed goto) loop and
+// dispatch_bench_switch with GRS_VM_SWITCH_DISPATCH; compare the two.
+// Build with -DGRS_BUILD_BENCHMARKS=ON and run ./dispatch_bench [iterations].
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "vm/bytecode.hpp"
+#include "vm/vm.hpp"
+
+namespace {
+
+using grs_vm::OpCode;
+
+void emit(grs_vm::Chunk& chunk, OpCode op, std::uint8_t a, std::uint32_t b, std::int32_t c){
+    chunk.code.push_back({op, a, b, c});
+    chunk.locations.push_back(common::NO_LOCATION);
+}
+
+// R0 counts from 0 to `iterations`; each turn also runs `body` copies of
+// `op` on R3 before the compare and the two jumps:
+//   R0 := R0 + 1; <body>; R4 := R0 < R1; JMPZ R4 end; JMP loop
+grs_vm::Chunk countingLoop(double iterations, OpCode op, int body){
+    grs_vm::Chunk chunk;
+    chunk.constants = {0.0, iterations, 1.0};
+    chunk.registerCount = 5;
+    emit(chunk, OpCode::LOADK, 0, 0, 0);
+    emit(chunk, OpCode::LOADK, 1, 1, 0);
+    emit(chunk, OpCode::LOADK, 2, 2, 0);
+    emit(chunk, OpCode::LOADK, 3, 2, 0);
+    const auto loop = static_cast<std::int32_t>(chunk.code.size());
+    emit(chunk, OpCode::ADD_F, 0, 0, 2);
+    for(int i = 0; i < body; ++i){
+        emit(chunk, op, 3, 3, 2);
+    }
+    emit(chunk, OpCode::LT_F, 4, 0, 1);
+    emit(chunk, OpCode::JMPZ, 4, 0, 1);
+    emit(chunk, OpCode::JMP, 0, 0, loop - static_cast<std::int32_t>(chunk.code.size()) - 1);
+    emit(chunk, OpCode::HALT, 0, 0, 0);
+    return chunk;
+}
+
+void run(const char* what, const grs_vm::Chunk& chunk){
+    grs_vm::Vm vm(chunk);
+    double best = 1e300;
+    for(int i = 0; i < 5; ++i){
+        vm.reset();
+        auto start = std::chrono::steady_clock::now();
+        while(vm.next()){
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    const double executed = static_cast<double>(vm.getExecutedCount());
+    std::cout << "  " << std::left << std::setw(32) << what << std::right << std::fixed
+              << std::setprecision(2) << best / executed << " ns/instruction, "
+              << std::setprecision(1) << executed / best * 1e3 << " M instructions/s\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+    const double iterations = argc > 1 ? std::strtod(argv[1], nullptr) : 2000000;
+    std::cout << grs_vm::Vm::getDispatch() << " dispatch, " << iterations << " iterations\n";
+    run("loop only (ADD, LT, JMPZ, JMP)", countingLoop(iterations, OpCode::ADD_F, 0));
+    run("+ 8 MOVE", countingLoop(iterations, OpCode::MOVE, 8));
+    run("+ 8 ADD_F", countingLoop(iterations, OpCode::ADD_F, 8));
+    run("+ 8 generic ADD", countingLoop(iterations, OpCode::ADD, 8));
+    return 0;
+}
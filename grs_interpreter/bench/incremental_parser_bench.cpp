@@ -0,0 +1,109 @@
+// Latency of IncrementalParser::applyEdit on a large program, next to a
+// full re-lex and re-parse of the same text: typed-over lines and inserted
+// and removed lines anywhere in the file, and a line growing one keystroke
+// at a time near the top, above nearly every node.
+// Build with -DGRS_BUILD_BENCHMARKS=ON and run ./incremental_parser_bench [lines].
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "lexer/lexer.hpp"
+#include "lexer/source_buffer.hpp"
+#include "parser/incremental_parser.hpp"
+#include "parser/parser.hpp"
+
+namespace {
+
+constexpr int LINES_PER_DEF = 10;
+constexpr int EDITS = 2000;
+
+// DEFs of ten lines; lines 4 to 8 of each are plain statements
+std::string makeProgram(size_t lines){
+    std::string text;
+    for(size_t function = 0; function * LINES_PER_DEF < lines; ++function){
+        text += "DEF f" + std::to_string(function) + "()\n";
+        text += "DECL INT a := 3\n";
+        text += "DECL POS P1 := {x 1, y 2, z 3}\n";
+        text += "LIN P1\na := a + 1\nP1->x := a * 2\nWAIT(1)\nLIN P1\n";
+        text += "END\n\n";
+    }
+    return text;
+}
+
+// a random plain statement line, 1-based
+int statementLine(std::mt19937& random, size_t lines){
+    const int functions = static_cast<int>(lines / LINES_PER_DEF);
+    return static_cast<int>(random() % functions) * LINES_PER_DEF + 4 + static_cast<int>(random() % 5);
+}
+
+double milliseconds(std::chrono::steady_clock::duration elapsed){
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+template<typename Fn>
+void report(const char* what, Fn&& edit){
+    std::vector<double> times;
+    times.reserve(EDITS);
+    for(int i = 0; i < EDITS; ++i){
+        const auto start = std::chrono::steady_clock::now();
+        edit(i);
+        times.push_back(milliseconds(std::chrono::steady_clock::now() - start));
+    }
+    std::sort(times.begin(), times.end());
+    std::cout << "  " << std::left << std::setw(22) << what << std::right << std::fixed << std::setprecision(3)
+              << "median " << times[times.size() / 2] << " ms, p99 " << times[times.size() * 99 / 100]
+              << " ms, worst " << times.back() << " ms\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+    const size_t lines = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50000;
+    const std::string text = makeProgram(std::max<size_t>(lines, LINES_PER_DEF));
+
+    const auto start = std::chrono::steady_clock::now();
+    {
+        grs_lexer::SourceBuffer source(text);
+        grs_lexer::Lexer lexer;
+        const std::vector<grs_lexer::Token> tokens = lexer.tokenize(source);
+        grs_parser::Parser parser;
+        parser.setLazyBodies(false);
+        parser.parse(tokens);
+    }
+    const double full = milliseconds(std::chrono::steady_clock::now() - start);
+
+    grs_parser::IncrementalParser incremental;
+    incremental.load(text);
+    const size_t count = incremental.getLineCount();
+    std::cout << count << " lines; full lex + parse " << std::fixed << std::setprecision(3) << full << " ms\n";
+
+    std::mt19937 random(1);
+    report("retype a line", [&](int i){
+        const int line = statementLine(random, count);
+        incremental.applyEdit({line, line, i % 2 ? "a := a + 1" : "LIN P1"});
+    });
+    // insert, then remove again, so the program keeps its size
+    int inserted = 0;
+    report("insert/remove a line", [&](int i){
+        if(i % 2 == 0){
+            inserted = statementLine(random, count);
+            incremental.applyEdit({inserted, inserted - 1, "P1->y := a + 2 * a + 3 * a + 4 * a"});
+        } else {
+            incremental.applyEdit({inserted, inserted, ""});
+        }
+    });
+    // one character per keystroke; every fourth one completes "a := a + 1 + 1 ..."
+    std::string typed = "a := a";
+    report("type near the top", [&](int i){
+        typed += " + 1"[i % 4];
+        incremental.applyEdit({5, 5, typed});
+    });
+
+    std::cout << (incremental.hasErrors() ? "parser errors\n" : "no parser errors\n");
+    return 0;
+}
@@ -0,0 +1,76 @@
+// Throughput of Lexer::tokenizeParallel by worker count, next to the
+// serial tokenize() it must match.
+// Build with -DGRS_BUILD_BENCHMARKS=ON and run ./lexer_parallel_bench [MiB] [max workers].
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lexer/lexer.hpp"
+#include "lexer/source_buffer.hpp"
+
+namespace {
+
+// Motion blocks with comments and arithmetic, like tests/example_krl_code.txt
+std::string makeProgram(size_t bytes){
+    std::string text = "DEF bench()\n";
+    size_t line = 0;
+    while(text.size() < bytes){
+        text += "        ; Başlangıç pozisyonuna git, hız düşürülüyor\n";
+        text += "        DECL REAL r" + std::to_string(line % 512) + " := 2.5\n";
+        text += "            LIN P" + std::to_string(line % 16) + "\n";
+        text += "            P1->x := " + std::to_string(line) + ".25 * 2 + r" + std::to_string(line % 512) + "\n";
+        line++;
+    }
+    text += "END\n";
+    return text;
+}
+
+// best of `repeats` runs, in bytes per second
+template<typename Fn>
+double bytesPerSecond(size_t bytes, int repeats, Fn&& fn){
+    double best = 0.0;
+    for(int i = 0; i < repeats; ++i){
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::max(best, static_cast<double>(bytes) / elapsed.count());
+    }
+    return best;
+}
+
+void report(const std::string& what, double rate, double serial){
+    std::cout << "  " << std::left << std::setw(14) << what
+              << std::right << std::fixed << std::setprecision(1)
+              << rate / (1024.0 * 1024.0) << " MiB/s  x" << std::setprecision(2) << rate / serial << "\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+    const size_t mib = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 32;
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned maxWorkers = argc > 2 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10)) : cores;
+    const grs_lexer::SourceBuffer source(makeProgram(mib * 1024 * 1024));
+    const int repeats = 3;
+    volatile size_t sink = 0;
+
+    std::cout << source.size() / (1024 * 1024) << " MiB, " << cores << " cores\n";
+    const double serial = bytesPerSecond(source.size(), repeats, [&]{
+        grs_lexer::Lexer lexer;
+        sink = sink + lexer.tokenize(source).size();
+    });
+    report("tokenize", serial, serial);
+
+    for(unsigned workers = 2; workers <= maxWorkers; workers *= 2){
+        report(std::to_string(workers) + " workers", bytesPerSecond(source.size(), repeats, [&]{
+            grs_lexer::Lexer lexer;
+            sink = sink + lexer.tokenizeParallel(source, workers).size();
+        }), serial);
+    }
+    return 0;
+}
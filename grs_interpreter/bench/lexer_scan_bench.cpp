@@ -0,0 +1,89 @@
+// Throughput of the lexer's byte-scanning kernels at every dispatch level.
+// Build with -DGRS_BUILD_BENCHMARKS=ON and run ./lexer_scan_bench [MiB].
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lexer/lexer.hpp"
+#include "lexer/scan_kernels.hpp"
+#include "lexer/source_buffer.hpp"
+
+namespace simd = grs_lexer::simd;
+
+namespace {
+
+// Deeply indented motion blocks with Turkish comments, like tests/example_krl_code.txt
+std::string makeProgram(size_t bytes){
+    std::string text = "DEF bench()\n";
+    size_t line = 0;
+    while(text.size() < bytes){
+        text += "        ; Başlangıç pozisyonuna git, hız düşürülüyor\n";
+        text += "            LIN P" + std::to_string(line % 16) + "\n";
+        text += "            P1->x := " + std::to_string(line) + ".25 * 2\n";
+        line++;
+    }
+    text += "END\n";
+    return text;
+}
+
+template<typename Fn>
+double bytesPerSecond(size_t bytes, int repeats, Fn&& fn){
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < repeats; ++i) fn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(bytes) * repeats / elapsed.count();
+}
+
+void report(const char* what, double rate){
+    std::cout << "  " << std::left << std::setw(14) << what
+              << std::right << std::fixed << std::setprecision(1)
+              << rate / (1024.0 * 1024.0) << " MiB/s\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+    const size_t mib = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+    const grs_lexer::SourceBuffer source(makeProgram(mib * 1024 * 1024));
+    const std::string_view text = source.view();
+    const int repeats = 5;
+    volatile size_t sink = 0;
+
+    std::vector<size_t> lineStarts;
+    size_t indentBytes = 0;
+    for(size_t pos = 0; pos < text.size(); pos = text.find('\n', pos) + 1){
+        lineStarts.push_back(pos);
+        indentBytes += text.find_first_not_of(' ', pos) - pos;
+        if(text.find('\n', pos) == std::string_view::npos) break;
+    }
+
+    for(simd::Level level : {simd::Level::Scalar, simd::Level::SSE2, simd::Level::AVX2}){
+        simd::setLevel(level);
+        if(simd::activeLevel() != level) continue;
+        std::cout << simd::levelName(level) << ":\n";
+
+        // indentation runs only, which is where the lexer meets long blanks
+        report("skip blanks", bytesPerSecond(indentBytes, repeats, [&]{
+            for(size_t start : lineStarts){
+                sink = sink + simd::skipBlanksKernel(text.data() + start, text.size() - start);
+            }
+        }));
+        report("find newline", bytesPerSecond(text.size(), repeats, [&]{
+            for(size_t pos = 0; pos < text.size();){
+                pos += simd::findNewline(text.data() + pos, text.size() - pos) + 1;
+                sink = sink + pos;
+            }
+        }));
+        report("ascii check", bytesPerSecond(text.size(), repeats, [&]{
+            sink = sink + simd::isAscii(text.data(), text.size());
+        }));
+        report("tokenize", bytesPerSecond(text.size(), 1, [&]{
+            grs_lexer::Lexer lexer;
+            sink = sink + lexer.tokenize(source).size();
+        }));
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+// Parse throughput in tokens/second, with tracing off and on, and the cost
+// of starting a program from a library of DEFs with lazy bodies.
+// Build with -DGRS_BUILD_BENCHMARKS=ON and run ./parser_bench [lines].
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "lexer/lexer.hpp"
+#include "lexer/source_buffer.hpp"
+#include "lexer/token_stream.hpp"
+#include "parser/parser.hpp"
+
+namespace {
+
+// Declarations, assignments, IFs and motions, like tests/general_system_test.txt
+std::string makeProgram(size_t lines){
+    std::string text = "DEF bench()\n";
+    text += "DECL POS P1 := {x 25, y 222.5, z 2, a 10.0, b 3.0, c 1000}\n";
+    text += "DECL REAL b := 20.6\n";
+    size_t line = 3;
+    while(line < lines){
+        const std::string n = std::to_string(line);
+        text += "DECL INT c" + n + " := " + n + "\n";
+        text += "c" + n + " := b + c" + n + " * 2\n";
+        text += "IF (c" + n + " >= 61) OR (b < 20) THEN\n";
+        text += "P1->x := " + n + ".25 * 2\n";
+        text += "ENDIF\n";
+        text += "LIN P1\n";
+        line += 6;
+    }
+    text += "END\n";
+    return text;
+}
+
+// Position aggregates full of literals plus long arithmetic, where nearly
+// every token goes through the expression parser
+std::string makeExpressionProgram(size_t lines){
+    std::string text = "DEF bench()\nDECL REAL b := 1.5\n";
+    for(size_t line = 2; line < lines; line += 2){
+        const std::string n = std::to_string(line % 1000);
+        text += "DECL POS P" + n + " := {x " + n + ".5, y -2, z 3.25 * b, a 0, b 90, c " + n + "}\n";
+        text += "b := (b + " + n + ") * 2 - b / 4 + 1 < 3 OR NOT b = 2\n";
+    }
+    text += "END\n";
+    return text;
+}
+
+// A short main program followed by many subroutines it never calls
+std::string makeLibrary(size_t lines){
+    std::string text = makeProgram(60);
+    for(size_t line = 60, function = 0; line < lines; line += 62, ++function){
+        text += "DEF helper" + std::to_string(function) + "()\n";
+        text += makeProgram(60).substr(sizeof("DEF bench()"));
+    }
+    return text;
+}
+
+template<typename Fn>
+double tokensPerSecond(size_t tokens, Fn&& fn){
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(tokens) / elapsed.count();
+}
+
+void report(const char* what, double rate){
+    std::cout << "  " << std::left << std::setw(22) << what
+              << std::right << std::fixed << std::setprecision(2)
+              << rate / 1e6 << " Mtokens/s\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+    const size_t lines = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    const grs_lexer::SourceBuffer source(makeProgram(lines));
+
+    grs_lexer::Lexer lexer;
+    const std::vector<grs_lexer::Token> tokens = lexer.tokenize(source);
+    std::cout << tokens.size() << " tokens, " << source.size() / 1024 << " KiB\n";
+
+    size_t errors = 0;
+    report("parse (borrowed)", tokensPerSecond(tokens.size(), [&]{
+        grs_parser::Parser parser;
+        parser.setLazyBodies(false);
+        parser.parse(tokens);
+        errors = parser.getErrors().size();
+    }));
+    report("lex + parse (stream)", tokensPerSecond(tokens.size(), [&]{
+        grs_lexer::Lexer streamLexer;
+        grs_lexer::TokenStream stream(streamLexer, source);
+        grs_parser::Parser parser;
+        parser.setLazyBodies(false);
+        parser.parse(stream);
+    }));
+    report("parse (traced)", tokensPerSecond(tokens.size(), [&]{
+        std::ostringstream trace;
+        grs_parser::Parser parser;
+        parser.setLazyBodies(false);
+        parser.setTrace(&trace);
+        parser.parse(tokens);
+    }));
+    std::cout << errors << " parser errors\n";
+
+    const grs_lexer::SourceBuffer expressions(makeExpressionProgram(lines));
+    const std::vector<grs_lexer::Token> expressionTokens = lexer.tokenize(expressions);
+    std::cout << "expression-heavy: " << expressionTokens.size() << " tokens\n";
+    report("parse (borrowed)", tokensPerSecond(expressionTokens.size(), [&]{
+        grs_parser::Parser parser;
+        parser.setLazyBodies(false);
+        parser.parse(expressionTokens);
+        errors = parser.getErrors().size();
+    }));
+    std::cout << errors << " parser errors\n";
+
+    // tokens/s here counts the whole file, parsed or only pre-scanned
+    const grs_lexer::SourceBuffer library(makeLibrary(lines));
+    const std::vector<grs_lexer::Token> libraryTokens = lexer.tokenize(library);
+    std::cout << "library: " << libraryTokens.size() << " tokens\n";
+    for(bool lazy : {false, true}){
+        report(lazy ? "start (lazy bodies)" : "start (eager bodies)", tokensPerSecond(libraryTokens.size(), [&]{
+            grs_parser::Parser parser;
+            parser.setLazyBodies(lazy);
+            auto program = parser.parse(libraryTokens);
+            program.getEntry()->getBody();
+            errors = parser.getErrors().size();
+        }));
+    }
+    std::cout << errors << " parser errors\n";
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Cost of a SWITCH in the VM against the number of CASEs: a loop picks
+// each CASE in turn through a dense SWITCH (jump table), a sparse one
+// (binary search) and the IF / ELSE chain it replaces.
+// Build with -DGRS_BUILD_BENCHMARKS=ON and run ./switch_bench [turns].
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "lexer/lexer.hpp"
+#include "lexer/source_buffer.hpp"
+#include "parser/parser.hpp"
+#include "vm/compiler.hpp"
+#include "vm/type_checker.hpp"
+#include "vm/vm.hpp"
+
+namespace {
+
+enum class Dispatch{ DENSE, SPARSE, IF_CHAIN };
+
+// CASE values are 0, 1, 2, ... (dense) or 0, 37, 74, ... (sparse)
+std::string dispatch(Dispatch kind, int cases){
+    const int stride = kind == Dispatch::SPARSE ? 37 : 1;
+    std::string text;
+    if(kind == Dispatch::IF_CHAIN){
+        for(int i = 0; i < cases; ++i){
+            text += "IF sel = " + std::to_string(i) + " THEN\ns := s + " + std::to_string(i) + "\nELSE\n";
+        }
+        text += "s := s - 1\n";
+        for(int i = 0; i < cases; ++i){
+            text += "ENDIF\n";
+        }
+        return text;
+    }
+    text += "SWITCH sel\n";
+    for(int i = 0; i < cases; ++i){
+        text += "CASE " + std::to_string(i * stride) + "\ns := s + " + std::to_string(i) + "\n";
+    }
+    text += "DEFAULT\ns := s - 1\nENDSWITCH\n";
+    return text;
+}
+
+// `turns` turns, each picking the next CASE: sel runs through the values
+std::string makeProgram(Dispatch kind, int cases, long turns){
+    const int stride = kind == Dispatch::SPARSE ? 37 : 1;
+    std::string text = "DEF bench()\n";
+    text += "DECL INT part := 0\nDECL INT i := 0\nDECL INT sel := 0\nDECL REAL s := 0\n";
+    text += "FOR i = 1 TO " + std::to_string(turns) + "\n";
+    text += "sel := part * " + std::to_string(stride) + "\n";
+    text += dispatch(kind, cases);
+    text += "part := part + 1\n";
+    text += "IF part >= " + std::to_string(cases) + " THEN\npart := 0\nENDIF\n";
+    text += "ENDFOR\nEND\n";
+    return text;
+}
+
+// best of 5 runs, in nanoseconds per turn
+double run(Dispatch kind, int cases, long turns){
+    const std::string text = makeProgram(kind, cases, turns);
+    grs_lexer::SourceBuffer buffer(text);
+    grs_lexer::Lexer lexer;
+    auto tokens = lexer.tokenize(buffer);
+    grs_parser::Parser parser;
+    parser.setLazyBodies(false);
+    auto program = parser.parse(tokens);
+    if(!parser.getErrors().empty()){
+        std::cerr << "benchmark program does not parse: " << parser.getErrors().front().message << '\n';
+        std::exit(1);
+    }
+    grs_vm::TypeChecker checker;
+    checker.check(program.get());
+    const grs_vm::Chunk chunk = grs_vm::Compiler().compile(program.get());
+
+    grs_vm::Vm vm(chunk);
+    double best = 1e300;
+    for(int i = 0; i < 5; ++i){
+        vm.reset();
+        auto start = std::chrono::steady_clock::now();
+        while(vm.next()){
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best / static_cast<double>(turns);
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+    const long turns = argc > 1 ? std::strtol(argv[1], nullptr, 10) : 1000000;
+    std::cout << grs_vm::Vm::getDispatch() << " dispatch, " << turns << " turns, ns per turn\n";
+    std::cout << std::setw(8) << "CASEs" << std::setw(14) << "jump table" << std::setw(14) << "search"
+              << std::setw(14) << "IF chain" << '\n';
+    for(int cases : {2, 4, 8, 16, 32, 64, 128, 256}){
+        std::cout << std::setw(8) << cases << std::fixed << std::setprecision(2)
+                  << std::setw(14) << run(Dispatch::DENSE, cases, turns)
+                  << std::setw(14) << run(Dispatch::SPARSE, cases, turns)
+                  << std::setw(14) << run(Dispatch::IF_CHAIN, cases, turns) << '\n';
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Running a program through the bytecode VM against generating it with the
+// tree-walking instruction generator, which evaluates as it visits, before
+// and after the constant-folding pass and type checking (which gives the
+// VM its typed opcodes).
+// Build with -DGRS_BUILD_BENCHMARKS=ON and run ./vm_bench [lines].
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ast/optimizer.hpp"
+#include "interpreter/instruction_generator.hpp"
+#include "lexer/lexer.hpp"
+#include "lexer/source_buffer.hpp"
+#include "parser/parser.hpp"
+#include "vm/compiler.hpp"
+#include "vm/type_checker.hpp"
+#include "vm/vm.hpp"
+
+namespace {
+
+// Same shape as the AST traversal benchmark: declarations, arithmetic,
+// IFs and motions
+std::string makeProgram(size_t lines){
+    std::string text = "DEF bench()\n";
+    text += "DECL POS P1 := {x 25, y 222.5, z 2, a 10.0, b 3.0, c 1000}\n";
+    text += "DECL REAL b := 20.6\n";
+    size_t line = 3;
+    while(line < lines){
+        const std::string n = std::to_string(line);
+        text += "DECL INT c" + n + " := " + n + " + 2 * 3\n";
+        text += "c" + n + " := b + c" + n + " * 2 - (b / 4)\n";
+        text += "IF (c" + n + " >= 61) OR (b < 20) AND NOT FALSE THEN\n";
+        text += "b := b + 1\n";
+        text += "ENDIF\n";
+        text += "LIN P1\n";
+        line += 6;
+    }
+    text += "END\n";
+    return text;
+}
+
+// best of `runs`, in milliseconds
+template<typename Fn>
+double bestMs(int runs, Fn&& fn){
+    double best = 1e300;
+    for(int i = 0; i < runs; ++i){
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+void report(const char* what, double ms){
+    std::cout << "  " << std::left << std::setw(24) << what
+              << std::right << std::fixed << std::setprecision(3) << ms << " ms\n";
+}
+
+// generates, compiles and runs `program`, reporting each step
+void runAll(const char* title, grs_ast::FunctionBlock* program){
+    std::cout << title << ":\n";
+    size_t generated = 0;
+    report("generate (tree walk)", bestMs(5, [&]{
+        grs_interpreter::InstructionGenerator generator;
+        generated = generator.generateInstructions(program).size();
+    }));
+
+    grs_vm::Chunk chunk;
+    report("compile to bytecode", bestMs(5, [&]{
+        chunk = grs_vm::Compiler().compile(program);
+    }));
+
+    grs_vm::Vm vm(chunk);
+    size_t commands = 0;
+    const double runMs = bestMs(5, [&]{
+        vm.reset();
+        commands = 0;
+        while(vm.next()){
+            ++commands;
+        }
+    });
+    report("run bytecode", runMs);
+
+    std::cout << chunk.code.size() << " bytecode instructions, " << chunk.registerCount << " registers, "
+              << std::fixed << std::setprecision(1)
+              << static_cast<double>(vm.getExecutedCount()) / runMs / 1e3 << " M instructions/s\n";
+    std::cout << generated << " generated instructions, " << commands << " robot commands from the VM\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+    const size_t lines = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    const grs_lexer::SourceBuffer source(makeProgram(lines));
+
+    grs_lexer::Lexer lexer;
+    const std::vector<grs_lexer::Token> tokens = lexer.tokenize(source);
+    grs_parser::Parser parser;
+    parser.setLazyBodies(false);
+    auto program = parser.parse(tokens);
+    std::cout << lines << " lines, " << parser.getErrors().size() << " parser errors\n";
+
+    runAll("as parsed", program.get());
+
+    grs_ast::OptimizerStats stats;
+    report("optimize (once)", bestMs(1, [&]{
+        stats = grs_ast::Optimizer().optimize(program.get(), *program.getArena());
+    }));
+    std::cout << stats << "\n";
+    bool typed = false;
+    report("type check (once)", bestMs(1, [&]{
+        typed = grs_vm::TypeChecker().check(program.get());
+    }));
+    std::cout << (typed ? "no type errors" : "type errors") << "\n";
+    runAll("optimized and typed", program.get());
+    return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef ARENA_HPP_
+#define ARENA_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace grs_ast{
+
+// Bump allocator owning the nodes of one parse.
+//
+// Nodes are carved out of large chunks and never freed one by one; the
+// whole arena is released at once. Objects that are not trivially
+// destructible register a finalizer (kept in the arena itself) that runs
+// when the arena dies, so nodes may still hold strings and vectors.
+class Arena{
+    public:
+    explicit Arena(size_t firstChunkSize = 64 * 1024);
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment);
+
+    template<class T, class... Args>
+    T* make(Args&&... args){
+        void* memory = allocate(sizeof(T), alignof(T));
+        T* object = new (memory) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>){
+            addFinalizer(object, [](void* p){ static_cast<T*>(p)->~T(); });
+        }
+        return object;
+    }
+
+    // bytes handed out so far
+    size_t bytesUsed()const{ return bytesUsed_; }
+
+    private:
+    struct Chunk{
+        Chunk* next;
+        size_t size;
+    };
+    struct Finalizer{
+        Finalizer* next;
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    Chunk* chunks_ = nullptr;
+    char* cursor_ = nullptr;
+    char* limit_ = nullptr;
+    size_t nextChunkSize_;
+    size_t bytesUsed_ = 0;
+    Finalizer* finalizers_ = nullptr;
+
+    void addFinalizer(void* object, void (*destroy)(void*));
+    void grow(size_t minimum);
+};
+
+}
+
+#endif //ARENA_HPP_
@@ -6,7 +6,9 @@
 #include <variant>
 #include <unordered_map>
 #include "../common/utils.hpp"
+#include "../common/source_location.hpp"
 #include "../lexer/token.hpp"
+#include "arena.hpp"
 
 
 namespace grs_ast{
@@ -21,6 +23,7 @@ enum class ASTNodeType{
     UnaryExpression,
     LiteralExpression,
     VariableExpression,
+    CallExpression,
     ExecutePosAndAxisExpression,
     VariableDeclaration,
     PositionDeclaration,
@@ -29,6 +32,8 @@ enum class ASTNodeType{
     AxisDeclaration,
     IfStatement,
     ForStatement,
+    WhileStatement,
+    RepeatStatement,
     SwitchStatement,
     CaseStatement,
     DefaultStatement,
@@ -41,134 +46,210 @@ enum class ASTNodeType{
 };
 
 class ASTVisitor;
+class FunctionDeclaration;
+// Nodes are owned by an Arena and link to each other with plain pointers;
+// they are never deleted individually.
 
 //Element Interface
 // Base Abstract Class
 class ASTNode{
     public:
     ASTNode() = default;
-    explicit ASTNode(std::vector<std::pair<int,int>> lineAndColumn);
+    explicit ASTNode(common::LocationId location);
     virtual ~ASTNode() = default;
     virtual ASTNodeType getType()const = 0;
     virtual void accept(ASTVisitor& visitor) = 0;
-    virtual const std::vector<std::pair<int,int>>& getLineColumn()const{return lineAndColumn_;}
+    // decoded through the LocationTable the parser was given
+    common::LocationId getLocation()const{return location_;}
+    // moves the recorded position by `delta` ids, used when an edit needs room above the node
+    void shiftLocation(std::int64_t delta);
     private:
-    std::vector<std::pair<int,int>> lineAndColumn_;
+    common::LocationId location_ = common::NO_LOCATION;
 
 };
 
 class Expression : public ASTNode{
     public:
+    Expression() = default;
+    explicit Expression(common::LocationId location) : ASTNode(location) {}
     virtual ~Expression() = default;
+    // KRL type (INT, REAL, BOOL, CHAR, POS, FRAME, AXIS) set by the
+    // TypeChecker; ENDOFFILE when unchecked or not known before running
+    grs_lexer::TokenType getStaticType()const{ return staticType_;}
+    void setStaticType(grs_lexer::TokenType type){ staticType_ = type;}
+    private:
+    grs_lexer::TokenType staticType_ = grs_lexer::TokenType::ENDOFFILE;
 };
 
 
 class FunctionBlock : public ASTNode{
     public:
-    FunctionBlock(std::vector<std::shared_ptr<ASTNode>> statements);
+    FunctionBlock(std::vector<ASTNode*> statements);
     ASTNodeType getType()const override{ return ASTNodeType::Program;}
     void accept(ASTVisitor& visitor)override;
-    const std::vector<std::shared_ptr<ASTNode>>& getStatements()const{return statements_;}
+    const std::vector<ASTNode*>& getStatements()const{return statements_;}
+    // replaces statements [first, first + count) in place
+    void replaceStatements(size_t first, size_t count, std::vector<ASTNode*> replacement);
     private:
-    std::vector<std::shared_ptr<ASTNode>> statements_;
+    std::vector<ASTNode*> statements_;
+};
+
+// Builds the body of a DEF whose tokens were only recorded; implemented by
+// grs_parser::Parser
+class BodyParser{
+    public:
+    virtual FunctionBlock* parseBody(FunctionDeclaration& function) = 0;
+    protected:
+    ~BodyParser() = default;
 };
 
+// DEF [type] name(type parameter, ...) ... END. A lazy parser only records
+// the body's tokens (ENDOFFILE terminated) and builds its tree the first
+// time getBody() is asked for, so DEFs that are never used cost a token
+// copy instead of a parse. The BodyParser, and the source the tokens point
+// into, must outlive that.
+//
+// A call runs the body with its own locals: the parameters, which start
+// as the arguments' values, and every variable a DECL in the body
+// declares. Any other name is the main program's. Parameters and return
+// values are numbers.
 class FunctionDeclaration : public ASTNode{
 
     public:
-    FunctionDeclaration(const std::string& name);
+    struct Parameter{
+        grs_lexer::TokenType type;
+        std::string name;
+    };
+    FunctionDeclaration(const std::string& name, std::vector<Parameter> parameters, grs_lexer::TokenType returnType,
+                        std::vector<grs_lexer::Token> bodyTokens, BodyParser* bodyParser, Arena& arena,
+                        common::LocationId location);
+    // body parsed together with the declaration
+    FunctionDeclaration(const std::string& name, std::vector<Parameter> parameters, grs_lexer::TokenType returnType,
+                        FunctionBlock* body, common::LocationId location);
     ASTNodeType getType()const override{ return ASTNodeType::FunctionDeclaration;}
     void accept(ASTVisitor& visitor)override;
+    const std::string& getName()const{ return name_;}
+    const std::vector<Parameter>& getParameters()const{ return parameters_;}
+    // INT, REAL or BOOL; ENDOFFILE when the DEF declares none
+    grs_lexer::TokenType getReturnType()const{ return returnType_;}
+    // nullptr when the body has syntax errors (reported by the BodyParser)
+    FunctionBlock* getBody();
+    bool isParsed()const{ return parsed_;}
+    // the parameters, then the names the body's DECLs declare (those of
+    // nested DEFs excepted), each once; parses the body
+    const std::vector<std::string>& getLocals();
+    const std::vector<grs_lexer::Token>& getBodyTokens()const{ return bodyTokens_;}
+    // arena the body's nodes go to: the one holding this declaration
+    Arena& getArena()const{ return *arena_;}
     private:
     std::string name_;
+    std::vector<Parameter> parameters_;
+    grs_lexer::TokenType returnType_;
+    std::vector<grs_lexer::Token> bodyTokens_;
+    BodyParser* bodyParser_ = nullptr;
+    Arena* arena_ = nullptr;
+    FunctionBlock* body_ = nullptr;
+    bool parsed_ = false;
+    std::vector<std::string> locals_;
+    bool localsKnown_ = false;
 };
 
 class FrameDeclaration : public ASTNode{
     public:
-    FrameDeclaration(const std::string& name, const std::vector<std::pair<std::string, std::shared_ptr<Expression>>>& args, std::vector<std::pair<int,int>>& lineAndColumn);
+    FrameDeclaration(const std::string& name, const std::vector<std::pair<std::string, Expression*>>& args, common::LocationId location);
     ASTNodeType getType()const override{ return ASTNodeType::FrameDeclaration;}
     void accept(ASTVisitor& visitor)override;
     std::string getName()const{return name_;}
-    std::vector<std::pair<std::string, std::shared_ptr<Expression>>> getArgs() const{ return args_;}
+    const std::vector<std::pair<std::string, Expression*>>& getArgs() const{ return args_;}
+    void setArg(size_t index, Expression* value){ args_[index].second = value;}
 
     private:
     std::string name_;
-    std::vector<std::pair<std::string, std::shared_ptr<Expression>>> args_;
+    std::vector<std::pair<std::string, Expression*>> args_;
 
 };
 
 class PositionDeclaration : public ASTNode{
     public:
-    PositionDeclaration(const std::string& name, const std::vector<std::pair<std::string, std::shared_ptr<Expression>>>& args, std::vector<std::pair<int,int>>& lineAndColumn);
+    PositionDeclaration(const std::string& name, const std::vector<std::pair<std::string, Expression*>>& args, common::LocationId location);
     ASTNodeType getType()const override{ return ASTNodeType::PositionDeclaration;}
     void accept(ASTVisitor& visitor)override;
     const std::string getName()const{return name_;}
-    const std::vector<std::pair<std::string, std::shared_ptr<Expression>>>& getArgs()const{ return args_;}
+    const std::vector<std::pair<std::string, Expression*>>& getArgs()const{ return args_;}
+    void setArg(size_t index, Expression* value){ args_[index].second = value;}
 
     private:
     std::string name_;
-    std::vector<std::pair<std::string, std::shared_ptr<Expression>>> args_;
+    std::vector<std::pair<std::string, Expression*>> args_;
 
 };
 
 class ExecutePosAndAxisExpression : public ASTNode{
     public:
-    ExecutePosAndAxisExpression(const std::string& posName, const std::string& argName, const std::shared_ptr<Expression>& expr);
+    ExecutePosAndAxisExpression(const std::string& posName, const std::string& argName, Expression* expr, common::LocationId location);
     ASTNodeType getType()const override{return ASTNodeType::ExecutePosAndAxisExpression;}
     void accept(ASTVisitor& visitor)override;
     const std::string getName()const{return posName_;}
     const std::string getArg()const{return argName_;}
-    const std::shared_ptr<Expression> getExpr()const{return expr_;}
+    Expression* getExpr()const{return expr_;}
+    void setExpr(Expression* expr){ expr_ = expr;}
     
     private:
     std::string posName_;
     std::string argName_;
-    std::shared_ptr<Expression> expr_;
+    Expression* expr_;
 };
 
 class AxisDeclaration : public ASTNode{
     public:
-    AxisDeclaration(const std::string& name, const std::vector<std::pair<std::string, std::shared_ptr<Expression>>>& args, std::vector<std::pair<int,int>>& lineAndColumn);
+    AxisDeclaration(const std::string& name, const std::vector<std::pair<std::string, Expression*>>& args, common::LocationId location);
     ASTNodeType getType()const override{return ASTNodeType::AxisDeclaration;}
     void accept(ASTVisitor& visitor)override;
     std::string getName()const{return name_;}
-    std::vector<std::pair<std::string,std::shared_ptr<Expression>>> getArgs()const{return args_;}
+    const std::vector<std::pair<std::string,Expression*>>& getArgs()const{return args_;}
+    void setArg(size_t index, Expression* value){ args_[index].second = value;}
 
     private:
     std::string name_;
-    std::vector<std::pair<std::string, std::shared_ptr<Expression>>> args_;
+    std::vector<std::pair<std::string, Expression*>> args_;
 
 };
 
 class MotionCommand : public ASTNode{
     public:
-    MotionCommand(const std::string& command, const std::string& name, std::vector<std::pair<std::string, std::shared_ptr<Expression>>> args, std::vector<std::pair<int,int>> lineAndColumn);
+    MotionCommand(const std::string& command, const std::string& name, std::vector<std::pair<std::string, Expression*>> args, common::LocationId location);
     ASTNodeType getType() const override{return ASTNodeType::Command;};
     void accept(ASTVisitor& visitor)override;
     const std::string getCommand() const{return command_;}
     const std::string getName() const{return name_;}
-    const std::vector<std::pair<std::string,std::shared_ptr<Expression>>>& getArgs() const{ return args_;}
+    const std::vector<std::pair<std::string,Expression*>>& getArgs() const{ return args_;}
     private:
     std::string command_;
     std::string name_;
-    std::vector<std::pair<std::string, std::shared_ptr<Expression>>> args_;
+    std::vector<std::pair<std::string, Expression*>> args_;
 
 
 
 };
+// RETURN [value]: leaves the DEF being run, which yields the value; in the
+// main program it ends the program
 class ReturnStatement : public ASTNode{
 
     public:
-    explicit ReturnStatement();
+    ReturnStatement(Expression* value, common::LocationId location);
     ASTNodeType getType()const override {return ASTNodeType::ReturnStatement;}
     void accept(ASTVisitor& visitor)override;
-
+    // null for a bare RETURN
+    Expression* getValue()const{ return value_;}
+    void setValue(Expression* value){ value_ = value;}
+    private:
+    Expression* value_;
 };
 
 class WaitStatement : public ASTNode{
 
     public:
-    explicit WaitStatement(double& waitTime, std::vector<std::pair<int,int>> lineAndColumn);
+    explicit WaitStatement(double& waitTime, common::LocationId location);
     ASTNodeType getType()const override {return ASTNodeType::WaitStatement;}
     void accept(ASTVisitor& visitor)override;
     double waitTime_;   
@@ -179,30 +260,35 @@ class WaitStatement : public ASTNode{
 class BinaryExpression : public Expression{
     
     public:
-    BinaryExpression(grs_lexer::TokenType op, std::shared_ptr<Expression> left, std::shared_ptr<Expression> right);
+    // only an assignment, which is a statement, records its position
+    BinaryExpression(grs_lexer::TokenType op, Expression* left, Expression* right,
+                     common::LocationId location = common::NO_LOCATION);
     ASTNodeType getType()const override {return ASTNodeType::BinaryExpression;}
     void accept(ASTVisitor& visitor)override;
     grs_lexer::TokenType getOperator()const{ return op_;}
-    const std::shared_ptr<Expression>& getLeft()const{return left_;}
-    const std::shared_ptr<Expression>& getRight()const{return right_;}
+    Expression* getLeft()const{return left_;}
+    Expression* getRight()const{return right_;}
+    void setLeft(Expression* left){ left_ = left;}
+    void setRight(Expression* right){ right_ = right;}
     
     private:
     grs_lexer::TokenType op_;
-    std::shared_ptr<Expression> left_;
-    std::shared_ptr<Expression> right_;
+    Expression* left_;
+    Expression* right_;
 };
 
 class UnaryExpression : public Expression{
     public:
-    UnaryExpression(grs_lexer::TokenType op, std::shared_ptr<Expression> expr);
+    UnaryExpression(grs_lexer::TokenType op, Expression* expr);
     ASTNodeType getType()const override{ return ASTNodeType::UnaryExpression; }
     void accept(ASTVisitor& visitor) override;
     grs_lexer::TokenType getOperator() const { return op_;}
-    const std::shared_ptr<Expression>& getExpression() const { return expr_;}
+    Expression* getExpression() const { return expr_;}
+    void setExpression(Expression* expr){ expr_ = expr;}
     
     private:
     grs_lexer::TokenType op_;
-    std::shared_ptr<Expression> expr_;
+    Expression* expr_;
 };
 
 class LiteraExpression : public Expression{
@@ -220,18 +306,19 @@ class LiteraExpression : public Expression{
 
 class VariableDeclaration : public ASTNode {
     public:
-    VariableDeclaration(grs_lexer::TokenType dataType, const std::string& name, std::shared_ptr<Expression> initializer,std::vector<std::pair<int,int>> lineAndColumn);
+    VariableDeclaration(grs_lexer::TokenType dataType, const std::string& name, Expression* initializer,common::LocationId location);
     ASTNodeType getType()const override{ return ASTNodeType::VariableDeclaration;}
     void accept(ASTVisitor& visitor) override;
     grs_lexer::TokenType getDataType() const{ return dataType_;}
     const std::string& getName() const { return name_; }
-    const std::shared_ptr<Expression>& getInitializer()const{ return initializer_;}
+    Expression* getInitializer()const{ return initializer_;}
+    void setInitializer(Expression* initializer){ initializer_ = initializer;}
 
     
     private: 
     grs_lexer::TokenType dataType_;
     std::string name_;
-    std::shared_ptr<Expression> initializer_;
+    Expression* initializer_;
 
     
 };
@@ -247,6 +334,25 @@ class VariableExpression : public Expression{
     std::string name_;
 };
 
+// name(arguments), as a statement or inside an expression. Arguments are
+// evaluated left to right; the call yields a number, 0 when the DEF
+// returns without a value.
+class CallExpression : public Expression{
+
+    public:
+    // records its position, as it may be a statement
+    CallExpression(const std::string& name, std::vector<Expression*> args, common::LocationId location);
+    ASTNodeType getType()const override{ return ASTNodeType::CallExpression;}
+    void accept(ASTVisitor& visitor)override;
+    const std::string& getName()const{ return name_;}
+    const std::vector<Expression*>& getArgs()const{ return args_;}
+    void setArg(size_t index, Expression* value){ args_[index] = value;}
+
+    private:
+    std::string name_;
+    std::vector<Expression*> args_;
+};
+
 
 
 
@@ -254,20 +360,137 @@ class VariableExpression : public Expression{
 class IfStatement : public ASTNode{
     
     public:
-    IfStatement(std::shared_ptr<Expression> condition, std::shared_ptr<ASTNode> thenBranc, std::shared_ptr<ASTNode> elseBranch, std::vector<std::pair<int,int>> lineAndColum);
+    IfStatement(Expression* condition, ASTNode* thenBranc, ASTNode* elseBranch, common::LocationId location);
     void accept(ASTVisitor& visitor) override;
     ASTNodeType getType()const override{return ASTNodeType::IfStatement;}
-    const std::shared_ptr<Expression>& getCondition() const{return condition_;}
-    const std::shared_ptr<ASTNode>& getThenBranch() const {return thenBranch_;}
-    const std::shared_ptr<ASTNode>& getElseBranch() const {return elseBranch_;}
+    Expression* getCondition() const{return condition_;}
+    ASTNode* getThenBranch() const {return thenBranch_;}
+    ASTNode* getElseBranch() const {return elseBranch_;}
+    void setCondition(Expression* condition){ condition_ = condition;}
+    void setThenBranch(ASTNode* branch){ thenBranch_ = branch;}
+    void setElseBranch(ASTNode* branch){ elseBranch_ = branch;}
     private:
-    std::shared_ptr<Expression> condition_;
-    std::shared_ptr<ASTNode> thenBranch_;
-    std::shared_ptr<ASTNode> elseBranch_;
+    Expression* condition_;
+    ASTNode* thenBranch_;
+    ASTNode* elseBranch_;
+
+};
 
+
+// FOR counter = start TO end [STEP step] ... ENDFOR. start and end are
+// evaluated once, when the loop is entered; the counter, an INT variable,
+// takes every value from start on, step apart, while it has not passed
+// end, and after the loop holds the first value that did. The body
+// changing the counter does not change how often it runs.
+class ForStatement : public ASTNode{
+    public:
+    ForStatement(const std::string& counter, Expression* start, Expression* end, std::int32_t step,
+                 ASTNode* body, common::LocationId location);
+    void accept(ASTVisitor& visitor) override;
+    ASTNodeType getType()const override{ return ASTNodeType::ForStatement;}
+    const std::string& getCounter()const{ return counter_;}
+    Expression* getStart()const{ return start_;}
+    Expression* getEnd()const{ return end_;}
+    // an integer constant, never 0
+    std::int32_t getStep()const{ return step_;}
+    ASTNode* getBody()const{ return body_;}
+    void setStart(Expression* start){ start_ = start;}
+    void setEnd(Expression* end){ end_ = end;}
+    private:
+    std::string counter_;
+    Expression* start_;
+    Expression* end_;
+    std::int32_t step_;
+    ASTNode* body_;
 };
 
+// WHILE condition ... ENDWHILE: the condition is tested before every turn
+class WhileStatement : public ASTNode{
+    public:
+    WhileStatement(Expression* condition, ASTNode* body, common::LocationId location);
+    void accept(ASTVisitor& visitor) override;
+    ASTNodeType getType()const override{ return ASTNodeType::WhileStatement;}
+    Expression* getCondition()const{ return condition_;}
+    ASTNode* getBody()const{ return body_;}
+    void setCondition(Expression* condition){ condition_ = condition;}
+    private:
+    Expression* condition_;
+    ASTNode* body_;
+};
+
+// REPEAT ... UNTIL condition: the body runs at least once, and again
+// while the condition is false
+class RepeatStatement : public ASTNode{
+    public:
+    RepeatStatement(ASTNode* body, Expression* condition, common::LocationId location);
+    void accept(ASTVisitor& visitor) override;
+    ASTNodeType getType()const override{ return ASTNodeType::RepeatStatement;}
+    ASTNode* getBody()const{ return body_;}
+    Expression* getCondition()const{ return condition_;}
+    void setCondition(Expression* condition){ condition_ = condition;}
+    private:
+    ASTNode* body_;
+    Expression* condition_;
+};
+
+
+// SWITCH selector ... CASE v1, v2 ... DEFAULT ... ENDSWITCH. The selector
+// is evaluated once, as a number; the body of the CASE listing its value
+// runs, or the DEFAULT body when no CASE does. Case values are integer
+// constants, each listed once per SWITCH.
+class SwitchStatement : public ASTNode{
+    public:
+    struct Case{
+        std::vector<std::int32_t> values;
+        ASTNode* body;
+    };
+    SwitchStatement(Expression* selector, std::vector<Case> cases, ASTNode* defaultBody,
+                    common::LocationId location);
+    void accept(ASTVisitor& visitor) override;
+    ASTNodeType getType()const override{ return ASTNodeType::SwitchStatement;}
+    Expression* getSelector()const{ return selector_;}
+    // in source order
+    const std::vector<Case>& getCases()const{ return cases_;}
+    // null without DEFAULT
+    ASTNode* getDefault()const{ return default_;}
+    void setSelector(Expression* selector){ selector_ = selector;}
+    // the body that runs for `selector` (null when nothing does), found by
+    // binary search
+    ASTNode* select(double selector)const;
+    private:
+    Expression* selector_;
+    std::vector<Case> cases_;
+    ASTNode* default_;
+    // every case value and its body, sorted by value
+    std::vector<std::pair<std::int32_t, ASTNode*>> byValue_;
+};
+
+
+// Result of a parse: the root block and the arena owning every node of
+// the tree. Moving the handle keeps node addresses stable.
+class Program{
+    public:
+    Program() = default;
+    Program(std::unique_ptr<Arena> arena, FunctionBlock* root)
+    : arena_{std::move(arena)}, root_{root} {}
+
+    FunctionBlock* get()const{ return root_;}
+    FunctionBlock* operator->()const{ return root_;}
+    FunctionBlock& operator*()const{ return *root_;}
+    explicit operator bool()const{ return root_ != nullptr;}
+    Arena* getArena()const{ return arena_.get();}
+    // the module's main program: its first top-level DEF (nullptr if none)
+    FunctionDeclaration* getEntry()const;
+
+    private:
+    std::unique_ptr<Arena> arena_;
+    FunctionBlock* root_ = nullptr;
+};
 
+// The DEFs calls can reach: the program's top-level ones, by name. A name
+// defined twice keeps its first DEF.
+using FunctionTable = std::unordered_map<std::string, FunctionDeclaration*>;
+FunctionTable functionTable(const FunctionBlock* program);
 
 
 }
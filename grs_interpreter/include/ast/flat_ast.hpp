@@ -0,0 +1,140 @@
+#ifndef FLAT_AST_HPP_
+#define FLAT_AST_HPP_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ast.hpp"
+
+namespace grs_ast{
+
+using NodeId = std::uint32_t;
+using NameId = std::uint32_t;
+constexpr NodeId NO_NODE = UINT32_MAX;
+
+// Compact, index-based copy of a parsed tree.
+//
+// Every node gets a 32-bit NodeId. Per node only its kind and its slot in
+// the table for that kind are stored; the fields live in one contiguous
+// table per kind (all binaries together, all literals together, ...).
+// Children are NodeIds, names are NameIds into a string table and source
+// locations sit in a side table of LocationIds. Nodes are numbered in post-order, so
+// children always come before their parent and a pass that only needs
+// that guarantee can run as a linear sweep over the tables.
+class FlatAst{
+    public:
+    struct Binary{ grs_lexer::TokenType op; NodeId left; NodeId right; };
+    struct Unary{ grs_lexer::TokenType op; NodeId operand; };
+    struct Variable{ NameId name; };
+    struct VariableDecl{ grs_lexer::TokenType dataType; NameId name; NodeId initializer; };
+    struct Argument{ NameId name; NodeId value; };
+    // Position, Frame and Axis declarations
+    struct StructDecl{ NameId name; std::uint32_t firstArg; std::uint32_t argCount; };
+    struct Motion{ NameId command; NameId name; std::uint32_t firstArg; std::uint32_t argCount; };
+    // P1->x := value
+    struct MemberAssign{ NameId name; NameId member; NodeId value; };
+    struct If{ NodeId condition; NodeId thenBranch; NodeId elseBranch; };
+    struct For{ NameId counter; NodeId start; NodeId end; std::int32_t step; NodeId body; };
+    // WHILE and REPEAT, told apart by their kind
+    struct Loop{ NodeId condition; NodeId body; };
+    // its CASE values are caseCount Cases from firstCase on, sorted by value
+    struct Switch{ NodeId selector; std::uint32_t firstCase; std::uint32_t caseCount; NodeId defaultBody; };
+    struct Case{ std::int32_t value; NodeId body; };
+    struct Block{ std::uint32_t firstChild; std::uint32_t childCount; };
+    // its arguments are argCount children from firstArg on
+    struct Call{ NameId name; std::uint32_t firstArg; std::uint32_t argCount; };
+    struct Parameter{ grs_lexer::TokenType type; NameId name; };
+    // DEF; body is NO_NODE when it failed to parse. Its locals (parameters
+    // first, as FunctionDeclaration::getLocals) are localCount names from
+    // firstLocal on
+    struct Function{
+        NameId name;
+        NodeId body;
+        std::uint32_t firstParam;
+        std::uint32_t paramCount;
+        std::uint32_t firstLocal;
+        std::uint32_t localCount;
+        grs_lexer::TokenType returnType;
+    };
+
+    // parses any DEF body that is still pending
+    static FlatAst fromTree(FunctionBlock& root);
+
+    NodeId getRoot()const{ return root_;}
+    size_t size()const{ return kinds_.size();}
+    ASTNodeType getKind(NodeId node)const{ return kinds_[node];}
+
+    const Binary& getBinary(NodeId node)const{ return binaries_[slots_[node]];}
+    const Unary& getUnary(NodeId node)const{ return unaries_[slots_[node]];}
+    const common::ValueType& getLiteral(NodeId node)const{ return literals_[slots_[node]];}
+    const Variable& getVariable(NodeId node)const{ return variables_[slots_[node]];}
+    const VariableDecl& getVariableDecl(NodeId node)const{ return variableDecls_[slots_[node]];}
+    const StructDecl& getStructDecl(NodeId node)const{ return structDecls_[slots_[node]];}
+    const Motion& getMotion(NodeId node)const{ return motions_[slots_[node]];}
+    const MemberAssign& getMemberAssign(NodeId node)const{ return memberAssigns_[slots_[node]];}
+    const If& getIf(NodeId node)const{ return ifs_[slots_[node]];}
+    const For& getFor(NodeId node)const{ return fors_[slots_[node]];}
+    const Loop& getLoop(NodeId node)const{ return loops_[slots_[node]];}
+    const Switch& getSwitch(NodeId node)const{ return switches_[slots_[node]];}
+    double getWaitTime(NodeId node)const{ return waitTimes_[slots_[node]];}
+    const Block& getBlock(NodeId node)const{ return blocks_[slots_[node]];}
+    const Function& getFunction(NodeId node)const{ return functions_[slots_[node]];}
+    const Call& getCall(NodeId node)const{ return calls_[slots_[node]];}
+    // NO_NODE for a bare RETURN
+    NodeId getReturnValue(NodeId node)const{ return returns_[slots_[node]];}
+
+    NodeId getChild(const Block& block, std::uint32_t index)const{ return children_[block.firstChild + index];}
+    NodeId getArg(const Call& call, std::uint32_t index)const{ return children_[call.firstArg + index];}
+    const Argument& getArgument(std::uint32_t index)const{ return arguments_[index];}
+    const Case& getCase(std::uint32_t index)const{ return cases_[index];}
+    const Parameter& getParameter(std::uint32_t index)const{ return parameters_[index];}
+    NameId getLocal(std::uint32_t index)const{ return locals_[index];}
+    // the body that runs for `selector`, as SwitchStatement::select
+    NodeId select(const Switch& node, double selector)const;
+    const std::string& getName(NameId name)const{ return names_[name];}
+    common::LocationId getLocation(NodeId node)const{ return locations_[node];}
+
+    // whole tables, for linear sweeps
+    const std::vector<ASTNodeType>& getKinds()const{ return kinds_;}
+    const std::vector<Binary>& getBinaries()const{ return binaries_;}
+    const std::vector<common::ValueType>& getLiterals()const{ return literals_;}
+    const std::vector<common::LocationId>& getLocations()const{ return locations_;}
+
+    private:
+    friend class FlatAstBuilder;
+
+    NodeId root_ = NO_NODE;
+    std::vector<ASTNodeType> kinds_;
+    std::vector<std::uint32_t> slots_;
+    std::vector<common::LocationId> locations_;
+
+    std::vector<Binary> binaries_;
+    std::vector<Unary> unaries_;
+    std::vector<common::ValueType> literals_;
+    std::vector<Variable> variables_;
+    std::vector<VariableDecl> variableDecls_;
+    std::vector<StructDecl> structDecls_;
+    std::vector<Motion> motions_;
+    std::vector<MemberAssign> memberAssigns_;
+    std::vector<If> ifs_;
+    std::vector<For> fors_;
+    std::vector<Loop> loops_;
+    std::vector<Switch> switches_;
+    std::vector<double> waitTimes_;
+    std::vector<Block> blocks_;
+    std::vector<Function> functions_;
+    std::vector<Call> calls_;
+    std::vector<NodeId> returns_;
+
+    std::vector<NodeId> children_;
+    std::vector<Argument> arguments_;
+    std::vector<Case> cases_;
+    std::vector<Parameter> parameters_;
+    std::vector<NameId> locals_;
+    std::vector<std::string> names_;
+};
+
+}
+
+#endif //FLAT_AST_HPP_
@@ -0,0 +1,90 @@
+#ifndef OPTIMIZER_HPP_
+#define OPTIMIZER_HPP_
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "ast.hpp"
+#include "arena.hpp"
+#include "visitor.hpp"
+
+namespace grs_ast{
+
+struct OptimizerStats{
+    size_t nodesBefore = 0;
+    size_t nodesAfter = 0;
+    // operator nodes replaced by their value
+    size_t foldedExpressions = 0;
+    // variable reads replaced by the value of their DECL
+    size_t propagatedConstants = 0;
+    // IF branches dropped because their condition is known
+    size_t removedBranches = 0;
+
+    size_t getRemovedNodes()const{ return nodesBefore - nodesAfter;}
+};
+
+std::ostream& operator<<(std::ostream& os, const OptimizerStats& stats);
+
+// Rewrites the part of the program that runs (top-level statements and the
+// body of the first DEF) before code generation:
+//  - operators on literals become a literal, except a division by zero,
+//    which is left for run time to report;
+//  - reads of an INT or REAL declared once at the top of the program and
+//    never assigned become its value, from the DECL up to the first
+//    statement that may hand a MOTION or WAIT to the host (which may then
+//    change variables through Vm::setVariable);
+//  - an IF whose condition folds keeps only the branch that is taken.
+// The bodies of called DEFs are not rewritten, but what they declare and
+// write keeps the main program's variables from being taken as constants.
+// Folded values are what the generator would compute, so the generated
+// instructions do not change. A NOT is only folded where its boolean
+// result and the 1/0 literal replacing it are read the same way.
+class Optimizer : public ASTVisitorBase{
+
+    public:
+    // new literals are allocated in `arena`, which must live as long as the tree
+    OptimizerStats optimize(FunctionBlock* program, Arena& arena);
+
+    void visit(FunctionBlock& node) override;
+    void visit(FunctionDeclaration& node) override;
+    void visit(BinaryExpression& node) override;
+    void visit(VariableDeclaration& node) override;
+    void visit(FrameDeclaration& node) override;
+    void visit(PositionDeclaration& node) override;
+    void visit(AxisDeclaration& node) override;
+    void visit(ExecutePosAndAxisExpression& node) override;
+    void visit(IfStatement& node) override;
+    void visit(ForStatement& node) override;
+    void visit(WhileStatement& node) override;
+    void visit(RepeatStatement& node) override;
+    void visit(SwitchStatement& node) override;
+    void visit(CallExpression& node) override;
+    void visit(ReturnStatement& node) override;
+
+    private:
+    Arena* arena_ = nullptr;
+    OptimizerStats stats_;
+    bool entrySeen_ = false;
+    // > 0 inside IF and SWITCH branches and loops, where a DECL may not run,
+    // or run again
+    int branchDepth_ = 0;
+    std::unordered_map<std::string, int> declarations_;
+    std::unordered_map<std::string, bool> written_;
+    std::unordered_map<std::string, double> constants_;
+    // set once a statement that may yield to the host has been reached
+    bool hostMayWrite_ = false;
+    const FunctionTable* functions_ = nullptr;
+    const std::unordered_set<const FunctionDeclaration*>* yielding_ = nullptr;
+
+    // `numeric`: the consumer reads true/false and 1/0 alike
+    Expression* fold(Expression* expr, bool numeric);
+    Expression* literal(double value);
+    template<typename NodeType>
+    void foldArgs(NodeType& node);
+    void foldCallArgs(CallExpression& node);
+};
+
+}
+
+#endif //OPTIMIZER_HPP_
@@ -12,13 +12,19 @@ class BinaryExpression;
 class UnaryExpression;
 class LiteraExpression;
 class VariableExpression;
+class CallExpression;
 class VariableDeclaration;
 class FrameDeclaration;
 class PositionDeclaration;
 class AxisDeclaration;
 class IfStatement;
+class ForStatement;
+class WhileStatement;
+class RepeatStatement;
+class SwitchStatement;
 class WaitStatement;
 class FunctionDeclaration;
+class ReturnStatement;
 class ExecutePosAndAxisExpression;
 
 //Visitor interface
@@ -32,14 +38,20 @@ class ExecutePosAndAxisExpression;
         virtual void visit(UnaryExpression& node) = 0;
         virtual void visit(LiteraExpression& node) = 0;
         virtual void visit(VariableExpression& node) = 0;
+        virtual void visit(CallExpression& node) = 0;
         virtual void visit(VariableDeclaration& node) = 0;
         virtual void visit(FrameDeclaration& node) = 0;
         virtual void visit(PositionDeclaration& node) = 0;
         virtual void visit(AxisDeclaration& node) = 0;
         virtual void visit(ExecutePosAndAxisExpression& node) = 0;
         virtual void visit(IfStatement& node) = 0;
+        virtual void visit(ForStatement& node) = 0;
+        virtual void visit(WhileStatement& node) = 0;
+        virtual void visit(RepeatStatement& node) = 0;
+        virtual void visit(SwitchStatement& node) = 0;
         virtual void visit(WaitStatement& node) = 0;
         virtual void visit(FunctionDeclaration& node) = 0;
+        virtual void visit(ReturnStatement& node) = 0;
 
     };
 
@@ -51,13 +63,19 @@ class ExecutePosAndAxisExpression;
         void visit(UnaryExpression& node) override {}
         void visit(LiteraExpression& node) override {}
         void visit(VariableExpression& node) override {}
+        void visit(CallExpression& node) override {}
         void visit(VariableDeclaration& node) override {}
         void visit(FrameDeclaration& node) override{}
         void visit(PositionDeclaration& node) override{}
         void visit(AxisDeclaration& node) override{}
         void visit(IfStatement& node) override {}
+        void visit(ForStatement& node) override {}
+        void visit(WhileStatement& node) override {}
+        void visit(RepeatStatement& node) override {}
+        void visit(SwitchStatement& node) override {}
         void visit(WaitStatement& node) override {}
         void visit(FunctionDeclaration& node) override {}
+        void visit(ReturnStatement& node) override {}
         void visit(ExecutePosAndAxisExpression& node) override {}
 
     };
@@ -0,0 +1,31 @@
+#ifndef COMMON_CALL_STACK_HPP_
+#define COMMON_CALL_STACK_HPP_
+
+#include <cstdint>
+#include "../lexer/token.hpp"
+#include "int_conversion.hpp"
+
+namespace common{
+
+// Calls nest at most this deep unless the instruction generator or the VM
+// is given another limit; a call that would go deeper is reported and
+// yields 0 instead of running. The generator recurses on the host's stack
+// for every nested call, so the limit also keeps runaway recursion from
+// exhausting it.
+constexpr std::uint32_t DEFAULT_CALL_DEPTH = 256;
+
+// What a call yields for the number its DEF returned: the value a variable
+// of the DEF's return type would hold (no return type, ENDOFFILE: the
+// number itself). Shared by the instruction generator and the VM; an INT
+// result the number does not fit is reported and clamped.
+inline double returnValue(grs_lexer::TokenType type, double value){
+    switch(type){
+        case grs_lexer::TokenType::INT:  return static_cast<double>(storeInt(value));
+        case grs_lexer::TokenType::BOOL: return value != 0.0 ? 1.0 : 0.0;
+        default:                         return value;
+    }
+}
+
+}
+
+#endif //COMMON_CALL_STACK_HPP_
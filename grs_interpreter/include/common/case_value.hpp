@@ -0,0 +1,25 @@
+#ifndef COMMON_CASE_VALUE_HPP_
+#define COMMON_CASE_VALUE_HPP_
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace common{
+
+// The CASE value a SWITCH selector, read as a number, picks; shared by the
+// instruction generator and the VM so both take the same branch. A number
+// no INT holds (a fraction, NaN, out of range) picks no CASE, only DEFAULT.
+inline bool caseValue(double selector, std::int32_t& value){
+    if(!(selector >= std::numeric_limits<std::int32_t>::min() &&
+         selector <= std::numeric_limits<std::int32_t>::max()) ||
+       selector != std::trunc(selector)){
+        return false;
+    }
+    value = static_cast<std::int32_t>(selector);
+    return true;
+}
+
+}
+
+#endif //COMMON_CASE_VALUE_HPP_
@@ -0,0 +1,48 @@
+#ifndef COMMON_COUNTED_LOOP_HPP_
+#define COMMON_COUNTED_LOOP_HPP_
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "int_conversion.hpp"
+
+namespace common{
+
+// Turns of a FOR loop, shared by the instruction generator and the VM so
+// both run the same ones. The counter is an INT: start is truncated, and
+// end becomes the last INT value the counter may take, so each turn is
+// one integer add and compare. The loop also ends when the next value
+// would not fit an INT; the counter then keeps its last value.
+struct CountedLoop{
+    std::int32_t counter = 0;
+    std::int32_t limit = 0;
+    std::int32_t step = 1;
+    // an end that is not a number (NaN) is never reached from either side
+    bool empty = false;
+
+    CountedLoop() = default;
+    CountedLoop(double start, double end, std::int32_t stepBy) : step{stepBy} {
+        counter = toInt(std::trunc(start));
+        empty = std::isnan(end);
+        limit = empty ? 0 : toInt(step > 0 ? std::floor(end) : std::ceil(end));
+    }
+
+    bool inRange()const{
+        return !empty && (step > 0 ? counter <= limit : counter >= limit);
+    }
+
+    // false, leaving the counter as it is, when the next value is no INT
+    bool advance(){
+        const std::int64_t next = static_cast<std::int64_t>(counter) + step;
+        if(next > std::numeric_limits<std::int32_t>::max() || next < std::numeric_limits<std::int32_t>::min()){
+            return false;
+        }
+        counter = static_cast<std::int32_t>(next);
+        return true;
+    }
+};
+
+}
+
+#endif //COMMON_COUNTED_LOOP_HPP_
@@ -0,0 +1,44 @@
+#ifndef COMMON_INT_CONVERSION_HPP_
+#define COMMON_INT_CONVERSION_HPP_
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+
+namespace common{
+
+// Number to INT, shared by the instruction generator, the VM and the loop
+// and call helpers so all of them truncate the same way.
+
+// true when dropping the fraction of `value` gives an INT (NaN does not)
+inline bool fitsInt(double value){
+    return value > static_cast<double>(std::numeric_limits<std::int32_t>::min()) - 1.0 &&
+           value < static_cast<double>(std::numeric_limits<std::int32_t>::max()) + 1.0;
+}
+
+// `value` without its fraction; clamped to the INT range, NaN gives 0
+inline std::int32_t toInt(double value){
+    if(std::isnan(value)){
+        return 0;
+    }
+    if(value >= static_cast<double>(std::numeric_limits<std::int32_t>::max())){
+        return std::numeric_limits<std::int32_t>::max();
+    }
+    if(value <= static_cast<double>(std::numeric_limits<std::int32_t>::min())){
+        return std::numeric_limits<std::int32_t>::min();
+    }
+    return static_cast<std::int32_t>(value);
+}
+
+// toInt() for a number stored as an INT; one that does not fit is reported
+inline std::int32_t storeInt(double value){
+    if(!fitsInt(value)){
+        std::cerr << "Error: Cannot convert " << value << " to INT" << std::endl;
+    }
+    return toInt(value);
+}
+
+}
+
+#endif //COMMON_INT_CONVERSION_HPP_
@@ -0,0 +1,118 @@
+#ifndef COMMON_SOURCE_LOCATION_HPP_
+#define COMMON_SOURCE_LOCATION_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace common{
+
+// A source position packed into 32 bits: files are laid out one after the
+// other in a single id space, and inside a file the id is the byte offset
+// of the position. Nodes and instructions carry only the id; line and
+// column are recovered through the file's line-start index, which is only
+// needed when an error, trace or dump actually prints a position.
+using LocationId = std::uint32_t;
+using FileId = std::uint32_t;
+constexpr LocationId NO_LOCATION = UINT32_MAX;
+
+struct SourceLocation{
+    FileId file;
+    int line;
+    int column;
+};
+
+class LocationTable{
+    public:
+    // offsets at which each line starts; the text is treated as if it ended
+    // with a newline, so the last entry is where the line after the last
+    // one (the ENDOFFILE position) starts
+    static std::vector<std::uint32_t> lineStartsOf(std::string_view text){
+        std::vector<std::uint32_t> starts{0};
+        const char* begin = text.data();
+        const char* end = begin + text.size();
+        for(const char* p = begin; p < end; ++p){
+            p = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+            if(!p){
+                break;
+            }
+            starts.push_back(static_cast<std::uint32_t>(p - begin + 1));
+        }
+        if(!text.empty() && text.back() != '\n'){
+            starts.push_back(static_cast<std::uint32_t>(text.size() + 1));
+        }
+        return starts;
+    }
+
+    FileId addFile(std::string name, std::string_view text){
+        return addFile(std::move(name), lineStartsOf(text));
+    }
+
+    FileId addFile(std::string name, std::vector<std::uint32_t> lineStarts){
+        const LocationId base = files_.empty() ? 0 : files_.back().base + files_.back().lineStarts.back() + 1;
+        files_.push_back({std::move(name), base, std::move(lineStarts)});
+        return static_cast<FileId>(files_.size() - 1);
+    }
+
+    // re-indexes the most recently added file, e.g. after an edit; ids of
+    // the files before it stay valid
+    void setLineStarts(FileId file, std::vector<std::uint32_t> lineStarts){
+        if(file + 1 != files_.size()){
+            throw std::logic_error("Only the last file of a location table can change");
+        }
+        files_[file].lineStarts = std::move(lineStarts);
+    }
+
+    // 1-based line and column, as the lexer counts them. A column past the
+    // end of its line is clamped to the line's newline; a line outside the
+    // file has no location
+    LocationId encode(FileId file, int line, int column)const{
+        const File& f = files_[file];
+        if(line < 1 || static_cast<size_t>(line) > f.lineStarts.size() || column < 1){
+            return NO_LOCATION;
+        }
+        const std::uint32_t start = f.lineStarts[line - 1];
+        std::uint32_t offset = start + static_cast<std::uint32_t>(column - 1);
+        if(static_cast<size_t>(line) < f.lineStarts.size()){
+            offset = std::min(offset, f.lineStarts[line] - 1);
+        } else {
+            offset = start;
+        }
+        return f.base + offset;
+    }
+
+    SourceLocation decode(LocationId id)const{
+        auto fileIt = std::upper_bound(files_.begin(), files_.end(), id,
+                                       [](LocationId value, const File& f){ return value < f.base; });
+        const File& f = *(fileIt - 1);
+        const std::uint32_t offset = id - f.base;
+        auto lineIt = std::upper_bound(f.lineStarts.begin(), f.lineStarts.end(), offset);
+        const auto line = static_cast<int>(lineIt - f.lineStarts.begin());
+        return {static_cast<FileId>(fileIt - 1 - files_.begin()), line, static_cast<int>(offset - *(lineIt - 1)) + 1};
+    }
+
+    std::pair<int,int> lineColumn(LocationId id)const{
+        const SourceLocation location = decode(id);
+        return {location.line, location.column};
+    }
+
+    const std::string& getFileName(FileId file)const{ return files_[file].name;}
+    size_t getFileCount()const{ return files_.size();}
+
+    private:
+    struct File{
+        std::string name;
+        LocationId base;
+        std::vector<std::uint32_t> lineStarts;
+    };
+    std::vector<File> files_;
+};
+
+}
+
+#endif //COMMON_SOURCE_LOCATION_HPP_
@@ -7,7 +7,6 @@
 #include <memory>
 #include <unordered_map>
 #include <map>
-#include "ast/visitor.hpp"
 
 namespace common{
 
@@ -81,7 +80,7 @@ std::enable_if_t<std::is_same_v<StructType, Position> ||
     }
 
 
-using ValueType = std::variant<int, double, bool, std::string, std::shared_ptr<grs_ast::Expression>, Position, Frame, Axis>;  
+using ValueType = std::variant<int, double, bool, std::string, Position, Frame, Axis>;  
 
 
 
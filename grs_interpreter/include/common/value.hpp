@@ -0,0 +1,137 @@
+#ifndef COMMON_VALUE_HPP_
+#define COMMON_VALUE_HPP_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "utils.hpp"
+
+namespace common{
+
+enum class ValueKind : std::uint8_t{
+    INT, REAL, BOOL, STRING, POSITION, FRAME, AXIS
+};
+
+// Runtime value in 16 bytes: a kind and an 8-byte payload. Numbers are held
+// inline; strings and the POS / FRAME / AXIS structs live in a ValuePool
+// and the value only carries their handle, so copying a Value never
+// allocates and never copies a struct.
+class Value{
+
+    public:
+    Value() : Value(0.0) {}
+    Value(double real) : kind_{ValueKind::REAL}, real_{real} {}
+
+    static Value ofInt(std::int32_t integer){ Value v; v.kind_ = ValueKind::INT; v.integer_ = integer; return v;}
+    static Value ofBool(bool boolean){ Value v; v.kind_ = ValueKind::BOOL; v.boolean_ = boolean; return v;}
+    // STRING, POSITION, FRAME or AXIS stored at `handle` of a ValuePool
+    static Value ofHandle(ValueKind kind, std::uint32_t handle){ Value v; v.kind_ = kind; v.handle_ = handle; return v;}
+
+    ValueKind kind()const{ return kind_;}
+    bool isNumber()const{ return kind_ == ValueKind::INT || kind_ == ValueKind::REAL || kind_ == ValueKind::BOOL;}
+    // INT, REAL and BOOL as a double (true is 1.0); false for anything else
+    bool toNumber(double& out)const{
+        switch(kind_){
+            case ValueKind::REAL: out = real_; return true;
+            case ValueKind::INT:  out = integer_; return true;
+            case ValueKind::BOOL: out = boolean_ ? 1.0 : 0.0; return true;
+            default:              return false;
+        }
+    }
+    double getReal()const{ return real_;}
+    std::int32_t getInt()const{ return integer_;}
+    bool getBool()const{ return boolean_;}
+    std::uint32_t getHandle()const{ return handle_;}
+
+    private:
+    ValueKind kind_;
+    union{
+        double real_;
+        std::int32_t integer_;
+        bool boolean_;
+        std::uint32_t handle_;
+    };
+};
+
+static_assert(sizeof(Value) == 16, "Value is meant to fit in 16 bytes");
+
+// Owns what a Value refers to: interned strings and the structs, each kind
+// in its own vector. Handles stay valid for the pool's lifetime.
+class ValuePool{
+
+    public:
+    // equal strings share one handle
+    std::uint32_t intern(std::string_view text){
+        auto it = stringIds_.find(std::string(text));
+        if(it != stringIds_.end()){
+            return it->second;
+        }
+        strings_.emplace_back(text);
+        const auto id = static_cast<std::uint32_t>(strings_.size() - 1);
+        stringIds_.emplace(strings_.back(), id);
+        return id;
+    }
+    const std::string& getString(std::uint32_t handle)const{ return strings_[handle];}
+
+    template<class StructType>
+    std::uint32_t add(const StructType& value){
+        auto& pool = structs<StructType>();
+        pool.push_back(value);
+        return static_cast<std::uint32_t>(pool.size() - 1);
+    }
+    template<class StructType>
+    StructType& get(std::uint32_t handle){ return structs<StructType>()[handle];}
+    template<class StructType>
+    const StructType& get(std::uint32_t handle)const{ return structs<StructType>()[handle];}
+
+    // the boundary with ValueType, for constants coming from the AST and
+    // values handed to the executor or the host
+    Value toValue(const ValueType& value){
+        if(auto val = std::get_if<int>(&value)) return Value::ofInt(*val);
+        if(auto val = std::get_if<double>(&value)) return Value(*val);
+        if(auto val = std::get_if<bool>(&value)) return Value::ofBool(*val);
+        if(auto val = std::get_if<std::string>(&value)) return Value::ofHandle(ValueKind::STRING, intern(*val));
+        if(auto val = std::get_if<Position>(&value)) return Value::ofHandle(ValueKind::POSITION, add(*val));
+        if(auto val = std::get_if<Frame>(&value)) return Value::ofHandle(ValueKind::FRAME, add(*val));
+        return Value::ofHandle(ValueKind::AXIS, add(std::get<Axis>(value)));
+    }
+    ValueType toValueType(Value value)const{
+        switch(value.kind()){
+            case ValueKind::INT:      return value.getInt();
+            case ValueKind::REAL:     return value.getReal();
+            case ValueKind::BOOL:     return value.getBool();
+            case ValueKind::STRING:   return getString(value.getHandle());
+            case ValueKind::POSITION: return get<Position>(value.getHandle());
+            case ValueKind::FRAME:    return get<Frame>(value.getHandle());
+            case ValueKind::AXIS:     return get<Axis>(value.getHandle());
+        }
+        return 0.0;
+    }
+
+    private:
+    std::vector<std::string> strings_;
+    std::unordered_map<std::string, std::uint32_t> stringIds_;
+    std::vector<Position> positions_;
+    std::vector<Frame> frames_;
+    std::vector<Axis> axes_;
+
+    template<class StructType>
+    std::vector<StructType>& structs(){
+        if constexpr(std::is_same_v<StructType, Position>) return positions_;
+        else if constexpr(std::is_same_v<StructType, Frame>) return frames_;
+        else return axes_;
+    }
+    template<class StructType>
+    const std::vector<StructType>& structs()const{
+        if constexpr(std::is_same_v<StructType, Position>) return positions_;
+        else if constexpr(std::is_same_v<StructType, Frame>) return frames_;
+        else return axes_;
+    }
+};
+
+}
+
+#endif //COMMON_VALUE_HPP_
@@ -2,58 +2,45 @@
 #define EXECUTOR_HPP
 
 #include "interpreter/instruction_generator.hpp" 
+#include "vm/vm.hpp"
 #include "state_machine.hpp"
 #include <queue>
 
 namespace grs_interpreter{
 
 using namespace common;
-using prStringAndValueType = const std::pair<std::string, common::ValueType>& ;
 
 
     class Executor{
 
     public:
     Executor();
-    void executeInstruction(std::vector<Instruction> instruction);
-
-    void executeLinMotion(prStringAndValueType args);
-    void executePtpMotion(prStringAndValueType args);
-    void executeCirclMotion(prStringAndValueType args);
-    void executeWaitCommand(prStringAndValueType args);
+    void executeInstruction(const InstructionList& instructions);
+    // pulls commands from the VM until the program ends; branches are
+    // decided by the VM as it reaches them
+    void run(grs_vm::Vm& vm);
+    void executeCommand(const Instruction& inst, const InstructionList& instructions);
+
+    void executeLinMotion(const common::ValueType& position);
+    void executePtpMotion(const common::ValueType& position);
+    void executeCirclMotion(const common::ValueType& position);
+    void executeWaitCommand(const common::ValueType& duration);
     
     void mockLinearMotion(double& x, double& y, double& z);
     void mockPtpMotion(double& x, double& y, double& z);
     void mockCircMotion(double& x, double& y, double& z);
+    void mockAxisMotion(const char* motion, const common::Axis& axis);
     void mockWaitFunc(int t);
 
     private:
     StateMachine stateMachine_;
     void setupStateMachine();
+    // x, y, z of a POS or FRAME target
+    static common::Position cartesianTarget(const common::ValueType& position);
 
 
 };
 
-enum class CommandCategories{
-
-    LIN,
-    PTP,
-    CIRC,
-    WAIT
-
-};
-
-inline constexpr auto typeToStringCommand = cxmap::ConstexprMap<std::string_view, CommandCategories, 4>({{
-
-{"LIN",CommandCategories::LIN},
-{"PTP", CommandCategories::PTP},
-{"CIRC", CommandCategories::CIRC},
-{"WAIT", CommandCategories::WAIT}
- 
-}
-});
-
-
 }
 
 
@@ -0,0 +1,67 @@
+#ifndef INSTRUCTION_HPP_
+#define INSTRUCTION_HPP_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "../common/utils.hpp"
+#include "../common/source_location.hpp"
+#include "../lexer/token.hpp"
+
+namespace grs_interpreter{
+
+enum class Opcode : std::uint8_t{
+    DECL,           // name = variable, type = data type, value = initial value
+    ASSIGN,         // name = variable, value = stored value
+    POSITION_DECL,  // name = variable, value = the POS
+    FRAME_DECL,     // name = variable, value = the FRAME
+    AXIS_DECL,      // name = variable, value = the AXIS
+    MOTION,         // type = motion token (LIN, PTP_REL...), name = position variable, value = its value
+    WAIT,           // value = duration in seconds
+    IF_START,       // value = the condition's result
+    THEN_BLOCK,
+    ELSE_BLOCK,
+    IF_END
+};
+
+constexpr std::uint32_t NO_INDEX = UINT32_MAX;
+
+// Fixed-width and heap-free: strings and values live in the pools of the
+// InstructionList the instruction belongs to
+struct Instruction{
+    Opcode op = Opcode::IF_END;
+    std::uint8_t reserved = 0;          // spelled out so cached bytes are deterministic
+    std::uint16_t type = 0;             // a grs_lexer::TokenType, see Opcode
+    std::uint32_t name = NO_INDEX;      // into InstructionList::names
+    std::uint32_t value = NO_INDEX;     // into InstructionList::constants
+    // decoded through the LocationTable the program was parsed with
+    common::LocationId location = common::NO_LOCATION;
+
+    grs_lexer::TokenType getType()const{ return static_cast<grs_lexer::TokenType>(type);}
+};
+static_assert(sizeof(Instruction) == 16, "Instruction is meant to stay 16 bytes");
+
+struct InstructionList{
+    std::vector<Instruction> code;
+    std::vector<std::string> names;
+    std::vector<common::ValueType> constants;
+
+    size_t size()const{ return code.size();}
+    bool empty()const{ return code.empty();}
+    const std::string& getName(const Instruction& instruction)const{ return names[instruction.name];}
+    const common::ValueType& getValue(const Instruction& instruction)const{ return constants[instruction.value];}
+
+    // the readable form the dump prints: "LIN", "DECL_a", "Position_DECL"...
+    // and the named arguments of the instruction
+    std::string commandName(const Instruction& instruction)const;
+    std::vector<std::pair<std::string, common::ValueType>> arguments(const Instruction& instruction)const;
+};
+
+// LIN, PTP_REL, SPL... back to their token; ENDOFFILE for anything else
+grs_lexer::TokenType motionType(std::string_view command);
+
+}
+
+#endif //INSTRUCTION_HPP_
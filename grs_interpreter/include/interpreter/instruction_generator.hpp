@@ -1,23 +1,25 @@
 #ifndef INSTRUCTION_GENERATOR_HPP_
 #define INSTRUCTION_GENERATOR_HPP_
 
+#include <functional>
 #include "../ast/ast.hpp"
+#include "../ast/flat_ast.hpp"
 #include "../ast/visitor.hpp"
+#include "../common/call_stack.hpp"
 #include "../common/utils.hpp"
+#include "../common/value.hpp"
+#include "../common/source_location.hpp"
+#include "instruction.hpp"
 
 namespace grs_interpreter{
     
 
-struct Instruction{
-
-    std::string command;
-    std::vector<std::pair<std::string, common::ValueType>> args;
-    std::vector<std::pair<int,int>> commandLocationInfo;
-};
-
 struct VariableInfo{
     grs_lexer::TokenType type;
     common::ValueType value;
+    // entries are made as soon as an expression names the variable, so
+    // compiled expressions can keep them; false until it is defined
+    bool declared;
 };
 
 class InstructionGenerator : public grs_ast::ASTVisitorBase{
@@ -26,7 +28,22 @@ class InstructionGenerator : public grs_ast::ASTVisitorBase{
     InstructionGenerator();
     ~InstructionGenerator();
 
-    std::vector<Instruction> generateInstructions(const std::shared_ptr<grs_ast::FunctionBlock>& program);
+    InstructionList generateInstructions(grs_ast::FunctionBlock* program);
+    // same instructions, generated from the flat representation
+    InstructionList generateInstructions(const grs_ast::FlatAst& program);
+
+    // Expressions of statements generated more than once (see repeating_)
+    // are compiled into nested callables bound to the variables they name,
+    // and kept until the next program, so running one again walks no tree
+    // and looks no name up. The others run once and are walked, which is
+    // cheaper than compiling them.
+    using CompiledExpression = std::function<common::Value()>;
+
+    // A call generates its DEF's body there and then, like an unrolled
+    // loop. The DEF's parameters and DECLs hide the caller's variables of
+    // the same name until it returns; past `limit` nested calls a call
+    // reports the limit and yields 0, as in the VM.
+    void setCallDepthLimit(std::uint32_t limit){ callDepthLimit_ = limit;}
 
     //visit methods
     void visit(grs_ast::FunctionBlock& node) override;
@@ -41,24 +58,111 @@ class InstructionGenerator : public grs_ast::ASTVisitorBase{
     void visit(grs_ast::AxisDeclaration& node) override;
     void visit(grs_ast::ExecutePosAndAxisExpression& node) override;
     void visit(grs_ast::IfStatement& node) override;
+    void visit(grs_ast::ForStatement& node) override;
+    void visit(grs_ast::WhileStatement& node) override;
+    void visit(grs_ast::RepeatStatement& node) override;
+    void visit(grs_ast::SwitchStatement& node) override;
     void visit(grs_ast::WaitStatement& node) override;
     void visit(grs_ast::FunctionDeclaration& node) override;
     void visit(grs_ast::UnaryExpression& node) override;
+    void visit(grs_ast::CallExpression& node) override;
+    void visit(grs_ast::ReturnStatement& node) override;
     
     private:
-    std::vector<Instruction> instruction_;
-    common::ValueType currentValue_;
-    common::ValueType evaluateExpression(const std::shared_ptr<grs_ast::Expression>& expr);
+    InstructionList program_;
+    std::unordered_map<std::string, std::uint32_t> nameIds_;
+    // what the last evaluation step left; a step with no value of its own
+    // (reading a BOOL or struct variable, assigning to an undefined one)
+    // yields it again
+    common::Value lastValue_;
+    // the strings evaluated values refer to
+    common::ValuePool strings_;
+    // set once the main program (the first DEF) has been generated
+    bool entryGenerated_ = false;
+    // above 0 while generating statements that will be generated again
+    std::uint32_t repeating_ = 0;
+    std::unordered_map<const grs_ast::Expression*, CompiledExpression> compiled_;
+    struct ExpressionCompiler;
+    common::ValueType evaluateExpression(grs_ast::Expression* expr);
+    // the expression visits walk; this evaluates a subexpression
+    common::Value walk(grs_ast::Expression* expr);
+
+    grs_ast::FunctionTable functions_;
+    std::unordered_map<grs_ast::NameId, grs_ast::NodeId> flatFunctions_;
+    // arguments of the calls being made, evaluated before the callee's
+    // locals hide anything
+    std::vector<double> arguments_;
+    // the hidden variables, restored when their call returns
+    struct SavedVariable{ VariableInfo* variable; VariableInfo value; };
+    std::vector<SavedVariable> savedVariables_;
+    std::uint32_t depth_ = 0;
+    std::uint32_t callDepthLimit_ = common::DEFAULT_CALL_DEPTH;
+    // set by a RETURN until its call (or, outside any, the program) ends
+    bool returning_ = false;
+    double returnValue_ = 0.0;
+    // calls the DEF `name` on the `count` numbers on top of arguments_,
+    // which it pops; returns its value and leaves it in lastValue_
+    common::Value call(const std::string& name, std::uint32_t count);
+    common::Value call(const grs_ast::FlatAst& flat, const grs_ast::FlatAst::Call& node);
+    // false (after reporting) when `name` cannot be called now
+    bool callable(const std::string& name, bool defined);
+    // hides `name` until the call being made returns
+    void hideVariable(const std::string& name);
+    // runs `body` as the callee and restores what it hid from `saved` on
+    template<typename Body>
+    common::Value runCall(size_t saved, grs_lexer::TokenType returnType, Body&& body);
+
+    // flat AST walk
+    void generate(const grs_ast::FlatAst& flat, grs_ast::NodeId node);
+    common::ValueType evaluate(const grs_ast::FlatAst& flat, grs_ast::NodeId node);
+    common::Value evaluateNode(const grs_ast::FlatAst& flat, grs_ast::NodeId node);
+
+    // shared by both walks; expression helpers return their result and
+    // leave it in lastValue_
+    common::Value applyBinary(grs_lexer::TokenType op, common::Value leftValue, common::Value rightValue);
+    bool isAssignable(const std::string& varName);
+    common::Value storeAssignment(const std::string& varName, VariableInfo& variable, common::Value rightValue);
+    common::Value applyUnary(grs_lexer::TokenType op, common::Value value);
+    // false for a value no literal holds
+    bool literalValue(const common::ValueType& value, common::Value& out);
+    common::Value loadLiteral(const common::ValueType& value);
+    // `variable` is null for a name never seen
+    common::Value loadVariable(const std::string& name, const VariableInfo* variable);
+    void emitVariableDeclaration(const std::string& name, grs_lexer::TokenType type,
+                                 const common::ValueType* initValue,
+                                 common::LocationId location);
+    void emit(Opcode op, const std::string* name, const common::ValueType* value,
+              common::LocationId location, grs_lexer::TokenType type = grs_lexer::TokenType::ENDOFFILE);
+    void emitMotion(const std::string& command, const std::string& name, common::LocationId location);
+    bool emitIfStart(const common::ValueType& conditionValue, common::LocationId location);
+    void emitBranch(bool thenBranch, common::LocationId location);
+    void emitIfEnd();
+    void emitWait(double wtime, common::LocationId location);
+
+    // Loops are unrolled: every turn emits its body's instructions again.
+    // An endless loop would never finish generating, so a loop stops, with
+    // an error, after LOOP_LIMIT turns.
+    static constexpr std::uint32_t LOOP_LIMIT = 1000000;
+    // false (after reporting) once `turns` reached LOOP_LIMIT; counts the turn
+    bool nextTurn(std::uint32_t& turns);
+    // `body()` and `condition()` generate the tree's or the flat nodes
+    template<typename Body>
+    void countedLoop(const std::string& counter, double start, double end, std::int32_t step, Body&& body);
+    // WHILE tests `condition()` before each turn; REPEAT (`repeat`) after
+    // it, and stops once it holds
+    template<typename Condition, typename Body>
+    void conditionLoop(bool repeat, Condition&& condition, Body&& body);
     
     std::unordered_map<std::string, VariableInfo> declaredVariables_;
     
     inline bool hasVariable(const std::string& name) const{
-        return declaredVariables_.find(name) != declaredVariables_.end();
+        auto it = declaredVariables_.find(name);
+        return it != declaredVariables_.end() && it->second.declared;
     }
 
     inline common::ValueType getVariableValue(const std::string& name) const{
         auto it = declaredVariables_.find(name);
-        return (it != declaredVariables_.end()) ? it->second.value : common::ValueType(0.0);
+        return (it != declaredVariables_.end() && it->second.declared) ? it->second.value : common::ValueType(0.0);
     }
     inline void setVariableValue(const std::string& name, const common::ValueType& value){
         if(hasVariable(name)) {
@@ -67,12 +171,15 @@ class InstructionGenerator : public grs_ast::ASTVisitorBase{
     }
     
     inline void assignPosAndAxisExpression( const std::string name, const std::string& argument, const double& value){
-        auto type = declaredVariables_[name].type;
+        // a member assignment defines the variable it names, even an undefined one
+        auto& variable = declaredVariables_[name];
+        variable.declared = true;
+        auto type = variable.type;
         std::cout<<grs_lexer::typeToStringMap.at(type)<<std::endl;
         switch (type)
         {
         case grs_lexer::TokenType::POS:{
-            auto& posStruct = std::get<common::Position>(declaredVariables_[name].value);
+            auto& posStruct = std::get<common::Position>(variable.value);
             if(argument == "x")posStruct.x = value;
             else if(argument == "y")posStruct.y = value;
             else if(argument == "z")posStruct.z = value;
@@ -81,7 +188,7 @@ class InstructionGenerator : public grs_ast::ASTVisitorBase{
             else if(argument == "c")posStruct.c = value;}
             break;
         case grs_lexer::TokenType::AXIS:
-            {auto& axisStruct = std::get<common::Axis>(declaredVariables_[name].value);
+            {auto& axisStruct = std::get<common::Axis>(variable.value);
             if(argument == "a1" )axisStruct.A1 = value;
             else if(argument == "a2")axisStruct.A2 = value;
             else if(argument == "a3")axisStruct.A3 = value;
@@ -129,7 +236,7 @@ class InstructionGenerator : public grs_ast::ASTVisitorBase{
         }
     }
     template<typename NodeType, class StrucType>
-    void executeDeclaration(NodeType& node, grs_lexer::TokenType type, const std::string& prefix)
+    void executeDeclaration(NodeType& node, grs_lexer::TokenType type, Opcode op)
     {   
         StrucType strucType;
         for(const auto& arg : node.getArgs()){
@@ -137,14 +244,30 @@ class InstructionGenerator : public grs_ast::ASTVisitorBase{
             auto val = std::get<double>(value);
             declarationType<StrucType>(strucType,arg.first, val);
         }
+        emitDeclaration(node.getName(), strucType, type, op, node.getLocation());
+    }
+
+    template<class StrucType>
+    void executeDeclaration(const grs_ast::FlatAst& flat, grs_ast::NodeId node, grs_lexer::TokenType type, Opcode op)
+    {
+        const auto& decl = flat.getStructDecl(node);
+        StrucType strucType;
+        for(std::uint32_t i = 0; i < decl.argCount; ++i){
+            const auto& arg = flat.getArgument(decl.firstArg + i);
+            auto value = evaluate(flat, arg.value);
+            auto val = std::get<double>(value);
+            declarationType<StrucType>(strucType, flat.getName(arg.name), val);
+        }
+        emitDeclaration(flat.getName(decl.name), strucType, type, op, flat.getLocation(node));
+    }
 
-        declaredVariables_[node.getName()] = {type, strucType};
-        Instruction instruction;
-        instruction.command = prefix + "_DECL";
-        instruction.commandLocationInfo = node.getLineColumn();
-        instruction.args.emplace_back("name", node.getName());
-        instruction.args.emplace_back(prefix, strucType);
-        instruction_.push_back(instruction);
+    template<class StrucType>
+    void emitDeclaration(const std::string& name, const StrucType& strucType, grs_lexer::TokenType type,
+                         Opcode op, common::LocationId location)
+    {
+        declaredVariables_[name] = {type, strucType, true};
+        const common::ValueType value = strucType;
+        emit(op, &name, &value, location);
     }
     
 
@@ -0,0 +1,55 @@
+#ifndef PROGRAM_CACHE_HPP_
+#define PROGRAM_CACHE_HPP_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "instruction_generator.hpp"
+
+#ifndef GRS_INTERPRETER_VERSION
+#define GRS_INTERPRETER_VERSION "dev"
+#endif
+
+namespace grs_interpreter{
+
+// Compiled-program cache (.grsc) next to the source file.
+//
+// The file holds the generated instructions, keyed by a hash of the source
+// text and the interpreter version. Locations are stored as LocationIds:
+// they are byte offsets into that same source, so a LocationTable built
+// from it decodes them. load() maps the file and returns the instructions
+// only when the key matches and the file is well formed; anything else is
+// a cache miss.
+//
+// Layout (host byte order):
+//   "GRSC" u32 formatVersion  u64 sourceHash  u64 sourceSize  str version
+//   u32 nameCount { str }  u32 constantCount { u8 kind  value }
+//   u32 instructionCount { Instruction, as its 16 bytes }
+// where str is a u32 length followed by the bytes.
+class ProgramCache{
+
+    public:
+    static constexpr std::uint32_t FORMAT_VERSION = 3;
+
+    explicit ProgramCache(std::string path);
+
+    // foo/program.src -> foo/program.grsc
+    static std::string pathFor(const std::string& sourcePath);
+    static std::uint64_t hashSource(std::string_view source);
+
+    std::optional<InstructionList> load(std::string_view source)const;
+    // false when the program holds values that cannot be cached or the file
+    // cannot be written; the previous cache file is left untouched then
+    bool store(std::string_view source, const InstructionList& instructions)const;
+
+    const std::string& getPath()const{ return path_;}
+
+    private:
+    std::string path_;
+};
+
+}
+
+#endif //PROGRAM_CACHE_HPP_
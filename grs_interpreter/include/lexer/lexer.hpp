@@ -3,11 +3,13 @@
 #include <fstream>
 #include <string>
 #include <vector>
-#include <regex>
+#include <string_view>
 #include <unordered_map>
 #include <stdexcept>
 
 #include "lexer/token.hpp"
+#include "lexer/source_buffer.hpp"
+#include "lexer/symbol_table.hpp"
 
 namespace grs_lexer {
     
@@ -33,25 +35,37 @@ namespace grs_lexer {
     class Lexer {
         public:
         Lexer();
-        std::vector<Token> tokenize(const std::string& code);
+        std::vector<Token> tokenize(const SourceBuffer& source);
+        // Same output as tokenize(), lexed on `threads` workers (0 = one per
+        // core). Inputs too small to be worth splitting are lexed serially.
+        std::vector<Token> tokenizeParallel(const SourceBuffer& source, unsigned threads = 0);
+        // DFA scanner, one physical line at a time (line has no '\n');
+        // appends the line's tokens and its ENDOFLINE to `tokens`
+        void scanLine(std::string_view line, int lineNumber, std::vector<Token>& tokens);
         void printTokens(const std::vector<Token>& tokens) const;
         
         bool hasErrors() const { return !errors_.empty(); }
         const std::vector<LexerError>& getErrors() const { return errors_; }
         void clearErrors() { errors_.clear(); }
-        struct TokenPattern {
-        std::regex pattern;
-        TokenType type;
-    };
+        const SymbolTable& getSymbols() const { return symbols_; }
 
 private:
     
-    std::vector<TokenPattern> patterns_;
-    std::unordered_map<std::string_view, TokenType> keywords_;
+    // Keywords are interned first, so their ids index keywordTypes_;
+    // every later id is a plain identifier
+    SymbolTable symbols_;
+    std::vector<TokenType> keywordTypes_;
     std::vector<LexerError> errors_; 
     
-    void initTokenPatterns();
     void initKeywords();
+    void addKeyword(std::string_view word, TokenType type);
+    // lexes every line of `text`, numbering from firstLine; returns the line count
+    int scanLines(std::string_view text, int firstLine, std::vector<Token>& tokens);
+
+    // below this many bytes per worker, thread start-up costs more than it saves
+    static constexpr size_t PARALLEL_MIN_CHUNK = 256 * 1024;
+
+    TokenType classifyWord(std::string_view word, SymbolId& symbol);
     
     
     void addError(const std::string& message, int line, int column) {
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+
+namespace grs_lexer::simd {
+
+    // Byte-scanning kernels used by the lexer. The widest implementation the
+    // CPU supports is picked once at start-up (AVX2, then SSE2, then scalar).
+    enum class Level {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    Level activeLevel();
+    const char* levelName(Level level);
+
+    // Force a narrower kernel set (benchmarks, debugging). Requests above
+    // what the CPU supports fall back to the best available level.
+    void setLevel(Level level);
+
+    // index of the first byte that is not one of " \t\n\v\f\r", or size
+    size_t skipBlanksKernel(const char* data, size_t size);
+
+    // index of the first '\n', or size
+    size_t findNewline(const char* data, size_t size);
+
+    // true if no byte has the high bit set
+    bool isAscii(const char* data, size_t size);
+
+    inline bool isBlank(char c) {
+        return c == ' ' || static_cast<unsigned char>(c - '\t') <= ('\r' - '\t');
+    }
+
+    // Most gaps between tokens are a single space, so look at the first
+    // byte inline before paying for the dispatched kernel
+    inline size_t skipBlanks(const char* data, size_t size) {
+        if (size == 0 || !isBlank(data[0])) return 0;
+        if (size == 1 || !isBlank(data[1])) return 1;
+        return 2 + skipBlanksKernel(data + 2, size - 2);
+    }
+
+} // namespace grs_lexer::simd
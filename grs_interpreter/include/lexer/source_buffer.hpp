@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace grs_lexer {
+
+    // Owns the program text. Tokens keep string_views into it, so the
+    // buffer has to outlive every token produced from it.
+    //
+    // fromFile() memory-maps the file where the platform allows it, so a
+    // large program is paged in by the OS instead of being copied to the heap.
+    class SourceBuffer {
+    public:
+        SourceBuffer() = default;
+        explicit SourceBuffer(std::string text, std::string name = "<memory>");
+        ~SourceBuffer();
+
+        // throws std::runtime_error if the file cannot be opened or mapped
+        static SourceBuffer fromFile(const std::string& path);
+
+        SourceBuffer(const SourceBuffer&) = delete;
+        SourceBuffer& operator=(const SourceBuffer&) = delete;
+        SourceBuffer(SourceBuffer&& other) noexcept;
+        SourceBuffer& operator=(SourceBuffer&& other) noexcept;
+
+        std::string_view view() const {
+            return mapped_ ? std::string_view(mappedData_, mappedSize_) : std::string_view(text_);
+        }
+        std::string_view slice(size_t offset, size_t length) const { return view().substr(offset, length); }
+        size_t size() const { return view().size(); }
+        bool empty() const { return size() == 0; }
+        bool isMapped() const { return mapped_; }
+        // true when the text is 7-bit clean, so byte offsets are also character offsets
+        bool isAscii() const;
+        const std::string& getName() const { return name_; }
+
+    private:
+        std::string text_;
+        std::string name_;
+        const char* mappedData_ = nullptr;
+        size_t mappedSize_ = 0;
+        bool mapped_ = false;
+
+        void unmap();
+    };
+
+} // namespace grs_lexer
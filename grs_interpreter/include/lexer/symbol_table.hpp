@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace grs_lexer {
+
+    using SymbolId = std::uint32_t;
+    inline constexpr SymbolId NO_SYMBOL = 0;
+
+    // Intern table for identifiers and keywords. Each distinct spelling gets a
+    // small dense id (starting at 1) so later stages can compare names by id.
+    class SymbolTable {
+    public:
+        SymbolId intern(std::string_view name);
+        SymbolId find(std::string_view name) const;
+        std::string_view name(SymbolId id) const;
+        size_t size() const { return names_.size(); }
+
+    private:
+        // deque keeps element addresses stable, so the map keys stay valid
+        std::deque<std::string> names_;
+        std::unordered_map<std::string_view, SymbolId> ids_;
+    };
+
+} // namespace grs_lexer
@@ -1,7 +1,10 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include "constexpr_map.hpp"
+#include "lexer/symbol_table.hpp"
 
 namespace grs_lexer {
     enum class TokenType {
@@ -188,20 +191,39 @@ namespace grs_lexer {
 
     });
 
+// value_ views the SourceBuffer the token was lexed from (or a literal).
+// The payload is decoded once by the lexer: the symbol id for words,
+// the value for INTEGER/FLOAT literals.
 class Token {
 public:
-    Token(TokenType type, const std::string& value, int line, int column);
+    Token(TokenType type, std::string_view value, int line, int column, SymbolId symbol = NO_SYMBOL);
+    Token(TokenType type, std::string_view value, int line, int column, std::int64_t integer);
+    Token(TokenType type, std::string_view value, int line, int column, double real);
     TokenType getType() const;
-    std::string getValue() const;
+    std::string_view getValue() const;
+    SymbolId getSymbol() const;
+    std::int64_t getInteger() const;
+    double getReal() const;
     int getLine() const;
     int getColumn() const;
+
+    // Copies with the position or symbol rewritten, payload kept
+    Token withLine(int line) const;
+    Token withSymbol(SymbolId symbol) const;
     
     std::string_view typeToString() const; 
     
     
 private:
+    bool isNumber() const;
+
+    std::string_view value_;
+    union {
+        SymbolId symbol;
+        std::int64_t integer;
+        double real;
+    } payload_;
     TokenType type_;
-    std::string value_;
     int line_;
     int column_;
     
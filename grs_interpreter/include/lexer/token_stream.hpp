@@ -0,0 +1,59 @@
+#pragma once
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "lexer/token.hpp"
+#include "lexer/source_buffer.hpp"
+
+namespace grs_lexer {
+
+    class Lexer;
+
+    // Pull-based token source for the parser.
+    //
+    // Streaming mode asks a LineSource for one line of tokens at a time as
+    // the parser needs them, keeping only a short window (current token plus
+    // a few already consumed ones) alive. The Lexer constructor streams
+    // straight from a SourceBuffer. Span mode walks borrowed tokens that were
+    // lexed up front with Lexer::tokenize, without copying them.
+    class TokenStream {
+    public:
+        // Appends the next line's tokens (the last call appends ENDOFFILE);
+        // returns false once there is nothing left
+        using LineSource = std::function<bool(std::vector<Token>& lineTokens)>;
+
+        TokenStream(Lexer& lexer, const SourceBuffer& source);
+        explicit TokenStream(LineSource source);
+        explicit TokenStream(const std::vector<Token>& tokens);
+        TokenStream(const Token* tokens, size_t count);
+
+        const Token& peek();
+        const Token& previous() const;
+        const Token& advance();
+        bool isAtEnd();
+
+        // number of tokens consumed so far
+        size_t position() const { return cursor_; }
+
+    private:
+        // consumed tokens kept alive so references from previous() survive
+        // a couple more advance() calls
+        static constexpr size_t HISTORY = 4;
+
+        LineSource source_;
+        bool finished_ = false;
+
+        const Token* tokens_ = nullptr;     // span mode
+        size_t count_ = 0;
+
+        std::deque<Token> window_;
+        std::vector<Token> lineTokens_;
+        size_t windowStart_ = 0;    // absolute index of window_.front()
+        size_t cursor_ = 0;         // absolute index of the current token
+
+        bool fill();
+        const Token* at(size_t index) const;
+    };
+
+} // namespace grs_lexer
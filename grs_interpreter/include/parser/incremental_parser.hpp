@@ -0,0 +1,98 @@
+#ifndef INCREMENTAL_PARSER_HPP_
+#define INCREMENTAL_PARSER_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../lexer/lexer.hpp"
+#include "parser.hpp"
+
+namespace grs_parser{
+
+// Lines [firstLine, lastLine] (1-based, inclusive) are replaced by `text`.
+// lastLine == firstLine - 1 inserts before firstLine. `text` is split into
+// lines like a source file: "" removes the range, "\n" is one empty line.
+struct SourceEdit{
+    int firstLine;
+    int lastLine;
+    std::string text;
+};
+
+// Keeps the tokens and AST of a program alive between edits.
+//
+// KRL lexing is line-local, so an edit only re-lexes the lines it touches.
+// The AST is kept as a list of top-level units (a DEF block, a DECL, an
+// empty line...), each covering whole source lines. An edit re-parses from
+// the unit enclosing the line above it until the parser lands on the start of
+// an old unit past the edit again; those new units are spliced into the
+// existing FunctionBlock. Each unit owns the arena its nodes live in, so a
+// replaced unit frees them at once.
+//
+// Node locations are ids that only have to grow down the file, not byte
+// offsets: lines are laid out with spare ids after them, so the units after
+// an edit normally keep their nodes as they are and an edit costs the same
+// anywhere in the program.
+class IncrementalParser{
+
+    public:
+    grs_ast::FunctionBlock* load(std::string_view code);
+    // throws std::out_of_range for a line range outside the program
+    grs_ast::FunctionBlock* applyEdit(const SourceEdit& edit);
+
+    grs_ast::FunctionBlock* getProgram()const{ return program_.get();}
+    std::vector<ParserError> getErrors()const;
+    bool hasErrors()const;
+    size_t getLineCount()const{ return lines_.size();}
+    // flattened token stream with current line numbers, ENDOFFILE included
+    std::vector<grs_lexer::Token> getTokens()const;
+    // decodes the locations of the program's nodes to current lines and
+    // columns; one file
+    const common::LocationTable& getLocations()const{ return locations_;}
+
+    private:
+    struct Line{
+        // heap-allocated so tokens' string_views survive moves of lines_
+        std::unique_ptr<const std::string> text;
+        // line numbers as of lexing time; restamped when fed to the parser
+        std::vector<grs_lexer::Token> tokens;
+        // location id of the line's first column
+        std::uint32_t id = 0;
+    };
+
+    struct Unit{
+        int firstLine;
+        int lineCount;
+        std::unique_ptr<grs_ast::Arena> arena;
+        std::vector<grs_ast::ASTNode*> nodes;
+        std::vector<ParserError> errors;
+    };
+
+    grs_lexer::Lexer lexer_;
+    Parser parser_;
+    std::vector<Line> lines_;
+    std::vector<Unit> units_;
+    std::unique_ptr<grs_ast::FunctionBlock> program_;
+    common::LocationTable locations_;
+    common::FileId file_ = 0;
+
+    std::vector<Line> lexLines(std::string_view text, int firstLine);
+    size_t unitContaining(int line)const;
+    // the id just past the line's newline
+    static std::uint32_t endOf(const Line& line){ return line.id + static_cast<std::uint32_t>(line.text->size()) + 1;}
+    // gives lines [first, last) consecutive ids from `id`, `slack` spare
+    // ids after each
+    void placeLines(size_t first, size_t last, std::uint32_t id, std::uint32_t slack);
+    std::vector<std::uint32_t> lineStarts()const;
+    // parses units starting at `line`; stops early once it reaches the start
+    // of units_[resyncUnit] or a later unit, moved down by `lineDelta` lines,
+    // and leaves resyncUnit at that unit
+    std::vector<Unit> parseUnits(int line, size_t& resyncUnit, int lineDelta);
+    // lays out all ids afresh and re-parses the program, once they run short
+    grs_ast::FunctionBlock* relayout();
+};
+
+}
+
+#endif //INCREMENTAL_PARSER_HPP_
@@ -1,7 +1,9 @@
 #ifndef PARSER_HPP_
 #define PARSER_HPP_
 
+#include <ostream>
 #include "../lexer/token.hpp"
+#include "../lexer/token_stream.hpp"
 #include "../ast/ast.hpp"
 
 namespace grs_parser{
@@ -10,71 +12,101 @@ struct ParserError{
     int line;
     int column;
 };
-class Parser{
+class Parser : public grs_ast::BodyParser{
 
     public:
     Parser();
     ~Parser();
-    std::shared_ptr<grs_ast::FunctionBlock> parse(const std::vector<grs_lexer::Token>& tokens);
+    // borrow the tokens; nothing is copied
+    grs_ast::Program parse(const std::vector<grs_lexer::Token>& tokens);
+    grs_ast::Program parse(const grs_lexer::Token* tokens, size_t count);
+    // pulls tokens on demand; only the stream's small window is kept in memory
+    grs_ast::Program parse(grs_lexer::TokenStream& tokens);
+    // one top-level declaration (nullptr for an empty statement), allocated
+    // in `arena`; always consumes at least one token unless the stream is
+    // at its end
+    grs_ast::ASTNode* parseDeclaration(grs_lexer::TokenStream& tokens, grs_ast::Arena& arena);
     bool hasErrors()const {return !errors_.empty();}
+    void clearErrors(){ errors_.clear(); }
     const std::vector<ParserError>& getErrors()const {return errors_;}
-    std::vector<std::pair<int,int>> getLineAndColumn()const{ return lineAndColumn_;}
+    // where node locations are encoded; without a table nodes get NO_LOCATION
+    void setLocations(const common::LocationTable* table, common::FileId file){ locations_ = table; file_ = file; }
+    // per-token trace of the parse; off (nullptr) by default
+    void setTrace(std::ostream* sink){ trace_ = sink; }
+    // DEF bodies after the first (the main program, always parsed with
+    // its declaration) are only pre-scanned by default and parsed on first
+    // use, which reports their errors here at that point; false parses them
+    // with the rest of the declaration too. A lazy program must not outlive
+    // this parser
+    void setLazyBodies(bool lazy){ lazyBodies_ = lazy; }
+    grs_ast::FunctionBlock* parseBody(grs_ast::FunctionDeclaration& function) override;
 
     private:
-    std::vector<grs_lexer::Token> tokens_;
-    size_t current_;
+    // non-owning: the caller's stream (and its SourceBuffer) must outlive parse()
+    grs_lexer::TokenStream* tokens_;
+    // where new nodes go; set for the duration of parseDeclaration()
+    grs_ast::Arena* arena_;
+    std::ostream* trace_;
+    bool lazyBodies_;
+    // a DEF has been parsed since parse() started
+    bool entrySeen_ = false;
     std::vector<ParserError> errors_;
-    std::vector<std::pair<int,int>> lineAndColumn_;    
+    const common::LocationTable* locations_;
+    common::FileId file_;
+    // location of the statement being parsed, set by markLocation()
+    common::LocationId location_;
     
     bool isAtEnd() const;
-    grs_lexer::Token peek() const;
-    grs_lexer::Token previous() const;
-    grs_lexer::Token advance();
+    const grs_lexer::Token& peek() const;
+    const grs_lexer::Token& previous() const;
+    const grs_lexer::Token& advance();
     bool check(grs_lexer::TokenType type) const;
     bool match(std::initializer_list<grs_lexer::TokenType> types);
     void addError(const std::string& message);
-    void eraseFirstPosition();
+    common::LocationId locationOf(const grs_lexer::Token& token)const;
+    void markLocation();
 
     //recursive descent ASTNodes
-    std::shared_ptr<grs_ast::ASTNode> declaration();
-    std::shared_ptr<grs_ast::ASTNode> functionDeclaration();
-    std::shared_ptr<grs_ast::ASTNode> variableDeclaration();
-    std::shared_ptr<grs_ast::ASTNode> block();
-    std::shared_ptr<grs_ast::ASTNode> statement();
-    std::shared_ptr<grs_ast::ASTNode> ifStatement();
-    std::shared_ptr<grs_ast::ASTNode> forStatement();
-    std::shared_ptr<grs_ast::ASTNode> repeatStatement();
-    std::shared_ptr<grs_ast::ASTNode> returnStatement();
-    std::shared_ptr<grs_ast::ASTNode> commandStatement();
-    std::shared_ptr<grs_ast::ASTNode> expressionStatement();
-    std::shared_ptr<grs_ast::ASTNode> motionCommand();
-    std::shared_ptr<grs_ast::ASTNode> waitStatement();
-    std::shared_ptr<grs_ast::ASTNode> positionDeclaration();
-    std::shared_ptr<grs_ast::ASTNode> frameDeclaration();
-    std::shared_ptr<grs_ast::ASTNode> axisDeclaration();
-    std::shared_ptr<grs_ast::ASTNode> parserExpression(const std::string& posName);
+    grs_ast::ASTNode* declaration();
+    grs_ast::ASTNode* functionDeclaration();
+    grs_ast::ASTNode* variableDeclaration();
+    grs_ast::ASTNode* block();
+    grs_ast::ASTNode* statement();
+    grs_ast::ASTNode* ifStatement();
+    grs_ast::ASTNode* forStatement();
+    grs_ast::ASTNode* whileStatement();
+    grs_ast::ASTNode* repeatStatement();
+    grs_ast::ASTNode* switchStatement();
+    grs_ast::ASTNode* returnStatement();
+    grs_ast::ASTNode* commandStatement();
+    grs_ast::ASTNode* expressionStatement();
+    grs_ast::ASTNode* motionCommand();
+    grs_ast::ASTNode* waitStatement();
+    grs_ast::ASTNode* positionDeclaration();
+    grs_ast::ASTNode* frameDeclaration();
+    grs_ast::ASTNode* axisDeclaration();
+    grs_ast::ASTNode* parserExpression(const std::string& posName);
+    // false (after reporting) unless an integer constant, `after` some keyword, follows
+    bool integerConstant(const std::string& after, std::int32_t& value);
     //recursive descent Expression
-    std::shared_ptr<grs_ast::Expression> expression();
-    std::shared_ptr<grs_ast::Expression> assignment();
-    std::shared_ptr<grs_ast::Expression> logicalOr();
-    std::shared_ptr<grs_ast::Expression> logicalAnd();
-    std::shared_ptr<grs_ast::Expression> equality();
-    std::shared_ptr<grs_ast::Expression> comparison();
-    std::shared_ptr<grs_ast::Expression> term();
-    std::shared_ptr<grs_ast::Expression> factor();
-    std::shared_ptr<grs_ast::Expression> unary();
-    std::shared_ptr<grs_ast::Expression> primary();
+    grs_ast::Expression* expression();
+    grs_ast::Expression* assignment();
+    // binary operators binding at least as tightly as minPrecedence
+    grs_ast::Expression* binary(int minPrecedence);
+    grs_ast::Expression* unary();
+    grs_ast::Expression* primary();
+    grs_ast::Expression* call(const std::string& name);
 
     template<class DeclarationType>
-    std::shared_ptr<grs_ast::ASTNode> parserDeclaration(const std::string& typeName){
+    grs_ast::ASTNode* parserDeclaration(const std::string& typeName){
                 
-        eraseFirstPosition();
+        markLocation();
         
         if(!check(grs_lexer::TokenType::IDENTIFIER)){
         addError("Expected " + typeName + " name");
         return nullptr;
     }
-        std::string structName = advance().getValue();
+        std::string structName(advance().getValue());
 
         if(!match({grs_lexer::TokenType::ASSIGN})){
         addError("Expected '=' after " + typeName + " name");
@@ -86,7 +118,7 @@ class Parser{
         return nullptr;
     }
     
-    std::vector<std::pair<std::string,std::shared_ptr<grs_ast::Expression>>> arguments;
+    std::vector<std::pair<std::string,grs_ast::Expression*>> arguments;
     
     while (!check(grs_lexer::TokenType::RBRACE) && !isAtEnd()){
         if(!check(grs_lexer::TokenType::IDENTIFIER)){
@@ -99,7 +131,7 @@ class Parser{
             }
         }
         
-        std::string argName = advance().getValue();
+        std::string argName(advance().getValue());
         auto argValue = expression();
         arguments.emplace_back(argName, argValue);
     
@@ -114,7 +146,7 @@ class Parser{
         return nullptr;
     }
 
-    return std::make_shared<DeclarationType>(structName, arguments, lineAndColumn_ );
+    return arena_->make<DeclarationType>(structName, arguments, location_);
 
     }
 
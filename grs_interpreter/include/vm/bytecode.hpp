@@ -0,0 +1,148 @@
+#ifndef BYTECODE_HPP_
+#define BYTECODE_HPP_
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "../common/value.hpp"
+#include "../common/source_location.hpp"
+#include "../lexer/token.hpp"
+
+namespace grs_vm{
+
+// Register machine operations. R[x] is a register of the running chunk,
+// K[x] a constant and S[x] a variable slot. Every variable name gets its
+// slot when the program is compiled, so at run time variables are reached
+// by index only. Jump offsets (c) are relative to the instruction after
+// the jump.
+//
+// Listed once as an X-macro, so the enum, the names and the VM's dispatch
+// table cannot disagree on the order.
+#define GRS_VM_OPCODES(X) \
+    X(LOADK)        /* R[a] = K[b] */ \
+    X(MOVE)         /* R[a] = R[b] */ \
+    X(GETVAR)       /* R[a] = S[b] */ \
+    X(SETVAR)       /* S[b] = R[a], converted to the variable's type */ \
+    X(DECL)         /* declare S[b] with type c and its default value */ \
+    X(DECL_INIT)    /* declare S[b] with type c, initialised from R[a] */ \
+    X(DECL_STRUCT)  /* declare POS / FRAME / AXIS S[b] (type c), all fields 0 */ \
+    X(SETFIELD)     /* field c (see fieldIndex) of struct S[b] = R[a] */ \
+    X(ADD) X(SUB) X(MUL) X(DIV) \
+    X(LT) X(LE) X(GT) X(GE) X(EQ) X(NE) \
+    X(AND) X(OR)    /* R[a] = R[b] op R[c]; comparisons and logic give 1.0 / 0.0 */ \
+    X(NOT)          /* R[a] = !R[b], as 1.0 / 0.0 */ \
+    X(NEG)          /* R[a] = -R[b] */ \
+    /* Typed forms, used where the TypeChecker proved the operands numbers. \
+       A number is always a double in a register, so these skip the kind \
+       checks and conversions of the forms above. */ \
+    X(GETVAR_INT) X(GETVAR_REAL) X(GETVAR_BOOL)   /* R[a] = S[b], a variable of that type */ \
+    X(SETVAR_INT) X(SETVAR_REAL) X(SETVAR_BOOL)   /* S[b] = R[a] */ \
+    X(ADD_F) X(SUB_F) X(MUL_F) X(DIV_F) \
+    X(LT_F) X(LE_F) X(GT_F) X(GE_F) X(EQ_F) X(NE_F) \
+    X(AND_F) X(OR_F)    /* R[a] = R[b] op R[c] */ \
+    X(NOT_F) X(NEG_F)   /* R[a] = op R[b] */ \
+    X(JMPZ)         /* if R[a] == 0.0: pc += c */ \
+    X(JMP)          /* pc += c */ \
+    X(JMPF)         /* if R[a] is false: pc += c */ \
+    /* Counted FOR, see common::CountedLoop. The loop keeps its counter, \
+       last value and step as INTs in R[a], R[a+1] and R[a+2]; the body \
+       leaves them alone. */ \
+    X(FORPREP)      /* R[a] start, R[a+1] end, R[a+2] step become INTs; \
+                       S[b] = R[a]; pc += c unless R[a] is in range */ \
+    X(FORLOOP)      /* R[a] += R[a+2]; S[b] = R[a]; pc += c while R[a] is \
+                       in range */ \
+    /* SWITCH on R[a], read as a number (anything else counts as 0), \
+       through chunk.switches[b]; see common::caseValue */ \
+    X(JMPTABLE)     /* pc = targets[R[a] - low], or the default target */ \
+    X(JMPSEARCH)    /* pc = the target of R[a] among the sorted keys, or \
+                       the default target */ \
+    /* Calls of chunk.functions[c], linked to its first instruction b. The \
+       callee's registers start at the caller's R[a], above every register \
+       the caller still uses. */ \
+    X(CALL)         /* declare the callee's parameters from R[a], R[a+1], \
+                       ...; run it from b; its result lands in R[a] */ \
+    X(RET)          /* back to the caller, returning R[a] (b = 1) or \
+                       nothing (b = 0) */ \
+    X(MOTION)       /* hand motion c (a TokenType) to S[b] to the executor */ \
+    X(WAIT)         /* hand WAIT of K[b] seconds to the executor */ \
+    X(HALT)
+
+enum class OpCode : std::uint8_t{
+#define GRS_VM_ENUM(name) name,
+    GRS_VM_OPCODES(GRS_VM_ENUM)
+#undef GRS_VM_ENUM
+};
+
+#define GRS_VM_COUNT(name) + 1
+constexpr size_t OPCODE_COUNT = 0 GRS_VM_OPCODES(GRS_VM_COUNT);
+#undef GRS_VM_COUNT
+
+const char* opCodeName(OpCode op);
+
+// Struct members as SETFIELD operands: 0-5 are x, y, z, a, b, c of a POS or
+// FRAME, 6-11 are A1-A6 of an AXIS. Names are matched case-insensitively;
+// an unknown name gives -1.
+std::int32_t fieldIndex(const std::string& member);
+const char* fieldName(std::int32_t field);
+
+// 12 bytes; a addresses one of at most 256 registers
+struct Instr{
+    OpCode op;
+    std::uint8_t a;
+    std::uint32_t b;
+    std::int32_t c;
+};
+
+// Where a SWITCH goes for each CASE value. Targets are instruction
+// indices. JMPTABLE indexes targets directly, with every value from
+// low on (gaps go to the default); JMPSEARCH binary-searches keys,
+// one per target.
+struct SwitchTable{
+    std::int32_t low = 0;
+    std::vector<std::int32_t> keys;
+    std::vector<std::uint32_t> targets;
+    std::uint32_t defaultTarget = 0;
+};
+
+// CALL target of a function no DEF defines
+constexpr std::uint32_t UNRESOLVED = UINT32_MAX;
+
+// A DEF compiled as a subroutine. Its locals, parameters first, own the
+// slots [firstLocal, firstLocal + localCount); a call starts with them
+// undefined and the parameters declared.
+struct Function{
+    std::string name;
+    // first instruction, or UNRESOLVED
+    std::uint32_t entry = UNRESOLVED;
+    std::uint32_t firstLocal = 0;
+    std::uint32_t localCount = 0;
+    std::vector<grs_lexer::TokenType> parameters;
+    grs_lexer::TokenType returnType = grs_lexer::TokenType::ENDOFFILE;
+};
+
+// Compiled program: straight bytecode plus the pools it indexes
+struct Chunk{
+    std::vector<Instr> code;
+    // one per instruction, for errors and for the commands handed out
+    std::vector<common::LocationId> locations;
+    std::vector<common::Value> constants;
+    // strings the constants refer to
+    common::ValuePool pool;
+    // name of the variable in each slot; read only for messages and by the host
+    std::vector<std::string> slotNames;
+    // type each slot is fixed to because typed opcodes access it;
+    // ENDOFFILE for slots only the generic opcodes touch
+    std::vector<grs_lexer::TokenType> slotTypes;
+    std::vector<SwitchTable> switches;
+    std::vector<Function> functions;
+    // registers one function (or the main program) needs
+    std::uint32_t registerCount = 0;
+};
+
+// one line per instruction: index, opcode and operands
+void disassemble(const Chunk& chunk, std::ostream& out);
+
+}
+
+#endif //BYTECODE_HPP_
@@ -0,0 +1,127 @@
+#ifndef COMPILER_HPP_
+#define COMPILER_HPP_
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "../ast/ast.hpp"
+#include "../ast/visitor.hpp"
+#include "bytecode.hpp"
+
+namespace grs_vm{
+
+// Lowers a parsed program to register bytecode. Unlike the instruction
+// generator, which evaluates while it walks, nothing runs here: IF becomes
+// a conditional jump, so a branch is taken or skipped each time the VM
+// passes it, and every variable is resolved to a slot. Every expression gets a window of registers above the ones
+// still live in its statement; all of them are free again between
+// statements.
+//
+// Expressions annotated by the TypeChecker get the typed opcodes where
+// their operands are numbers; unchecked ones compile to the generic forms.
+//
+// A SWITCH jumps to its CASE through a table indexed by the selector when
+// the CASE values are dense, or after a binary search of them otherwise;
+// the values are never tested one by one.
+//
+// Loops jump back instead of being unrolled; a FOR runs on FORPREP /
+// FORLOOP. A loop that hands no command to the executor (so nothing but
+// the loop itself can change its variables) computes its typed,
+// loop-invariant expressions once, before it starts, and keeps them in
+// registers for its whole body.
+//
+// The DEFs the program calls are compiled after its HALT, each with its
+// locals in slots of its own, and every CALL is linked to its DEF's first
+// instruction once all of them are in place. A call's arguments go to the
+// registers from the one its value lands in, which is where the callee's
+// register window starts.
+class Compiler : public grs_ast::ASTVisitorBase{
+
+    public:
+    // throws std::runtime_error when an expression needs more than 256 registers
+    Chunk compile(grs_ast::FunctionBlock* program);
+
+    void visit(grs_ast::FunctionBlock& node) override;
+    void visit(grs_ast::MotionCommand& node) override;
+    void visit(grs_ast::BinaryExpression& node) override;
+    void visit(grs_ast::UnaryExpression& node) override;
+    void visit(grs_ast::LiteraExpression& node) override;
+    void visit(grs_ast::VariableExpression& node) override;
+    void visit(grs_ast::VariableDeclaration& node) override;
+    void visit(grs_ast::FrameDeclaration& node) override;
+    void visit(grs_ast::PositionDeclaration& node) override;
+    void visit(grs_ast::AxisDeclaration& node) override;
+    void visit(grs_ast::ExecutePosAndAxisExpression& node) override;
+    void visit(grs_ast::IfStatement& node) override;
+    void visit(grs_ast::ForStatement& node) override;
+    void visit(grs_ast::WhileStatement& node) override;
+    void visit(grs_ast::RepeatStatement& node) override;
+    void visit(grs_ast::SwitchStatement& node) override;
+    void visit(grs_ast::WaitStatement& node) override;
+    void visit(grs_ast::FunctionDeclaration& node) override;
+    void visit(grs_ast::CallExpression& node) override;
+    void visit(grs_ast::ReturnStatement& node) override;
+
+    private:
+    Chunk chunk_;
+    // variable name -> slot
+    std::unordered_map<std::string, std::uint32_t> slots_;
+    // ... for the locals of the DEF being compiled, which hide the above
+    std::unordered_map<std::string, std::uint32_t> locals_;
+    bool inFunction_ = false;
+    grs_ast::FunctionTable declarations_;
+    // DEF name -> index into chunk_.functions
+    std::unordered_map<std::string, std::uint32_t> functionIndex_;
+    std::vector<grs_ast::FunctionDeclaration*> callees_;
+    // the CALLs to link
+    std::vector<size_t> calls_;
+    // register the expression being visited writes its value to
+    std::uint8_t target_ = 0;
+    // expressions carry no position; they report the statement's
+    common::LocationId location_ = common::NO_LOCATION;
+    std::uint32_t nextRegister_ = 0;
+    // registers the enclosing loops hold across their body: a FOR's
+    // counter, end and step, and the values hoisted out of them
+    std::uint32_t liveRegisters_ = 0;
+    bool entryCompiled_ = false;
+    // > 0 inside IF branches and loop bodies
+    std::uint32_t conditional_ = 0;
+    // slots a DECL outside any branch or loop has declared by this point
+    std::unordered_set<std::uint32_t> declared_;
+    // loop-invariant expressions and the register holding their value
+    std::unordered_map<const grs_ast::Expression*, std::uint8_t> hoisted_;
+    struct LoopScan;
+
+    size_t emit(OpCode op, std::uint8_t a, std::uint32_t b, std::int32_t c);
+    // points the jump at `at` to the next instruction emitted
+    void patchJump(size_t at);
+    // ... or to the instruction at `target`
+    void patchJump(size_t at, size_t target);
+    std::uint32_t slot(const std::string& variable);
+    // the slot `variable` has so far, or nullptr
+    const std::uint32_t* knownSlot(const std::string& variable)const;
+    // index of the DEF `name` in chunk_.functions; a DEF the program does
+    // not have keeps an unresolved entry
+    std::uint32_t function(const std::string& name);
+    void compileFunction(std::uint32_t index);
+    OpCode variableAccess(const grs_ast::Expression& variable, std::uint32_t slot, OpCode generic);
+    std::uint32_t constant(const common::ValueType& value);
+    std::uint8_t allocate();
+    void expression(grs_ast::Expression* expr, std::uint8_t target);
+    template<typename NodeType>
+    void structDeclaration(NodeType& node, grs_lexer::TokenType type);
+    // computes the invariant expressions of a loop (its `body`, a WHILE or
+    // UNTIL `condition`, a FOR `counter`) into registers, above the live
+    // ones; returns them, to be forgotten after the loop
+    std::vector<const grs_ast::Expression*> hoist(grs_ast::ASTNode* body, grs_ast::Expression* condition,
+                                                  const std::string* counter);
+    // true when `expr` has the same value, and no side effect, on every
+    // turn of the scanned loop; the largest such parts of an expression
+    // that is not go to `found`
+    bool invariant(grs_ast::Expression* expr, const LoopScan& scan, std::vector<grs_ast::Expression*>& found);
+    void endLoop(const std::vector<const grs_ast::Expression*>& hoisted, std::uint32_t live);
+};
+
+}
+
+#endif //COMPILER_HPP_
@@ -0,0 +1,97 @@
+#ifndef TYPE_CHECKER_HPP_
+#define TYPE_CHECKER_HPP_
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "../ast/ast.hpp"
+#include "../ast/visitor.hpp"
+#include "../common/source_location.hpp"
+
+namespace grs_vm{
+
+struct TypeError{
+    std::string message;
+    common::LocationId location;
+};
+
+// Gives every expression of the part of the program that runs (top-level
+// statements and the first DEF) its static KRL type, and reports what can
+// only go wrong at run time:
+//  - an operator, IF or loop condition, FOR bound, SWITCH selector, struct
+//    field or numeric variable getting a CHAR or a POS / FRAME / AXIS;
+//  - a FOR counter that is not an INT;
+//  - a whole struct being assigned, or a member that its type lacks;
+//  - a motion to a variable that is not a POS, FRAME or AXIS.
+//  - a call to a DEF the module does not have, with the wrong number of
+//    arguments, or with an argument or RETURN value that is not a number.
+// A variable's type is the one of its DECLs; one declared with different
+// types, or never, stays unknown (ENDOFFILE) and is left to run time.
+// Operators yield REAL (arithmetic) or BOOL (comparisons and logic); a
+// call yields its DEF's return type, or REAL when it has none.
+//
+// Every DEF that is called is checked once, after the main program: its
+// parameters and DECLs hide the main program's variables of the same name,
+// and it may use no other variables than those two kinds.
+class TypeChecker : public grs_ast::ASTVisitorBase{
+
+    public:
+    // true when the program has no type errors
+    bool check(grs_ast::FunctionBlock* program);
+    const std::vector<TypeError>& getErrors()const{ return errors_;}
+
+    void visit(grs_ast::FunctionBlock& node) override;
+    void visit(grs_ast::FunctionDeclaration& node) override;
+    void visit(grs_ast::MotionCommand& node) override;
+    void visit(grs_ast::BinaryExpression& node) override;
+    void visit(grs_ast::UnaryExpression& node) override;
+    void visit(grs_ast::LiteraExpression& node) override;
+    void visit(grs_ast::VariableExpression& node) override;
+    void visit(grs_ast::VariableDeclaration& node) override;
+    void visit(grs_ast::FrameDeclaration& node) override;
+    void visit(grs_ast::PositionDeclaration& node) override;
+    void visit(grs_ast::AxisDeclaration& node) override;
+    void visit(grs_ast::ExecutePosAndAxisExpression& node) override;
+    void visit(grs_ast::IfStatement& node) override;
+    void visit(grs_ast::ForStatement& node) override;
+    void visit(grs_ast::WhileStatement& node) override;
+    void visit(grs_ast::RepeatStatement& node) override;
+    void visit(grs_ast::SwitchStatement& node) override;
+    void visit(grs_ast::CallExpression& node) override;
+    void visit(grs_ast::ReturnStatement& node) override;
+
+    private:
+    std::vector<TypeError> errors_;
+    // declared type per variable; ENDOFFILE once two DECLs disagree
+    std::unordered_map<std::string, grs_lexer::TokenType> variables_;
+    // ... of the main program's variables
+    std::unordered_map<std::string, grs_lexer::TokenType> globals_;
+    bool entrySeen_ = false;
+    grs_ast::FunctionTable functions_;
+    // called DEFs, in the order they are checked
+    std::vector<grs_ast::FunctionDeclaration*> callees_;
+    std::unordered_set<const grs_ast::FunctionDeclaration*> called_;
+    // the DEF being checked, or nullptr in the main program
+    grs_ast::FunctionDeclaration* function_ = nullptr;
+    // expressions carry no position; errors report the statement's
+    common::LocationId location_ = common::NO_LOCATION;
+
+    // in a DEF, reports a name that is neither its local nor the main
+    // program's
+    grs_lexer::TokenType variableType(const std::string& name);
+    // visits `expr` and returns its type (ENDOFFILE for none)
+    grs_lexer::TokenType typeOf(grs_ast::Expression* expr);
+    // reports what `what()` describes unless `type` is a number or unknown;
+    // the message is only built for an error
+    template<typename Describe>
+    void expectNumber(grs_lexer::TokenType type, Describe&& what);
+    void error(const std::string& message);
+    template<typename NodeType>
+    void structDeclaration(NodeType& node, grs_lexer::TokenType type);
+    void checkFunction(grs_ast::FunctionDeclaration& function);
+};
+
+}
+
+#endif //TYPE_CHECKER_HPP_
@@ -0,0 +1,124 @@
+#ifndef VM_HPP_
+#define VM_HPP_
+
+#include "../common/call_stack.hpp"
+#include "../interpreter/instruction.hpp"
+#include "bytecode.hpp"
+
+namespace grs_vm{
+
+// Runs a compiled Chunk. The VM owns the program's variables and decides
+// branches as it reaches them; the robot commands themselves (motions and
+// WAIT) are handed out one at a time, in the Instruction form the executor
+// already understands, so the executor drives the program and any state it
+// changes between two commands is seen by the code that follows.
+//
+// Values convert as in the instruction generator, except that a boolean
+// stays true when read or assigned. Registers and variables hold 16-byte
+// common::Values; strings and structs stay in the VM's pool, so evaluating
+// never allocates or copies a struct. Only the commands handed out and the
+// host accessors convert to common::ValueType.
+//
+// Calls run on stacks allocated with the VM, sized for maxCallDepth nested
+// calls, so a call allocates nothing: a frame records where to return,
+// and the callee's registers are a window of registers_ above the
+// caller's. A function's locals keep their own slots; only a recursive
+// call, which needs them while an outer call of the same function still
+// does, first copies them to the saved-locals stack and copies them back
+// when it returns.
+class Vm{
+
+    public:
+    // the chunk must outlive the VM
+    explicit Vm(const Chunk& chunk, std::uint32_t maxCallDepth = common::DEFAULT_CALL_DEPTH);
+
+    // runs up to the next robot command and returns it, valid until the
+    // next call; nullptr once the program has ended. Its name and value are
+    // looked up in getCommands()
+    const grs_interpreter::Instruction* next();
+    const grs_interpreter::InstructionList& getCommands()const{ return commands_;}
+    bool isFinished()const{ return finished_;}
+    // back to the first instruction, with no variables
+    void reset();
+
+    // Host access by name, e.g. for inputs changed between two commands.
+    // Names are searched linearly; the program itself only uses slots. The
+    // locals of functions cannot be reached this way
+    bool hasVariable(const std::string& name)const;
+    // 0.0 for an undefined variable
+    common::ValueType getVariable(const std::string& name)const;
+    // false when the program never mentions `name`, or when it uses `name`
+    // as a number and `value` is not one (a number is converted to the
+    // variable's type)
+    bool setVariable(const std::string& name, grs_lexer::TokenType type, const common::ValueType& value);
+    // bytecode instructions executed since the last reset
+    std::uint64_t getExecutedCount()const{ return executed_;}
+    // how this build dispatches: "threaded" (computed goto) or "switch"
+    static const char* getDispatch();
+
+    private:
+    const Chunk& chunk_;
+    size_t pc_ = 0;
+    bool finished_ = false;
+    std::uint64_t executed_ = 0;
+    std::vector<common::Value> registers_;
+    struct Slot{
+        grs_lexer::TokenType type;
+        bool declared;
+        // an undeclared slot keeps its last value, so a struct declared
+        // again after reset() reuses its place in the pool
+        common::Value value;
+    };
+    std::vector<Slot> slots_;
+    // the chunk's strings, plus the program's structs and CHAR values
+    common::ValuePool pool_;
+    // the chunk's names plus one constant, rewritten for each command
+    grs_interpreter::InstructionList commands_;
+
+    std::uint32_t maxCallDepth_;
+    // R[0] of the running function, as an index into registers_
+    std::uint32_t registerBase_ = 0;
+    // where the saved locals of a call start when it has none
+    static constexpr std::uint32_t NOT_SAVED = UINT32_MAX;
+    struct Frame{
+        std::uint32_t returnPc;
+        std::uint32_t function;
+        std::uint32_t registerBase;
+        // the outer call's locals in saved_, or NOT_SAVED
+        std::uint32_t saved;
+    };
+    // calls in progress, innermost last; reserved for maxCallDepth_
+    std::vector<Frame> frames_;
+    // a struct's fields are saved with its slot: the recursive call
+    // declares the struct again in the same pooled place
+    struct SavedSlot{
+        Slot slot;
+        double fields[6];
+    };
+    // maxCallDepth_ times the most locals a function has; savedTop_ is
+    // the first free entry
+    std::vector<SavedSlot> saved_;
+    std::uint32_t savedTop_ = 0;
+    // calls in progress per function
+    std::vector<std::uint32_t> active_;
+
+    std::uint32_t findSlot(const std::string& name)const;
+    // false (after reporting) when the call cannot be made: its function
+    // has no DEF, or calls already nest maxCallDepth_ deep
+    bool call(const Instr& instr);
+    void ret(const Instr& instr);
+    // copies the fields of the struct `value` refers to into `fields`, or
+    // (save false) back; other values have none
+    void copyStruct(common::Value value, double (&fields)[6], bool save);
+    void declare(std::uint32_t slot, grs_lexer::TokenType type, const common::Value* init);
+    void declareStruct(std::uint32_t slot, grs_lexer::TokenType type);
+    void assign(std::uint32_t slot, common::Value value);
+    void setField(std::uint32_t slot, std::int32_t field, common::Value value);
+    common::Value load(std::uint32_t slot)const;
+    // a value of `type` made from `number`, as a declaration or assignment stores it
+    common::Value convert(grs_lexer::TokenType type, double number);
+};
+
+}
+
+#endif //VM_HPP_
@@ -0,0 +1,61 @@
+#include "ast/arena.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+namespace grs_ast {
+
+    namespace {
+    constexpr size_t MAX_CHUNK_SIZE = 1024 * 1024;
+
+    char* alignUp(char* p, size_t alignment){
+        auto address = reinterpret_cast<std::uintptr_t>(p);
+        return p + ((alignment - address % alignment) % alignment);
+    }
+    }
+
+    Arena::Arena(size_t firstChunkSize) : nextChunkSize_{firstChunkSize} {}
+
+    Arena::~Arena(){
+        // newest first, the reverse of construction
+        for(Finalizer* f = finalizers_; f; f = f->next){
+            f->destroy(f->object);
+        }
+        while(chunks_){
+            Chunk* next = chunks_->next;
+            std::free(chunks_);
+            chunks_ = next;
+        }
+    }
+
+    void* Arena::allocate(size_t size, size_t alignment){
+        char* start = cursor_ ? alignUp(cursor_, alignment) : nullptr;
+        if(!start || start + size > limit_){
+            grow(size + alignment);
+            start = alignUp(cursor_, alignment);
+        }
+        cursor_ = start + size;
+        bytesUsed_ += size;
+        return start;
+    }
+
+    void Arena::addFinalizer(void* object, void (*destroy)(void*)){
+        auto* finalizer = static_cast<Finalizer*>(allocate(sizeof(Finalizer), alignof(Finalizer)));
+        *finalizer = {finalizers_, object, destroy};
+        finalizers_ = finalizer;
+    }
+
+    void Arena::grow(size_t minimum){
+        size_t size = std::max(nextChunkSize_, minimum + sizeof(Chunk));
+        auto* chunk = static_cast<Chunk*>(std::malloc(size));
+        if(!chunk){
+            throw std::bad_alloc();
+        }
+        *chunk = {chunks_, size};
+        chunks_ = chunk;
+        cursor_ = reinterpret_cast<char*>(chunk + 1);
+        limit_ = reinterpret_cast<char*>(chunk) + size;
+        nextChunkSize_ = std::min(nextChunkSize_ * 2, std::max(MAX_CHUNK_SIZE, nextChunkSize_));
+    }
+
+}
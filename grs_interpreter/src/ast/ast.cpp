@@ -1,78 +1,241 @@
 #include "ast/ast.hpp"
 #include "ast/visitor.hpp"
+#include <algorithm>
+#include <unordered_set>
+#include "common/case_value.hpp"
 namespace grs_ast {
 
-    ASTNode::ASTNode(std::vector<std::pair<int, int>> lineAndColumn)
-    : lineAndColumn_{std::move(lineAndColumn)} {}
+    ASTNode::ASTNode(common::LocationId location)
+    : location_{location} {}
+
+    void ASTNode::shiftLocation(std::int64_t delta){
+        if(location_ != common::NO_LOCATION){
+            location_ = static_cast<common::LocationId>(location_ + delta);
+        }
+    }
 
     //FunctionBlock
-    FunctionBlock::FunctionBlock(std::vector<std::shared_ptr<ASTNode>> statements)
+    FunctionBlock::FunctionBlock(std::vector<ASTNode*> statements)
     : statements_{std::move(statements)} {}
 
     void FunctionBlock::accept(ASTVisitor& visitor){
         visitor.visit(*this);
     }
 
+    void FunctionBlock::replaceStatements(size_t first, size_t count, std::vector<ASTNode*> replacement){
+        auto begin = statements_.begin() + first;
+        auto overlap = std::min(count, replacement.size());
+        std::move(replacement.begin(), replacement.begin() + overlap, begin);
+        if(count > overlap){
+            statements_.erase(begin + overlap, begin + count);
+        } else {
+            statements_.insert(begin + overlap, std::make_move_iterator(replacement.begin() + overlap),
+                               std::make_move_iterator(replacement.end()));
+        }
+    }
 
-    FrameDeclaration::FrameDeclaration(const std::string& name, const std::vector<std::pair<std::string,std::shared_ptr<Expression>>>& args, std::vector<std::pair<int,int>>& lineAndColumn)
-    : name_(name), args_(args), ASTNode(std::move(lineAndColumn)) {}
+
+    FrameDeclaration::FrameDeclaration(const std::string& name, const std::vector<std::pair<std::string,Expression*>>& args, common::LocationId location)
+    : name_(name), args_(args), ASTNode(location) {}
     void FrameDeclaration::accept(ASTVisitor& visitor){
     visitor.visit(*this);    
     }
 
-    PositionDeclaration::PositionDeclaration(const std::string& name, const std::vector<std::pair<std::string,std::shared_ptr<Expression>>>& args, std::vector<std::pair<int,int>>& lineAndColumn)
-    : name_{name}, args_{args}, ASTNode(std::move(lineAndColumn)){}
+    PositionDeclaration::PositionDeclaration(const std::string& name, const std::vector<std::pair<std::string,Expression*>>& args, common::LocationId location)
+    : name_{name}, args_{args}, ASTNode(location){}
     void PositionDeclaration::accept(ASTVisitor& visitor){
         visitor.visit(*this);
     }
 
-    AxisDeclaration::AxisDeclaration(const std::string& name, const std::vector<std::pair<std::string, std::shared_ptr<Expression>>>& args, std::vector<std::pair<int,int>>& lineAndColumn) 
-    : name_{name}, args_{args}, ASTNode(std::move(lineAndColumn)) {}   
+    AxisDeclaration::AxisDeclaration(const std::string& name, const std::vector<std::pair<std::string, Expression*>>& args, common::LocationId location) 
+    : name_{name}, args_{args}, ASTNode(location) {}   
     void AxisDeclaration::accept(ASTVisitor& visitor){
         visitor.visit(*this);
     }
 
-    ExecutePosAndAxisExpression::ExecutePosAndAxisExpression(const std::string& posName, const std::string& argName, const std::shared_ptr<Expression>& expr) 
-    : posName_{posName}, argName_{argName}, expr_{expr} {}
+    ExecutePosAndAxisExpression::ExecutePosAndAxisExpression(const std::string& posName, const std::string& argName, Expression* expr, common::LocationId location) 
+    : ASTNode(location), posName_{posName}, argName_{argName}, expr_{expr} {}
     void ExecutePosAndAxisExpression::accept(ASTVisitor& visitor){
         visitor.visit(*this);
     }
 
     //Command
-    MotionCommand::MotionCommand(const std::string& command, const std::string& name, std::vector<std::pair<std::string,std::shared_ptr<Expression>>> args, std::vector<std::pair<int,int>> lineAndColumn) 
-    : command_{command},args_{std::move(args)}, ASTNode(std::move(lineAndColumn)), name_{name} {}
+    MotionCommand::MotionCommand(const std::string& command, const std::string& name, std::vector<std::pair<std::string,Expression*>> args, common::LocationId location) 
+    : command_{command},args_{std::move(args)}, ASTNode(location), name_{name} {}
 
     void MotionCommand::accept(ASTVisitor& visitor){
         visitor.visit(*this);
     }
 
 
-    IfStatement::IfStatement(std::shared_ptr<Expression> condition, std::shared_ptr<ASTNode> thenBranch, std::shared_ptr<ASTNode> elseBranch,std::vector<std::pair<int,int>> lineAndColumn) 
-    : condition_{std::move(condition)}, elseBranch_{std::move(elseBranch)}, thenBranch_{std::move(thenBranch)}, ASTNode(std::move(lineAndColumn)) {}
+    IfStatement::IfStatement(Expression* condition, ASTNode* thenBranch, ASTNode* elseBranch,common::LocationId location) 
+    : condition_{std::move(condition)}, elseBranch_{std::move(elseBranch)}, thenBranch_{std::move(thenBranch)}, ASTNode(location) {}
     void IfStatement::accept(ASTVisitor& visitor){
         visitor.visit(*this);
     }
 
-    WaitStatement::WaitStatement(double& waitTime, std::vector<std::pair<int,int>> lineAndColumn) : waitTime_{waitTime}, ASTNode(std::move(lineAndColumn)) {}
+    ForStatement::ForStatement(const std::string& counter, Expression* start, Expression* end, std::int32_t step,
+                               ASTNode* body, common::LocationId location)
+    : ASTNode(location), counter_{counter}, start_{start}, end_{end}, step_{step}, body_{body} {}
+    void ForStatement::accept(ASTVisitor& visitor){
+        visitor.visit(*this);
+    }
+
+    WhileStatement::WhileStatement(Expression* condition, ASTNode* body, common::LocationId location)
+    : ASTNode(location), condition_{condition}, body_{body} {}
+    void WhileStatement::accept(ASTVisitor& visitor){
+        visitor.visit(*this);
+    }
+
+    RepeatStatement::RepeatStatement(ASTNode* body, Expression* condition, common::LocationId location)
+    : ASTNode(location), body_{body}, condition_{condition} {}
+    void RepeatStatement::accept(ASTVisitor& visitor){
+        visitor.visit(*this);
+    }
+
+    SwitchStatement::SwitchStatement(Expression* selector, std::vector<Case> cases, ASTNode* defaultBody,
+                                     common::LocationId location)
+    : ASTNode(location), selector_{selector}, cases_{std::move(cases)}, default_{defaultBody} {
+        for(const Case& branch : cases_){
+            for(std::int32_t value : branch.values){
+                byValue_.emplace_back(value, branch.body);
+            }
+        }
+        std::sort(byValue_.begin(), byValue_.end(),
+                  [](const auto& left, const auto& right){ return left.first < right.first;});
+    }
+    void SwitchStatement::accept(ASTVisitor& visitor){
+        visitor.visit(*this);
+    }
+    ASTNode* SwitchStatement::select(double selector)const{
+        std::int32_t value = 0;
+        if(!common::caseValue(selector, value)){
+            return default_;
+        }
+        auto it = std::lower_bound(byValue_.begin(), byValue_.end(), value,
+                                   [](const auto& entry, std::int32_t key){ return entry.first < key;});
+        return it != byValue_.end() && it->first == value ? it->second : default_;
+    }
+
+    WaitStatement::WaitStatement(double& waitTime, common::LocationId location) : waitTime_{waitTime}, ASTNode(location) {}
     void WaitStatement::accept(ASTVisitor& visitor){
         visitor.visit(*this);
     }
 
-    FunctionDeclaration::FunctionDeclaration(const std::string& name) : name_{name} {}
+    FunctionDeclaration::FunctionDeclaration(const std::string& name, std::vector<Parameter> parameters,
+                                             grs_lexer::TokenType returnType, std::vector<grs_lexer::Token> bodyTokens,
+                                             BodyParser* bodyParser, Arena& arena, common::LocationId location)
+    : ASTNode(location), name_{name}, parameters_{std::move(parameters)}, returnType_{returnType},
+      bodyTokens_{std::move(bodyTokens)}, bodyParser_{bodyParser}, arena_{&arena} {}
+    FunctionDeclaration::FunctionDeclaration(const std::string& name, std::vector<Parameter> parameters,
+                                             grs_lexer::TokenType returnType, FunctionBlock* body,
+                                             common::LocationId location)
+    : ASTNode(location), name_{name}, parameters_{std::move(parameters)}, returnType_{returnType},
+      body_{body}, parsed_{true} {}
     void FunctionDeclaration::accept(ASTVisitor& visitor){
         visitor.visit(*this);
     }
 
+    FunctionBlock* FunctionDeclaration::getBody(){
+        if(!parsed_){
+            parsed_ = true;
+            body_ = bodyParser_->parseBody(*this);
+            // the tree replaces the tokens
+            std::vector<grs_lexer::Token>().swap(bodyTokens_);
+        }
+        return body_;
+    }
+
+    namespace {
+
+    // the names DECLs declare, wherever they sit in a body
+    class DeclaredNames : public ASTVisitorBase{
+        public:
+        std::vector<std::string>& names;
+        // the same names, so a body with many DECLs is scanned in linear time
+        std::unordered_set<std::string> seen;
+        explicit DeclaredNames(std::vector<std::string>& found) : names{found} {}
+
+        void add(const std::string& name){
+            if(seen.insert(name).second){
+                names.push_back(name);
+            }
+        }
+        void scan(ASTNode* node){
+            if(node) node->accept(*this);
+        }
+        void visit(FunctionBlock& node) override{
+            for(auto* statement : node.getStatements()) scan(statement);
+        }
+        void visit(IfStatement& node) override{ scan(node.getThenBranch()); scan(node.getElseBranch());}
+        void visit(ForStatement& node) override{ scan(node.getBody());}
+        void visit(WhileStatement& node) override{ scan(node.getBody());}
+        void visit(RepeatStatement& node) override{ scan(node.getBody());}
+        void visit(SwitchStatement& node) override{
+            for(const auto& branch : node.getCases()) scan(branch.body);
+            scan(node.getDefault());
+        }
+        void visit(VariableDeclaration& node) override{ add(node.getName());}
+        void visit(FrameDeclaration& node) override{ add(node.getName());}
+        void visit(PositionDeclaration& node) override{ add(node.getName());}
+        void visit(AxisDeclaration& node) override{ add(node.getName());}
+    };
+
+    }
+
+    const std::vector<std::string>& FunctionDeclaration::getLocals(){
+        if(!localsKnown_){
+            localsKnown_ = true;
+            DeclaredNames found(locals_);
+            for(const auto& parameter : parameters_){
+                found.add(parameter.name);
+            }
+            found.scan(getBody());
+        }
+        return locals_;
+    }
+
+    FunctionDeclaration* Program::getEntry()const{
+        if(!root_){
+            return nullptr;
+        }
+        for(const auto& statement : root_->getStatements()){
+            if(statement && statement->getType() == ASTNodeType::FunctionDeclaration){
+                return static_cast<FunctionDeclaration*>(statement);
+            }
+        }
+        return nullptr;
+    }
+
+    FunctionTable functionTable(const FunctionBlock* program){
+        FunctionTable functions;
+        if(program){
+            for(const auto& statement : program->getStatements()){
+                if(statement && statement->getType() == ASTNodeType::FunctionDeclaration){
+                    auto function = static_cast<FunctionDeclaration*>(statement);
+                    functions.try_emplace(function->getName(), function);
+                }
+            }
+        }
+        return functions;
+    }
+
+    ReturnStatement::ReturnStatement(Expression* value, common::LocationId location)
+    : ASTNode(location), value_{value} {}
+    void ReturnStatement::accept(ASTVisitor& visitor){
+        visitor.visit(*this);
+    }
+
     //BinaryExpression
-    BinaryExpression::BinaryExpression(grs_lexer::TokenType op, std::shared_ptr<Expression> left, std::shared_ptr<Expression> right) 
-    : op_{op}, left_{std::move(left)}, right_{std::move(right)} {}
+    BinaryExpression::BinaryExpression(grs_lexer::TokenType op, Expression* left, Expression* right, common::LocationId location) 
+    : Expression(location), op_{op}, left_{std::move(left)}, right_{std::move(right)} {}
 
     void BinaryExpression::accept(ASTVisitor& visitor){
         visitor.visit(*this);
     }
 
     //UnaryExpression
-    UnaryExpression::UnaryExpression(grs_lexer::TokenType op, std::shared_ptr<Expression> expr) 
+    UnaryExpression::UnaryExpression(grs_lexer::TokenType op, Expression* expr) 
     : op_{op}, expr_{std::move(expr)} {}
     
     void UnaryExpression::accept(ASTVisitor& visitor){
@@ -96,9 +259,17 @@ namespace grs_ast {
         visitor.visit(*this);
     }
 
+    //CallExpression
+    CallExpression::CallExpression(const std::string& name, std::vector<Expression*> args, common::LocationId location)
+    : Expression(location), name_{name}, args_{std::move(args)} {}
+
+    void CallExpression::accept(ASTVisitor& visitor){
+        visitor.visit(*this);
+    }
+
     //VariableDeclaration
-    VariableDeclaration::VariableDeclaration(grs_lexer::TokenType dataType, const std::string& name, std::shared_ptr<Expression> initializer,std::vector<std::pair<int,int>> lineAndColumn) 
-    : dataType_{dataType}, name_{name}, initializer_{initializer}, ASTNode(std::move(lineAndColumn)) {}  
+    VariableDeclaration::VariableDeclaration(grs_lexer::TokenType dataType, const std::string& name, Expression* initializer,common::LocationId location) 
+    : dataType_{dataType}, name_{name}, initializer_{initializer}, ASTNode(location) {}  
     void VariableDeclaration::accept(ASTVisitor& visitor){
         visitor.visit(*this);
     }
@@ -0,0 +1,229 @@
+#include "ast/flat_ast.hpp"
+#include "ast/visitor.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include "common/case_value.hpp"
+
+namespace grs_ast {
+
+    // Lowers a pointer tree into a FlatAst, children first
+    class FlatAstBuilder : public ASTVisitorBase{
+        public:
+        explicit FlatAstBuilder(FlatAst& flat) : flat_{flat} {}
+
+        NodeId lower(ASTNode* node){
+            result_ = NO_NODE;
+            if(node){
+                node->accept(*this);
+            }
+            return result_;
+        }
+
+        void visit(FunctionBlock& node) override{
+            std::vector<NodeId> children;
+            children.reserve(node.getStatements().size());
+            for(ASTNode* statement : node.getStatements()){
+                NodeId child = lower(statement);
+                if(child != NO_NODE){
+                    children.push_back(child);
+                }
+            }
+            const auto first = static_cast<std::uint32_t>(flat_.children_.size());
+            flat_.children_.insert(flat_.children_.end(), children.begin(), children.end());
+            add(ASTNodeType::Program, flat_.blocks_,
+                FlatAst::Block{first, static_cast<std::uint32_t>(children.size())}, node);
+        }
+
+        void visit(MotionCommand& node) override{
+            const auto first = lowerArguments(node.getArgs());
+            add(ASTNodeType::Command, flat_.motions_,
+                FlatAst::Motion{intern(node.getCommand()), intern(node.getName()), first, argCount(node.getArgs())}, node);
+        }
+
+        void visit(BinaryExpression& node) override{
+            NodeId left = lower(node.getLeft());
+            NodeId right = lower(node.getRight());
+            add(ASTNodeType::BinaryExpression, flat_.binaries_, FlatAst::Binary{node.getOperator(), left, right}, node);
+        }
+
+        void visit(UnaryExpression& node) override{
+            NodeId operand = lower(node.getExpression());
+            add(ASTNodeType::UnaryExpression, flat_.unaries_, FlatAst::Unary{node.getOperator(), operand}, node);
+        }
+
+        void visit(LiteraExpression& node) override{
+            add(ASTNodeType::LiteralExpression, flat_.literals_, node.getValue(), node);
+        }
+
+        void visit(VariableExpression& node) override{
+            add(ASTNodeType::VariableExpression, flat_.variables_, FlatAst::Variable{intern(node.getName())}, node);
+        }
+
+        void visit(VariableDeclaration& node) override{
+            NodeId initializer = lower(node.getInitializer());
+            add(ASTNodeType::VariableDeclaration, flat_.variableDecls_,
+                FlatAst::VariableDecl{node.getDataType(), intern(node.getName()), initializer}, node);
+        }
+
+        void visit(FrameDeclaration& node) override{ structDeclaration(ASTNodeType::FrameDeclaration, node);}
+        void visit(PositionDeclaration& node) override{ structDeclaration(ASTNodeType::PositionDeclaration, node);}
+        void visit(AxisDeclaration& node) override{ structDeclaration(ASTNodeType::AxisDeclaration, node);}
+
+        void visit(ExecutePosAndAxisExpression& node) override{
+            NodeId value = lower(node.getExpr());
+            add(ASTNodeType::ExecutePosAndAxisExpression, flat_.memberAssigns_,
+                FlatAst::MemberAssign{intern(node.getName()), intern(node.getArg()), value}, node);
+        }
+
+        void visit(IfStatement& node) override{
+            NodeId condition = lower(node.getCondition());
+            NodeId thenBranch = lower(node.getThenBranch());
+            NodeId elseBranch = lower(node.getElseBranch());
+            add(ASTNodeType::IfStatement, flat_.ifs_, FlatAst::If{condition, thenBranch, elseBranch}, node);
+        }
+
+        void visit(ForStatement& node) override{
+            NodeId start = lower(node.getStart());
+            NodeId end = lower(node.getEnd());
+            NodeId body = lower(node.getBody());
+            add(ASTNodeType::ForStatement, flat_.fors_,
+                FlatAst::For{intern(node.getCounter()), start, end, node.getStep(), body}, node);
+        }
+
+        void visit(WhileStatement& node) override{
+            NodeId condition = lower(node.getCondition());
+            NodeId body = lower(node.getBody());
+            add(ASTNodeType::WhileStatement, flat_.loops_, FlatAst::Loop{condition, body}, node);
+        }
+
+        void visit(RepeatStatement& node) override{
+            NodeId body = lower(node.getBody());
+            NodeId condition = lower(node.getCondition());
+            add(ASTNodeType::RepeatStatement, flat_.loops_, FlatAst::Loop{condition, body}, node);
+        }
+
+        void visit(SwitchStatement& node) override{
+            NodeId selector = lower(node.getSelector());
+            std::vector<FlatAst::Case> cases;
+            for(const auto& branch : node.getCases()){
+                NodeId body = lower(branch.body);
+                for(std::int32_t value : branch.values){
+                    cases.push_back(FlatAst::Case{value, body});
+                }
+            }
+            NodeId defaultBody = lower(node.getDefault());
+            std::sort(cases.begin(), cases.end(),
+                      [](const FlatAst::Case& left, const FlatAst::Case& right){ return left.value < right.value;});
+            const auto first = static_cast<std::uint32_t>(flat_.cases_.size());
+            flat_.cases_.insert(flat_.cases_.end(), cases.begin(), cases.end());
+            add(ASTNodeType::SwitchStatement, flat_.switches_,
+                FlatAst::Switch{selector, first, static_cast<std::uint32_t>(cases.size()), defaultBody}, node);
+        }
+
+        void visit(WaitStatement& node) override{
+            add(ASTNodeType::WaitStatement, flat_.waitTimes_, node.waitTime_, node);
+        }
+
+        // the flat form covers the whole program, so pending DEF bodies are parsed here
+        void visit(FunctionDeclaration& node) override{
+            NodeId body = lower(node.getBody());
+            FlatAst::Function function{intern(node.getName()), body,
+                                       static_cast<std::uint32_t>(flat_.parameters_.size()),
+                                       static_cast<std::uint32_t>(node.getParameters().size()),
+                                       static_cast<std::uint32_t>(flat_.locals_.size()),
+                                       static_cast<std::uint32_t>(node.getLocals().size()), node.getReturnType()};
+            for(const auto& parameter : node.getParameters()){
+                flat_.parameters_.push_back({parameter.type, intern(parameter.name)});
+            }
+            for(const auto& local : node.getLocals()){
+                flat_.locals_.push_back(intern(local));
+            }
+            add(ASTNodeType::FunctionDeclaration, flat_.functions_, function, node);
+        }
+
+        void visit(CallExpression& node) override{
+            std::vector<NodeId> args;
+            args.reserve(node.getArgs().size());
+            for(Expression* arg : node.getArgs()){
+                args.push_back(lower(arg));
+            }
+            const auto first = static_cast<std::uint32_t>(flat_.children_.size());
+            flat_.children_.insert(flat_.children_.end(), args.begin(), args.end());
+            add(ASTNodeType::CallExpression, flat_.calls_,
+                FlatAst::Call{intern(node.getName()), first, static_cast<std::uint32_t>(args.size())}, node);
+        }
+
+        void visit(ReturnStatement& node) override{
+            NodeId value = lower(node.getValue());
+            add(ASTNodeType::ReturnStatement, flat_.returns_, value, node);
+        }
+
+        private:
+        FlatAst& flat_;
+        NodeId result_ = NO_NODE;
+        std::unordered_map<std::string, NameId> nameIds_;
+
+        NameId intern(const std::string& name){
+            auto [it, inserted] = nameIds_.try_emplace(name, static_cast<NameId>(flat_.names_.size()));
+            if(inserted){
+                flat_.names_.push_back(name);
+            }
+            return it->second;
+        }
+
+        template<class Table, class Row>
+        void add(ASTNodeType kind, Table& table, Row&& row, const ASTNode& node){
+            flat_.locations_.push_back(node.getLocation());
+
+            result_ = static_cast<NodeId>(flat_.kinds_.size());
+            flat_.kinds_.push_back(kind);
+            flat_.slots_.push_back(static_cast<std::uint32_t>(table.size()));
+            table.push_back(std::forward<Row>(row));
+        }
+
+        using Arguments = std::vector<std::pair<std::string, Expression*>>;
+
+        static std::uint32_t argCount(const Arguments& args){
+            return static_cast<std::uint32_t>(args.size());
+        }
+
+        // lowers the values first, then stores the arguments contiguously
+        std::uint32_t lowerArguments(const Arguments& args){
+            std::vector<FlatAst::Argument> lowered;
+            lowered.reserve(args.size());
+            for(const auto& [name, value] : args){
+                NodeId valueId = lower(value);
+                lowered.push_back({intern(name), valueId});
+            }
+            const auto first = static_cast<std::uint32_t>(flat_.arguments_.size());
+            flat_.arguments_.insert(flat_.arguments_.end(), lowered.begin(), lowered.end());
+            return first;
+        }
+
+        template<class NodeType>
+        void structDeclaration(ASTNodeType kind, NodeType& node){
+            const auto first = lowerArguments(node.getArgs());
+            add(kind, flat_.structDecls_, FlatAst::StructDecl{intern(node.getName()), first, argCount(node.getArgs())}, node);
+        }
+    };
+
+    FlatAst FlatAst::fromTree(FunctionBlock& root){
+        FlatAst flat;
+        FlatAstBuilder builder(flat);
+        flat.root_ = builder.lower(&root);
+        return flat;
+    }
+
+    NodeId FlatAst::select(const Switch& node, double selector)const{
+        std::int32_t value = 0;
+        if(!common::caseValue(selector, value)){
+            return node.defaultBody;
+        }
+        const auto first = cases_.begin() + node.firstCase;
+        const auto last = first + node.caseCount;
+        auto it = std::lower_bound(first, last, value,
+                                   [](const Case& entry, std::int32_t key){ return entry.value < key;});
+        return it != last && it->value == value ? it->body : node.defaultBody;
+    }
+
+}
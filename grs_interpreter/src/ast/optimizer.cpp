@@ -0,0 +1,493 @@
+#include "ast/optimizer.hpp"
+#include <limits>
+#include <unordered_set>
+
+namespace grs_ast{
+
+namespace {
+
+// Visits what the generator runs: the top-level statements, the body of
+// the first DEF and, once each, the bodies of the DEFs called from there.
+// Counts the nodes it reaches.
+class ExecutedTree : public ASTVisitorBase{
+    public:
+    size_t nodes = 0;
+
+    explicit ExecutedTree(const FunctionTable& functions) : functions_{functions} {}
+
+    void walk(ASTNode* node){
+        if(node){
+            ++nodes;
+            node->accept(*this);
+        }
+    }
+    void visit(FunctionBlock& node) override{
+        for(auto* statement : node.getStatements()) walk(statement);
+    }
+    void visit(FunctionDeclaration& node) override{
+        if(!entrySeen_){
+            entrySeen_ = true;
+            walk(node.getBody());
+        }
+    }
+    void visit(BinaryExpression& node) override{ walk(node.getLeft()); walk(node.getRight());}
+    void visit(UnaryExpression& node) override{ walk(node.getExpression());}
+    void visit(VariableDeclaration& node) override{ walk(node.getInitializer());}
+    void visit(FrameDeclaration& node) override{ for(const auto& arg : node.getArgs()) walk(arg.second);}
+    void visit(PositionDeclaration& node) override{ for(const auto& arg : node.getArgs()) walk(arg.second);}
+    void visit(AxisDeclaration& node) override{ for(const auto& arg : node.getArgs()) walk(arg.second);}
+    void visit(ExecutePosAndAxisExpression& node) override{ walk(node.getExpr());}
+    void visit(MotionCommand& node) override{ for(const auto& arg : node.getArgs()) walk(arg.second);}
+    void visit(IfStatement& node) override{
+        walk(node.getCondition()); walk(node.getThenBranch()); walk(node.getElseBranch());
+    }
+    void visit(ForStatement& node) override{ walk(node.getStart()); walk(node.getEnd()); walk(node.getBody());}
+    void visit(WhileStatement& node) override{ walk(node.getCondition()); walk(node.getBody());}
+    void visit(RepeatStatement& node) override{ walk(node.getBody()); walk(node.getCondition());}
+    void visit(SwitchStatement& node) override{
+        walk(node.getSelector());
+        for(const auto& branch : node.getCases()) walk(branch.body);
+        walk(node.getDefault());
+    }
+    void visit(CallExpression& node) override{
+        for(auto* arg : node.getArgs()) walk(arg);
+        auto it = functions_.find(node.getName());
+        if(it != functions_.end() && called_.insert(it->second).second){
+            walk(it->second->getBody());
+        }
+    }
+    void visit(ReturnStatement& node) override{ walk(node.getValue());}
+
+    private:
+    const FunctionTable& functions_;
+    bool entrySeen_ = false;
+    std::unordered_set<const FunctionDeclaration*> called_;
+};
+
+// How often each name is declared and whether anything writes to it
+class Usage : public ExecutedTree{
+    public:
+    std::unordered_map<std::string, int>& declarations;
+    std::unordered_map<std::string, bool>& written;
+
+    Usage(const FunctionTable& functions, std::unordered_map<std::string, int>& declared,
+          std::unordered_map<std::string, bool>& writes)
+    : ExecutedTree(functions), declarations{declared}, written{writes} {}
+
+    void visit(VariableDeclaration& node) override{
+        ++declarations[node.getName()];
+        ExecutedTree::visit(node);
+    }
+    void visit(FrameDeclaration& node) override{
+        ++declarations[node.getName()];
+        ExecutedTree::visit(node);
+    }
+    void visit(PositionDeclaration& node) override{
+        ++declarations[node.getName()];
+        ExecutedTree::visit(node);
+    }
+    void visit(AxisDeclaration& node) override{
+        ++declarations[node.getName()];
+        ExecutedTree::visit(node);
+    }
+    void visit(ExecutePosAndAxisExpression& node) override{
+        written[node.getName()] = true;
+        ExecutedTree::visit(node);
+    }
+    void visit(BinaryExpression& node) override{
+        if(node.getOperator() == grs_lexer::TokenType::ASSIGN){
+            if(auto variable = dynamic_cast<VariableExpression*>(node.getLeft())){
+                written[variable->getName()] = true;
+            }
+        }
+        ExecutedTree::visit(node);
+    }
+    void visit(ForStatement& node) override{
+        written[node.getCounter()] = true;
+        ExecutedTree::visit(node);
+    }
+};
+
+// The DEFs whose run may hand a command (MOTION or WAIT) to the host,
+// directly or through the DEFs they call
+class YieldingFunctions : public ExecutedTree{
+    public:
+    std::unordered_set<const FunctionDeclaration*> found;
+
+    YieldingFunctions(const FunctionTable& functions, ASTNode* program)
+    : ExecutedTree(functions), functions_{functions} {
+        walk(program);
+        // a caller yields when any DEF it calls does
+        for(bool changed = true; changed;){
+            changed = false;
+            for(const auto& [caller, callee] : calls_){
+                if(caller && found.count(callee) && found.insert(caller).second){
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    void visit(FunctionDeclaration& node) override{
+        if(!current_){
+            current_ = &node;
+            ExecutedTree::visit(node);
+        }
+    }
+    void visit(MotionCommand& node) override{
+        found.insert(current_);
+        ExecutedTree::visit(node);
+    }
+    void visit(WaitStatement&) override{ found.insert(current_);}
+    void visit(CallExpression& node) override{
+        for(auto* arg : node.getArgs()) walk(arg);
+        auto it = functions_.find(node.getName());
+        if(it == functions_.end()){
+            return;
+        }
+        calls_.emplace_back(current_, it->second);
+        if(seen_.insert(it->second).second){
+            const FunctionDeclaration* caller = current_;
+            current_ = it->second;
+            walk(it->second->getBody());
+            current_ = caller;
+        }
+    }
+
+    private:
+    const FunctionTable& functions_;
+    const FunctionDeclaration* current_ = nullptr;
+    std::unordered_set<const FunctionDeclaration*> seen_;
+    std::vector<std::pair<const FunctionDeclaration*, const FunctionDeclaration*>> calls_;
+};
+
+// Whether running a statement may hand a command to the host
+class Yields : public ExecutedTree{
+    public:
+    bool found = false;
+
+    Yields(const FunctionTable& functions, const std::unordered_set<const FunctionDeclaration*>& yielding)
+    : ExecutedTree(functions), functions_{functions}, yielding_{yielding} {}
+
+    void visit(FunctionDeclaration&) override{}
+    void visit(MotionCommand&) override{ found = true;}
+    void visit(WaitStatement&) override{ found = true;}
+    void visit(CallExpression& node) override{
+        for(auto* arg : node.getArgs()) walk(arg);
+        auto it = functions_.find(node.getName());
+        found = found || (it != functions_.end() && yielding_.count(it->second));
+    }
+
+    private:
+    const FunctionTable& functions_;
+    const std::unordered_set<const FunctionDeclaration*>& yielding_;
+};
+
+// int, double and bool literals, the way the generator loads them
+bool numberOf(const Expression* expr, double& value){
+    auto literal = dynamic_cast<const LiteraExpression*>(expr);
+    if(!literal){
+        return false;
+    }
+    if(auto val = std::get_if<int>(&literal->getValue())){
+        value = static_cast<double>(*val);
+    } else if(auto val = std::get_if<double>(&literal->getValue())){
+        value = *val;
+    } else if(auto val = std::get_if<bool>(&literal->getValue())){
+        value = *val ? 1.0 : 0.0;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// false: not a constant, or a division by zero
+bool applyBinary(grs_lexer::TokenType op, double left, double right, double& result){
+    switch(op){
+        case grs_lexer::TokenType::PLUS:      result = left + right; break;
+        case grs_lexer::TokenType::MINUS:     result = left - right; break;
+        case grs_lexer::TokenType::MULTIPLY:  result = left * right; break;
+        case grs_lexer::TokenType::DIVIDE:
+            if(right == 0.0){
+                return false;
+            }
+            result = left / right;
+            break;
+        case grs_lexer::TokenType::LESS:      result = left < right ? 1.0 : 0.0; break;
+        case grs_lexer::TokenType::LESSEQ:    result = left <= right ? 1.0 : 0.0; break;
+        case grs_lexer::TokenType::GREATER:   result = left > right ? 1.0 : 0.0; break;
+        case grs_lexer::TokenType::GREATEREQ: result = left >= right ? 1.0 : 0.0; break;
+        case grs_lexer::TokenType::EQUAL:     result = left == right ? 1.0 : 0.0; break;
+        case grs_lexer::TokenType::NOTEQUAL:  result = left != right ? 1.0 : 0.0; break;
+        case grs_lexer::TokenType::AND:       result = (left != 0.0 && right != 0.0) ? 1.0 : 0.0; break;
+        case grs_lexer::TokenType::OR:        result = (left != 0.0 || right != 0.0) ? 1.0 : 0.0; break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+}
+
+std::ostream& operator<<(std::ostream& os, const OptimizerStats& stats){
+    return os << "Optimizer: " << stats.nodesBefore << " -> " << stats.nodesAfter << " nodes ("
+              << stats.getRemovedNodes() << " removed), " << stats.foldedExpressions << " folded, "
+              << stats.propagatedConstants << " constants propagated, "
+              << stats.removedBranches << " IF branches dropped";
+}
+
+OptimizerStats Optimizer::optimize(FunctionBlock* program, Arena& arena){
+    arena_ = &arena;
+    stats_ = OptimizerStats{};
+    entrySeen_ = false;
+    branchDepth_ = 0;
+    declarations_.clear();
+    written_.clear();
+    constants_.clear();
+    hostMayWrite_ = false;
+    if(!program){
+        return stats_;
+    }
+
+    const FunctionTable functions = functionTable(program);
+    Usage usage(functions, declarations_, written_);
+    usage.walk(program);
+    stats_.nodesBefore = usage.nodes;
+
+    const YieldingFunctions yielding(functions, program);
+    functions_ = &functions;
+    yielding_ = &yielding.found;
+    program->accept(*this);
+    functions_ = nullptr;
+    yielding_ = nullptr;
+
+    ExecutedTree after(functions);
+    after.walk(program);
+    stats_.nodesAfter = after.nodes;
+    return stats_;
+}
+
+Expression* Optimizer::literal(double value){
+    return arena_->make<LiteraExpression>(value);
+}
+
+Expression* Optimizer::fold(Expression* expr, bool numeric){
+    if(!expr){
+        return expr;
+    }
+    switch(expr->getType()){
+        case ASTNodeType::VariableExpression:{
+            auto it = constants_.find(static_cast<VariableExpression*>(expr)->getName());
+            if(it == constants_.end()){
+                return expr;
+            }
+            ++stats_.propagatedConstants;
+            return literal(it->second);
+        }
+        case ASTNodeType::BinaryExpression:{
+            auto binary = static_cast<BinaryExpression*>(expr);
+            if(binary->getOperator() == grs_lexer::TokenType::ASSIGN){
+                binary->setRight(fold(binary->getRight(), true));
+                return expr;
+            }
+            binary->setLeft(fold(binary->getLeft(), true));
+            binary->setRight(fold(binary->getRight(), true));
+            double left = 0.0, right = 0.0, result = 0.0;
+            if(numberOf(binary->getLeft(), left) && numberOf(binary->getRight(), right) &&
+               applyBinary(binary->getOperator(), left, right, result)){
+                ++stats_.foldedExpressions;
+                return literal(result);
+            }
+            return expr;
+        }
+        case ASTNodeType::UnaryExpression:{
+            auto unary = static_cast<UnaryExpression*>(expr);
+            unary->setExpression(fold(unary->getExpression(), true));
+            double value = 0.0;
+            if(!numberOf(unary->getExpression(), value)){
+                return expr;
+            }
+            if(unary->getOperator() == grs_lexer::TokenType::MINUS){
+                ++stats_.foldedExpressions;
+                return literal(-value);
+            }
+            if(numeric){
+                ++stats_.foldedExpressions;
+                return arena_->make<LiteraExpression>(value == 0.0);
+            }
+            return expr;
+        }
+        case ASTNodeType::CallExpression:
+            foldCallArgs(*static_cast<CallExpression*>(expr));
+            return expr;
+        default:
+            return expr;
+    }
+}
+
+// arguments are passed as numbers
+void Optimizer::foldCallArgs(CallExpression& node){
+    for(size_t i = 0; i < node.getArgs().size(); ++i){
+        node.setArg(i, fold(node.getArgs()[i], true));
+    }
+}
+
+void Optimizer::visit(FunctionBlock& node){
+    for(auto* statement : node.getStatements()){
+        if(!statement){
+            continue;
+        }
+        // outside branches and loops the statements come in the order they
+        // run, and the statements inside one that does not yield cannot either
+        if(!hostMayWrite_ && branchDepth_ == 0){
+            Yields yields(*functions_, *yielding_);
+            yields.walk(statement);
+            if(yields.found){
+                hostMayWrite_ = true;
+                constants_.clear();
+            }
+        }
+        statement->accept(*this);
+    }
+}
+
+void Optimizer::visit(FunctionDeclaration& node){
+    if(entrySeen_){
+        return;
+    }
+    entrySeen_ = true;
+    if(auto body = node.getBody()){
+        body->accept(*this);
+    }
+}
+
+// expression statements; only an assignment or a call has anything to fold
+void Optimizer::visit(BinaryExpression& node){
+    if(node.getOperator() == grs_lexer::TokenType::ASSIGN){
+        node.setRight(fold(node.getRight(), true));
+    }
+}
+
+void Optimizer::visit(CallExpression& node){
+    foldCallArgs(node);
+}
+
+// a RETURN value is read as a number
+void Optimizer::visit(ReturnStatement& node){
+    node.setValue(fold(node.getValue(), true));
+}
+
+void Optimizer::visit(VariableDeclaration& node){
+    node.setInitializer(fold(node.getInitializer(), false));
+
+    const std::string& name = node.getName();
+    const auto type = node.getDataType();
+    if(hostMayWrite_ || branchDepth_ > 0 || declarations_[name] != 1 || written_[name] ||
+       (type != grs_lexer::TokenType::INT && type != grs_lexer::TokenType::REAL)){
+        return;
+    }
+    // the generator stores an uninitialised variable as 0.0, and reads an
+    // INT back as the truncated value
+    double value = 0.0;
+    if(node.getInitializer()){
+        if(!numberOf(node.getInitializer(), value)){
+            return;
+        }
+    }
+    if(type == grs_lexer::TokenType::INT){
+        if(!(value > std::numeric_limits<int>::min() - 1.0 && value < std::numeric_limits<int>::max() + 1.0)){
+            return;
+        }
+        value = static_cast<double>(static_cast<int>(value));
+    }
+    constants_[name] = value;
+}
+
+template<typename NodeType>
+void Optimizer::foldArgs(NodeType& node){
+    for(size_t i = 0; i < node.getArgs().size(); ++i){
+        node.setArg(i, fold(node.getArgs()[i].second, false));
+    }
+}
+
+void Optimizer::visit(FrameDeclaration& node){ foldArgs(node);}
+void Optimizer::visit(PositionDeclaration& node){ foldArgs(node);}
+void Optimizer::visit(AxisDeclaration& node){ foldArgs(node);}
+
+void Optimizer::visit(ExecutePosAndAxisExpression& node){
+    node.setExpr(fold(node.getExpr(), false));
+}
+
+void Optimizer::visit(IfStatement& node){
+    node.setCondition(fold(node.getCondition(), true));
+
+    // a string condition is false to both the generator and the VM
+    double value = 0.0;
+    auto condition = dynamic_cast<LiteraExpression*>(node.getCondition());
+    if(condition){
+        const bool taken = numberOf(condition, value) && value != 0.0;
+        ASTNode* dead = taken ? node.getElseBranch() : node.getThenBranch();
+        if(dead && taken){
+            node.setElseBranch(nullptr);
+        } else if(dead){
+            node.setThenBranch(nullptr);
+        }
+        stats_.removedBranches += dead ? 1 : 0;
+    }
+
+    ++branchDepth_;
+    if(node.getThenBranch()){
+        node.getThenBranch()->accept(*this);
+    }
+    if(node.getElseBranch()){
+        node.getElseBranch()->accept(*this);
+    }
+    --branchDepth_;
+}
+
+// start and end are read as numbers; a loop body, like a branch, may run
+// any number of times
+void Optimizer::visit(ForStatement& node){
+    node.setStart(fold(node.getStart(), true));
+    node.setEnd(fold(node.getEnd(), true));
+    ++branchDepth_;
+    if(node.getBody()){
+        node.getBody()->accept(*this);
+    }
+    --branchDepth_;
+}
+
+void Optimizer::visit(WhileStatement& node){
+    node.setCondition(fold(node.getCondition(), true));
+    ++branchDepth_;
+    if(node.getBody()){
+        node.getBody()->accept(*this);
+    }
+    --branchDepth_;
+}
+
+void Optimizer::visit(RepeatStatement& node){
+    ++branchDepth_;
+    if(node.getBody()){
+        node.getBody()->accept(*this);
+    }
+    --branchDepth_;
+    node.setCondition(fold(node.getCondition(), true));
+}
+
+// the selector is read as a number; at most one body runs
+void Optimizer::visit(SwitchStatement& node){
+    node.setSelector(fold(node.getSelector(), true));
+    ++branchDepth_;
+    for(const auto& branch : node.getCases()){
+        if(branch.body){
+            branch.body->accept(*this);
+        }
+    }
+    if(node.getDefault()){
+        node.getDefault()->accept(*this);
+    }
+    --branchDepth_;
+}
+
+}
@@ -1,6 +1,7 @@
 #include "executor/executor.hpp"
 #include <thread>
 #include <chrono>
+#include <stdexcept>
 
 namespace grs_interpreter{
 
@@ -25,73 +26,118 @@ void Executor::setupStateMachine(){
     }
 
 
-void Executor::executeLinMotion(prStringAndValueType args){
+// POS and FRAME targets are Cartesian and move to x, y, z; an AXIS target
+// is a set of joint angles
+void Executor::executeLinMotion(const common::ValueType& position){
 
-    auto pos = std::get<common::Position>(args.second);
-    mockLinearMotion(pos.x, pos.y, pos.z);
+    if(auto axis = std::get_if<common::Axis>(&position)){
+        mockAxisMotion("LINEAR", *axis);
+    } else {
+        auto pos = cartesianTarget(position);
+        mockLinearMotion(pos.x, pos.y, pos.z);
+    }
     std::this_thread::sleep_for(std::chrono::milliseconds(2000));
 }    
 
-void Executor::executePtpMotion(prStringAndValueType args){
+void Executor::executePtpMotion(const common::ValueType& position){
 
-    auto pos = std::get<common::Position>(args.second);
-    mockPtpMotion(pos.x, pos.y, pos.z);
+    if(auto axis = std::get_if<common::Axis>(&position)){
+        mockAxisMotion("PTP", *axis);
+    } else {
+        auto pos = cartesianTarget(position);
+        mockPtpMotion(pos.x, pos.y, pos.z);
+    }
     std::this_thread::sleep_for(std::chrono::milliseconds(2000));
 
 }    
 
 
-void Executor::executeCirclMotion(prStringAndValueType args){
+void Executor::executeCirclMotion(const common::ValueType& position){
 
-    auto pos = std::get<common::Position>(args.second);
-    mockCircMotion(pos.x, pos.y, pos.z);
+    if(auto axis = std::get_if<common::Axis>(&position)){
+        mockAxisMotion("CIRCL", *axis);
+    } else {
+        auto pos = cartesianTarget(position);
+        mockCircMotion(pos.x, pos.y, pos.z);
+    }
     std::this_thread::sleep_for(std::chrono::milliseconds(2000));
 
 } 
 
-void Executor::executeWaitCommand(prStringAndValueType args){
+common::Position Executor::cartesianTarget(const common::ValueType& position){
+
+    if(auto pos = std::get_if<common::Position>(&position)){
+        return *pos;
+    }
+    if(auto frame = std::get_if<common::Frame>(&position)){
+        return common::Position{frame->x, frame->y, frame->z, frame->a, frame->b, frame->c};
+    }
+    throw std::runtime_error("Motion target is not a POS, FRAME or AXIS value");
+}
+
+void Executor::executeWaitCommand(const common::ValueType& duration){
 
-    auto t = std::get<double>(args.second);
+    auto t = std::get<double>(duration);
     mockWaitFunc(t);
     std::this_thread::sleep_for(std::chrono::milliseconds(2000));
 } 
 
 
-void Executor::executeInstruction(std::vector<Instruction> instruction){
+void Executor::executeInstruction(const InstructionList& instructions){
 
     stateMachine_.convertState("RUNNING");
     stateMachine_.executeCurrentState();
     
-    for(const auto& inst : instruction)
+    for(const auto& inst : instructions.code)
     {        
-        
-        if(inst.command == "LIN" || inst.command == "PTP" || inst.command == "CIRC" || inst.command == "WAIT")
+        executeCommand(inst, instructions);
+    }
+
+
+}
+
+void Executor::run(grs_vm::Vm& vm){
+
+    stateMachine_.convertState("RUNNING");
+    stateMachine_.executeCurrentState();
+
+    while(const Instruction* inst = vm.next())
+    {
+        executeCommand(*inst, vm.getCommands());
+    }
+}
+
+void Executor::executeCommand(const Instruction& inst, const InstructionList& instructions){
+
+    switch (inst.op)
+    {
+        case Opcode::MOTION:
+        switch (inst.getType())
         {
-           
-            switch (typeToStringCommand.at(inst.command))
-            {
-                case CommandCategories::LIN:
-                executeLinMotion(inst.args.back());
-                break;
-                
-                case CommandCategories::PTP: 
-                executePtpMotion(inst.args.back());
-                break;
-
-                case CommandCategories::CIRC: 
-                executeCirclMotion(inst.args.back());
-                break;
-
-                case CommandCategories::WAIT: 
-                executeWaitCommand(inst.args.back());
-                break;
-            }  
+            case grs_lexer::TokenType::LIN:
+            executeLinMotion(instructions.getValue(inst));
+            break;
 
+            case grs_lexer::TokenType::PTP:
+            executePtpMotion(instructions.getValue(inst));
+            break;
+
+            case grs_lexer::TokenType::CIRC:
+            executeCirclMotion(instructions.getValue(inst));
+            break;
+
+            default:
+            break;
         }
-        
-    }
+        break;
 
+        case Opcode::WAIT:
+        executeWaitCommand(instructions.getValue(inst));
+        break;
 
+        default:
+        break;
+    }
 }
 
 
@@ -110,6 +156,12 @@ void Executor::mockCircMotion(double& x, double& y, double& z){
     "x: "<<x<<" "<<"y: "<<y<<" "<<"z: "<<z<<"\n"; 
 }
 
+void Executor::mockAxisMotion(const char* motion, const common::Axis& axis){
+    std::cout<<"REALTIME "<<motion<<" || "<<
+    "A1: "<<axis.A1<<" "<<"A2: "<<axis.A2<<" "<<"A3: "<<axis.A3<<" "<<
+    "A4: "<<axis.A4<<" "<<"A5: "<<axis.A5<<" "<<"A6: "<<axis.A6<<"\n";
+}
+
 void Executor::mockWaitFunc(int t){
     std::cout<<"REALTIME WAIT || "<<
     "time: "<<t<<"\n"; 
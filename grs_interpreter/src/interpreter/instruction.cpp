@@ -0,0 +1,71 @@
+#include "interpreter/instruction.hpp"
+
+namespace grs_interpreter{
+
+grs_lexer::TokenType motionType(std::string_view command){
+    using grs_lexer::TokenType;
+    for(TokenType type : {TokenType::PTP, TokenType::LIN, TokenType::CIRC, TokenType::SPLINE,
+                          TokenType::PTP_REL, TokenType::LIN_REL, TokenType::CIRC_REL, TokenType::SPLINE_REL}){
+        if(grs_lexer::typeToStringMap.at(type) == command){
+            return type;
+        }
+    }
+    return TokenType::ENDOFFILE;
+}
+
+std::string InstructionList::commandName(const Instruction& instruction)const{
+    switch(instruction.op){
+        case Opcode::DECL:          return "DECL_" + getName(instruction);
+        case Opcode::ASSIGN:        return "ASSIGN_" + getName(instruction);
+        case Opcode::POSITION_DECL: return "Position_DECL";
+        case Opcode::FRAME_DECL:    return "Frame_DECL";
+        case Opcode::AXIS_DECL:     return "Axis_DECL";
+        case Opcode::MOTION:        return std::string(grs_lexer::typeToStringMap.at(instruction.getType()));
+        case Opcode::WAIT:          return "WAIT";
+        case Opcode::IF_START:      return "IF_START";
+        case Opcode::THEN_BLOCK:    return "THEN_BLOCK";
+        case Opcode::ELSE_BLOCK:    return "ELSE_BLOCK";
+        case Opcode::IF_END:        return "IF_END";
+    }
+    return "UNKNOWN";
+}
+
+std::vector<std::pair<std::string, common::ValueType>> InstructionList::arguments(const Instruction& instruction)const{
+    std::vector<std::pair<std::string, common::ValueType>> args;
+    switch(instruction.op){
+        case Opcode::DECL:
+            args.emplace_back("type", std::string(grs_lexer::typeToStringMap.at(instruction.getType())));
+            args.emplace_back("value", getValue(instruction));
+            break;
+        case Opcode::ASSIGN:
+            args.emplace_back("variable", getName(instruction));
+            args.emplace_back("value", getValue(instruction));
+            break;
+        case Opcode::POSITION_DECL:
+        case Opcode::FRAME_DECL:
+        case Opcode::AXIS_DECL:{
+            const char* prefix = instruction.op == Opcode::POSITION_DECL ? "Position"
+                               : instruction.op == Opcode::FRAME_DECL ? "Frame" : "Axis";
+            args.emplace_back("name", getName(instruction));
+            args.emplace_back(prefix, getValue(instruction));
+            break;
+        }
+        case Opcode::MOTION:
+            args.emplace_back("position", getName(instruction));
+            args.emplace_back("Position Information", getValue(instruction));
+            break;
+        case Opcode::WAIT:
+            args.emplace_back("duration_time", getValue(instruction));
+            break;
+        case Opcode::IF_START:
+            args.emplace_back("condition", getValue(instruction));
+            break;
+        case Opcode::THEN_BLOCK:
+        case Opcode::ELSE_BLOCK:
+        case Opcode::IF_END:
+            break;
+    }
+    return args;
+}
+
+}
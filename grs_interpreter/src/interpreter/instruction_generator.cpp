@@ -1,25 +1,77 @@
 #include "interpreter/instruction_generator.hpp"
 #include <iostream>
+#include "common/counted_loop.hpp"
+#include "common/int_conversion.hpp"
 
 
 namespace grs_interpreter{
 
+namespace {
+
+// a condition, loop bound or SWITCH selector read as a number; anything
+// else counts as 0
+double numberOf(const common::ValueType& value){
+    if(auto val = std::get_if<double>(&value)) return *val;
+    if(auto val = std::get_if<int>(&value)) return *val;
+    if(auto val = std::get_if<bool>(&value)) return *val ? 1.0 : 0.0;
+    return 0.0;
+}
+
+}
+
 
 InstructionGenerator::InstructionGenerator(){}
 InstructionGenerator::~InstructionGenerator(){}
 
 
-std::vector<Instruction> InstructionGenerator::generateInstructions(const std::shared_ptr<grs_ast::FunctionBlock>& program){
-    instruction_.clear();
+InstructionList InstructionGenerator::generateInstructions(grs_ast::FunctionBlock* program){
+    program_ = InstructionList{};
+    nameIds_.clear();
+    // compiled expressions belong to the program they came from
+    compiled_.clear();
+    repeating_ = 0;
+    entryGenerated_ = false;
+    functions_ = grs_ast::functionTable(program);
+    depth_ = 0;
+    returning_ = false;
+    arguments_.clear();
+    savedVariables_.clear();
     if(program){
         program->accept(*this);
     }
-    return instruction_;
+    compiled_.clear();
+    return std::move(program_);
+}
+
+void InstructionGenerator::emit(Opcode op, const std::string* name, const common::ValueType* value,
+                                common::LocationId location, grs_lexer::TokenType type){
+    Instruction instruction;
+    instruction.op = op;
+    instruction.type = static_cast<std::uint16_t>(type);
+    instruction.location = location;
+    if(name){
+        auto [it, inserted] = nameIds_.try_emplace(*name, static_cast<std::uint32_t>(program_.names.size()));
+        if(inserted){
+            program_.names.push_back(*name);
+        }
+        instruction.name = it->second;
+    }
+    if(value){
+        instruction.value = static_cast<std::uint32_t>(program_.constants.size());
+        program_.constants.push_back(*value);
+    }
+    program_.code.push_back(instruction);
 }
 
 void InstructionGenerator::visit(grs_ast::FunctionBlock& node){
     for(const auto& statement : node.getStatements()){
-        if (statement)
+        if(returning_){
+            break;
+        }
+        if(auto expr = dynamic_cast<grs_ast::Expression*>(statement)){
+            evaluateExpression(expr);
+        }
+        else if (statement)
         {
             statement->accept(*this);
         }
@@ -29,26 +81,24 @@ void InstructionGenerator::visit(grs_ast::FunctionBlock& node){
 
 
 void InstructionGenerator::visit(grs_ast::MotionCommand& node){
-    Instruction instruction;
-    instruction.command = node.getCommand();
-    instruction.commandLocationInfo = node.getLineColumn();
-    for (const auto& arg : node.getArgs()) {
-        instruction.args.emplace_back(arg.first, node.getName());
-    }
-    instruction.args.emplace_back("Position Information",getVariableValue(node.getName()));
-    instruction_.emplace_back(instruction);
+    emitMotion(node.getCommand(), node.getName(), node.getLocation());
+}
+
+void InstructionGenerator::emitMotion(const std::string& command, const std::string& name, common::LocationId location){
+    const common::ValueType value = getVariableValue(name);
+    emit(Opcode::MOTION, &name, &value, location, motionType(command));
 }
 
 void InstructionGenerator::visit(grs_ast::PositionDeclaration& node){
-   executeDeclaration<grs_ast::PositionDeclaration&,common::Position>(node, grs_lexer::TokenType::POS, "Position");
+   executeDeclaration<grs_ast::PositionDeclaration,common::Position>(node, grs_lexer::TokenType::POS, Opcode::POSITION_DECL);
 }
 
 void InstructionGenerator::visit(grs_ast::FrameDeclaration& node){
-    executeDeclaration<grs_ast::FrameDeclaration&, common::Frame>(node, grs_lexer::TokenType::FRAME, "Frame");
+    executeDeclaration<grs_ast::FrameDeclaration, common::Frame>(node, grs_lexer::TokenType::FRAME, Opcode::FRAME_DECL);
 }
 
 void InstructionGenerator::visit(grs_ast::AxisDeclaration& node){
-    executeDeclaration<grs_ast::AxisDeclaration&, common::Axis>(node, grs_lexer::TokenType::AXIS, "Axis");
+    executeDeclaration<grs_ast::AxisDeclaration, common::Axis>(node, grs_lexer::TokenType::AXIS, Opcode::AXIS_DECL);
 }
 
 void InstructionGenerator::visit(grs_ast::ExecutePosAndAxisExpression& node){
@@ -65,210 +115,221 @@ void InstructionGenerator::visit(grs_ast::BinaryExpression& node){
     auto leftExpr =  node.getLeft();
     auto rightExpr = node.getRight();
 
-    if(double baseVal = 0.0; node.getOperator() == grs_lexer::TokenType::ASSIGN){
-        auto varExpr = std::reinterpret_pointer_cast<grs_ast::VariableExpression>(leftExpr);
+    if(node.getOperator() == grs_lexer::TokenType::ASSIGN){
+        auto varExpr = dynamic_cast<grs_ast::VariableExpression*>(leftExpr);
         if(!varExpr){
             std::cerr<<"assignment left side must be a variable \n";
             return;
         }
-        std::string varName = varExpr->getName();
-
-        if(!hasVariable(varName)){
-            std::cerr<<"Undefined variable: "<< varName<<std::endl;
-            return;
+        if(isAssignable(varExpr->getName())){
+            storeAssignment(varExpr->getName(), declaredVariables_[varExpr->getName()], walk(rightExpr));
         }
+        return;
+    }
 
+    const common::Value leftValue = walk(leftExpr);
+    applyBinary(node.getOperator(), leftValue, walk(rightExpr));
+}
 
-        common::ValueType rightValue = evaluateExpression(rightExpr);
-
-        //preparation before type convertions 
-        if (std::holds_alternative<double>(rightValue)) {
-            baseVal = std::get<double>(rightValue);
-        } else if (std::holds_alternative<int>(rightValue)) {
-            baseVal = static_cast<double>(std::get<int>(rightValue));
-        }else if (std::holds_alternative<bool>(rightValue)) {
-            baseVal = std::get<bool>(rightValue) ? 1.0 : 0.0;
-        }
-        
-        //type convertions setting
-        grs_lexer::TokenType targetType = declaredVariables_[varName].type;
-        switch (targetType) {
-            case grs_lexer::TokenType::INT:
-                setVariableValue(varName, static_cast<int>(baseVal));
-                currentValue_ = static_cast<double>(baseVal);
-                break;
-            case grs_lexer::TokenType::CHAR:
-                setVariableValue(varName,std::to_string(static_cast<int>(baseVal)));
-                currentValue_ = baseVal; 
-                break;
-            case grs_lexer::TokenType::BOOL:
-                setVariableValue(varName, (baseVal != 0.0));
-                currentValue_ = (baseVal != 0.0) ? 1.0 : 0.0;
-                break;
-            case grs_lexer::TokenType::REAL:
-            default:
-                setVariableValue(varName, baseVal);
-                currentValue_ = baseVal;
-                break;
-        }
-
-        std::vector<std::pair<std::string, common::ValueType>> args;
-        args.push_back({"variable", varName});
-        args.push_back({"value", getVariableValue(varName)});
-        // args.push_back({"type", static_cast<double>(static_cast<int>(targetType))});
-        instruction_.push_back({"ASSIGN_" + varName, args});
-        return;
+bool InstructionGenerator::isAssignable(const std::string& varName){
+    if(!hasVariable(varName)){
+        std::cerr<<"Undefined variable: "<< varName<<std::endl;
+        return false;
     }
+    return true;
+}
 
+common::Value InstructionGenerator::storeAssignment(const std::string& varName, VariableInfo& variable, common::Value rightValue){
+    double baseVal = 0.0;
+    //preparation before type convertions; anything else counts as 0
+    rightValue.toNumber(baseVal);
     
+    //type convertions setting
+    switch (variable.type) {
+        case grs_lexer::TokenType::INT:
+            variable.value = common::storeInt(baseVal);
+            lastValue_ = static_cast<double>(baseVal);
+            break;
+        case grs_lexer::TokenType::CHAR:
+            variable.value = std::to_string(common::storeInt(baseVal));
+            lastValue_ = baseVal; 
+            break;
+        case grs_lexer::TokenType::BOOL:
+            variable.value = (baseVal != 0.0);
+            lastValue_ = (baseVal != 0.0) ? 1.0 : 0.0;
+            break;
+        case grs_lexer::TokenType::REAL:
+        default:
+            variable.value = baseVal;
+            lastValue_ = baseVal;
+            break;
+    }
 
-    common::ValueType leftValue     = evaluateExpression(leftExpr);
-    common::ValueType rightValue   = evaluateExpression(rightExpr);
+    emit(Opcode::ASSIGN, &varName, &variable.value, common::NO_LOCATION);
+    return lastValue_;
+}
 
+common::Value InstructionGenerator::applyBinary(grs_lexer::TokenType op, common::Value leftValue, common::Value rightValue){
     double leftVal = 0.0, rightVal = 0.0;
 
     // Left value conversion
-    if (std::holds_alternative<double>(leftValue)) {
-        leftVal = std::get<double>(leftValue);
-    } else if (std::holds_alternative<int>(leftValue)) {
-        leftVal = static_cast<double>(std::get<int>(leftValue));
-    } else if (std::holds_alternative<bool>(leftValue)) {
-        leftVal = std::get<bool>(leftValue) ? 1.0 : 0.0;
-    } else {
+    if (!leftValue.toNumber(leftVal)) {
         std::cerr << "Cannot convert left operand to numeric value" << std::endl;
-        currentValue_ = 0.0;
-        return;
+        return lastValue_ = 0.0;
     }
     
     // Right value conversion
-    if (std::holds_alternative<double>(rightValue)) {
-        rightVal = std::get<double>(rightValue);
-    } else if (std::holds_alternative<int>(rightValue)) {
-        rightVal = static_cast<double>(std::get<int>(rightValue));
-    } else if (std::holds_alternative<bool>(rightValue)) {
-        rightVal = std::get<bool>(rightValue) ? 1.0 : 0.0;
-    } else {
+    if (!rightValue.toNumber(rightVal)) {
         std::cerr << "Cannot convert right operand to numeric value" << std::endl;
-        currentValue_ = 0.0;
-        return;
+        return lastValue_ = 0.0;
     }
 
     // operating as operator
-    switch(node.getOperator()){
+    double result = 0.0;
+    switch(op){
         // Arithmetic operators
         case grs_lexer::TokenType::PLUS:
-            currentValue_ = leftVal + rightVal;
+            result = leftVal + rightVal;
             break;
             
         case grs_lexer::TokenType::MINUS:
-            currentValue_ = leftVal - rightVal;
+            result = leftVal - rightVal;
             break;
             
         case grs_lexer::TokenType::MULTIPLY:
-            currentValue_ = leftVal * rightVal;
+            result = leftVal * rightVal;
             break;
             
         case grs_lexer::TokenType::DIVIDE:
             if(rightVal == 0.0){
                 std::cerr << "Error: Division by zero" << std::endl;
-                currentValue_ = 0.0;
+                result = 0.0;
             } else {
-                currentValue_ = leftVal / rightVal;
+                result = leftVal / rightVal;
             }
             break;
             
         // Comparison operators for IF statement
         case grs_lexer::TokenType::LESS:
-            currentValue_ = (leftVal < rightVal) ? 1.0 : 0.0;
+            result = (leftVal < rightVal) ? 1.0 : 0.0;
             break;
             
         case grs_lexer::TokenType::LESSEQ:
-            currentValue_ = (leftVal <= rightVal) ? 1.0 : 0.0;
+            result = (leftVal <= rightVal) ? 1.0 : 0.0;
             break;
             
         case grs_lexer::TokenType::GREATER:
-            currentValue_ = (leftVal > rightVal) ? 1.0 : 0.0;
+            result = (leftVal > rightVal) ? 1.0 : 0.0;
             break;
             
         case grs_lexer::TokenType::GREATEREQ:
-            currentValue_ = (leftVal >= rightVal) ? 1.0 : 0.0;
+            result = (leftVal >= rightVal) ? 1.0 : 0.0;
             break;
             
         case grs_lexer::TokenType::EQUAL:
-            currentValue_ = (leftVal == rightVal) ? 1.0 : 0.0;
+            result = (leftVal == rightVal) ? 1.0 : 0.0;
             break;
             
         case grs_lexer::TokenType::NOTEQUAL:
-            currentValue_ = (leftVal != rightVal) ? 1.0 : 0.0;
+            result = (leftVal != rightVal) ? 1.0 : 0.0;
             break;
             
         // Logical operators
         case grs_lexer::TokenType::AND:
-            currentValue_ = ((leftVal != 0.0) && (rightVal != 0.0)) ? 1.0 : 0.0;
+            result = ((leftVal != 0.0) && (rightVal != 0.0)) ? 1.0 : 0.0;
             break;
             
         case grs_lexer::TokenType::OR:
-            currentValue_ = ((leftVal != 0.0) || (rightVal != 0.0)) ? 1.0 : 0.0;
+            result = ((leftVal != 0.0) || (rightVal != 0.0)) ? 1.0 : 0.0;
             break;
             
         default:
-            std::cerr << "Unsupported binary operator: " << static_cast<int>(node.getOperator()) << std::endl;
-            currentValue_ = 0.0;
+            std::cerr << "Unsupported binary operator: " << static_cast<int>(op) << std::endl;
+            result = 0.0;
             break;
     }
-
+    return lastValue_ = result;
 }
 
 void InstructionGenerator::visit(grs_ast::LiteraExpression& node){
-    const auto& value = node.getValue();
+    loadLiteral(node.getValue());
+}
 
+bool InstructionGenerator::literalValue(const common::ValueType& value, common::Value& out){
     if(std::holds_alternative<int>(value)){
-        currentValue_ = static_cast<double>(std::get<int>(value)); 
+        out = static_cast<double>(std::get<int>(value)); 
     }
     else if(std::holds_alternative<double>(value)){
-        currentValue_ = std::get<double>(value);
+        out = std::get<double>(value);
     }
     else if(std::holds_alternative<bool>(value)){
-        currentValue_ = std::get<bool>(value) ? 1.0 : 0.0;
+        out = std::get<bool>(value) ? 1.0 : 0.0;
     }
     else if(std::holds_alternative<std::string>(value)){
-        currentValue_ = std::get<std::string>(value);
+        out = common::Value::ofHandle(common::ValueKind::STRING, strings_.intern(std::get<std::string>(value)));
+    }
+    else{
+        return false;
+    }
+    return true;
+}
+
+common::Value InstructionGenerator::loadLiteral(const common::ValueType& value){
+    common::Value loaded;
+    if(literalValue(value, loaded)){
+        lastValue_ = loaded;
     }
+    return lastValue_;
 }
 
 void InstructionGenerator::visit(grs_ast::UnaryExpression& node){
-    common::ValueType value = evaluateExpression(node.getExpression());
+    applyUnary(node.getOperator(), walk(node.getExpression()));
+}
 
-     if(std::holds_alternative<int>(value)){
-        currentValue_ = !std::get<int>(value); 
-    }
-    else if(std::holds_alternative<double>(value)){
-        currentValue_ = !std::get<double>(value);
+common::Value InstructionGenerator::applyUnary(grs_lexer::TokenType op, common::Value value){
+    if(op == grs_lexer::TokenType::MINUS){
+        switch(value.kind()){
+            case common::ValueKind::INT:  lastValue_ = -static_cast<double>(value.getInt()); break;
+            case common::ValueKind::REAL: lastValue_ = -value.getReal(); break;
+            case common::ValueKind::BOOL: lastValue_ = value.getBool() ? -1.0 : 0.0; break;
+            default:                      break;
+        }
+        return lastValue_;
     }
-    else if(std::holds_alternative<bool>(value)){
-        currentValue_ = !std::get<bool>(value);
+
+    switch(value.kind()){
+        case common::ValueKind::INT:  lastValue_ = common::Value::ofBool(!value.getInt()); break;
+        case common::ValueKind::REAL: lastValue_ = common::Value::ofBool(!value.getReal()); break;
+        case common::ValueKind::BOOL: lastValue_ = common::Value::ofBool(!value.getBool()); break;
+        default:                      break;
     }
+    return lastValue_;
 }
 
 
 void InstructionGenerator::visit(grs_ast::VariableDeclaration& node){
-   
-    std::string name = node.getName();
-    grs_lexer::TokenType type = node.getDataType();
-
-    VariableInfo value = {type, 0.0};
-
-    if(double baseVal = 0.0; node.getInitializer()){
+    if(node.getInitializer()){
         common::ValueType initValue = evaluateExpression(node.getInitializer());
+        emitVariableDeclaration(node.getName(), node.getDataType(), &initValue, node.getLocation());
+    } else {
+        emitVariableDeclaration(node.getName(), node.getDataType(), nullptr, node.getLocation());
+    }
+}
+
+void InstructionGenerator::emitVariableDeclaration(const std::string& name, grs_lexer::TokenType type,
+                                                   const common::ValueType* initValue,
+                                                   common::LocationId location){
+    VariableInfo value = {type, 0.0, true};
 
-        if(auto val = std::get_if<int>(&initValue))
+    if(double baseVal = 0.0; initValue){
+        if(auto val = std::get_if<int>(initValue))
             baseVal = static_cast<double>(*val);
-        else if(auto val = std::get_if<double>(&initValue))
+        else if(auto val = std::get_if<double>(initValue))
             baseVal = *val;
 
         switch(type){
             case grs_lexer::TokenType::INT:
-            value.value = static_cast<int>(baseVal);
+            value.value = common::storeInt(baseVal);
             break;
             case grs_lexer::TokenType::CHAR:
             value.value = std::to_string(baseVal);
@@ -285,104 +346,561 @@ void InstructionGenerator::visit(grs_ast::VariableDeclaration& node){
     
 
     declaredVariables_[name] = value;
-    std::vector<std::pair<std::string, common::ValueType>> args; 
-    args.push_back({"type",static_cast<std::string>(grs_lexer::typeToStringMap.at(type))});
-    args.push_back({"value",value.value});
-    instruction_.push_back({"DECL_" + name, args, node.getLineColumn()});
+    emit(Opcode::DECL, &name, &value.value, location, type);
 }
 
 void InstructionGenerator::visit(grs_ast::VariableExpression& node){
-    const std::string& name = node.getName();
+    auto it = declaredVariables_.find(node.getName());
+    loadVariable(node.getName(), it != declaredVariables_.end() ? &it->second : nullptr);
+}
 
-    if(hasVariable(name)){
-        auto varValue = getVariableValue(name);
+common::Value InstructionGenerator::loadVariable(const std::string& name, const VariableInfo* variable){
+    if(variable && variable->declared){
+        const auto& varValue = variable->value;
 
         if (std::holds_alternative<int>(varValue)) {
-            currentValue_ = static_cast<double>(std::get<int>(varValue));
+            lastValue_ = static_cast<double>(std::get<int>(varValue));
         } 
         else if (std::holds_alternative<double>(varValue)) {
-            currentValue_ = std::get<double>(varValue);
+            lastValue_ = std::get<double>(varValue);
         } 
         else if (std::holds_alternative<std::string>(varValue)) {
             std::cerr << "Cannot convert string to double" << "\n";
-            currentValue_ = 0.0;
+            lastValue_ = 0.0;
         }
-        // else if(std::holds_alternative<TypeValue>(varValue)){
-            
-        // }
+        // BOOL and struct variables yield no value of their own
     }
     else{
         std::cerr<<"Undefined variable "<<name<<std::endl;
-            currentValue_= 0.0;
+            lastValue_= 0.0;
     }
-
+    return lastValue_;
 }
 
 
 
 void InstructionGenerator::visit(grs_ast::IfStatement& node){
-    auto conditionValue = evaluateExpression(node.getCondition());
-
-    bool conditionResult = false;
-    if (std::holds_alternative<double>(conditionValue)) {
-        conditionResult = (std::get<double>(conditionValue) != 0.0);
-    } else if (std::holds_alternative<int>(conditionValue)) {
-        conditionResult = (std::get<int>(conditionValue) != 0);
-    } else if (std::holds_alternative<bool>(conditionValue)) {
-        conditionResult = std::get<bool>(conditionValue);
-    }
-  
-    Instruction ifstartInst;
-    ifstartInst.command = "IF_START";
-    ifstartInst.commandLocationInfo = node.getLineColumn();
-    ifstartInst.args.emplace_back("condition", conditionResult);
-    instruction_.push_back(ifstartInst);
+    bool conditionResult = emitIfStart(evaluateExpression(node.getCondition()), node.getLocation());
 
     if(conditionResult && node.getThenBranch()){
-        Instruction thenInst;
-        thenInst.command = "THEN_BLOCK";
-        instruction_.push_back(thenInst);
-        
+        emitBranch(true, node.getLocation());
         node.getThenBranch()->accept(*this);
     }
 
     else if(!conditionResult && node.getElseBranch()){
-        Instruction elseInst;
-        elseInst.command = "ELSE_BLOCK";
-        elseInst.commandLocationInfo = node.getLineColumn();
-        instruction_.push_back(elseInst);
-
+        emitBranch(false, node.getLocation());
         node.getElseBranch()->accept(*this);
     }
 
-    Instruction ifEndInst;
-    ifEndInst.command = "IF_END";
-    instruction_.push_back(ifEndInst);
+    emitIfEnd();
+}
+
+bool InstructionGenerator::emitIfStart(const common::ValueType& conditionValue, common::LocationId location){
+    const bool conditionResult = numberOf(conditionValue) != 0.0;
+    const common::ValueType condition = conditionResult;
+    emit(Opcode::IF_START, nullptr, &condition, location);
+    return conditionResult;
+}
+
+void InstructionGenerator::emitBranch(bool thenBranch, common::LocationId location){
+    if(thenBranch){
+        emit(Opcode::THEN_BLOCK, nullptr, nullptr, common::NO_LOCATION);
+    } else {
+        emit(Opcode::ELSE_BLOCK, nullptr, nullptr, location);
+    }
+}
+
+void InstructionGenerator::emitIfEnd(){
+    emit(Opcode::IF_END, nullptr, nullptr, common::NO_LOCATION);
 }
+
+bool InstructionGenerator::nextTurn(std::uint32_t& turns){
+    if(turns == LOOP_LIMIT){
+        std::cerr << "Loop stopped after " << LOOP_LIMIT << " turns" << std::endl;
+        return false;
+    }
+    ++turns;
+    return true;
+}
+
+// the counter is written on entry and after every turn, as an assignment
+// would; a counter that is not defined skips the loop
+template<typename Body>
+void InstructionGenerator::countedLoop(const std::string& counter, double start, double end, std::int32_t step, Body&& body){
+    if(!isAssignable(counter)){
+        return;
+    }
+    VariableInfo& variable = declaredVariables_[counter];
+    common::CountedLoop loop(start, end, step);
+    storeAssignment(counter, variable, static_cast<double>(loop.counter));
+    if(!loop.inRange()){
+        return;
+    }
+    ++repeating_;
+    std::uint32_t turns = 0;
+    do{
+        if(!nextTurn(turns)){
+            break;
+        }
+        body();
+        if(returning_ || !loop.advance()){
+            break;
+        }
+        storeAssignment(counter, variable, static_cast<double>(loop.counter));
+    } while(loop.inRange());
+    --repeating_;
+}
+
+template<typename Condition, typename Body>
+void InstructionGenerator::conditionLoop(bool repeat, Condition&& condition, Body&& body){
+    ++repeating_;
+    std::uint32_t turns = 0;
+    for(;;){
+        if(!repeat && !condition()){
+            break;
+        }
+        if(!nextTurn(turns)){
+            break;
+        }
+        body();
+        if(returning_ || (repeat && condition())){
+            break;
+        }
+    }
+    --repeating_;
+}
+
+void InstructionGenerator::visit(grs_ast::ForStatement& node){
+    const double start = numberOf(evaluateExpression(node.getStart()));
+    const double end = numberOf(evaluateExpression(node.getEnd()));
+    countedLoop(node.getCounter(), start, end, node.getStep(), [&]{
+        if(node.getBody()) node.getBody()->accept(*this);
+    });
+}
+
+void InstructionGenerator::visit(grs_ast::WhileStatement& node){
+    conditionLoop(false, [&]{ return numberOf(evaluateExpression(node.getCondition())) != 0.0;}, [&]{
+        if(node.getBody()) node.getBody()->accept(*this);
+    });
+}
+
+void InstructionGenerator::visit(grs_ast::RepeatStatement& node){
+    conditionLoop(true, [&]{ return numberOf(evaluateExpression(node.getCondition())) != 0.0;}, [&]{
+        if(node.getBody()) node.getBody()->accept(*this);
+    });
+}
+
+void InstructionGenerator::visit(grs_ast::SwitchStatement& node){
+    if(auto body = node.select(numberOf(evaluateExpression(node.getSelector())))){
+        body->accept(*this);
+    }
+}
+
 void InstructionGenerator::visit(grs_ast::WaitStatement& node){
+    emitWait(node.waitTime_, node.getLocation());
+}
 
-    Instruction instruction;
-    double wtime = node.waitTime_;
-    instruction.command = "WAIT";
-    instruction.commandLocationInfo = node.getLineColumn();
-    instruction.args.emplace_back("duration_time",wtime);
-    instruction_.push_back(instruction);
-    
+void InstructionGenerator::emitWait(double wtime, common::LocationId location){
+    const common::ValueType duration = wtime;
+    emit(Opcode::WAIT, nullptr, &duration, location);
 }
 
+// The first DEF is the module's main program; the others are subroutines
+// and their bodies stay unparsed until something calls them
 void InstructionGenerator::visit(grs_ast::FunctionDeclaration& node){
+    if(entryGenerated_){
+        return;
+    }
+    entryGenerated_ = true;
+    if(auto body = node.getBody()){
+        body->accept(*this);
+    }
+}
 
-    
+bool InstructionGenerator::callable(const std::string& name, bool defined){
+    if(!defined){
+        std::cerr << "Unknown function '" << name << "'" << std::endl;
+        return false;
+    }
+    if(depth_ == callDepthLimit_){
+        std::cerr << "Call depth limit of " << callDepthLimit_ << " reached calling '" << name << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
 
+void InstructionGenerator::hideVariable(const std::string& name){
+    VariableInfo& variable = declaredVariables_[name];
+    savedVariables_.push_back({&variable, variable});
+    variable.declared = false;
 }
 
-common::ValueType InstructionGenerator::evaluateExpression(const std::shared_ptr<grs_ast::Expression>& expr)
-{
-    if(expr){
+template<typename Body>
+common::Value InstructionGenerator::runCall(size_t saved, grs_lexer::TokenType returnType, Body&& body){
+    ++depth_;
+    ++repeating_;
+    body();
+    --repeating_;
+    --depth_;
+    const double result = returning_ ? returnValue_ : 0.0;
+    returning_ = false;
+    while(savedVariables_.size() > saved){
+        SavedVariable& entry = savedVariables_.back();
+        *entry.variable = std::move(entry.value);
+        savedVariables_.pop_back();
+    }
+    return lastValue_ = common::returnValue(returnType, result);
+}
+
+common::Value InstructionGenerator::call(const std::string& name, std::uint32_t count){
+    const size_t first = arguments_.size() - count;
+    auto it = functions_.find(name);
+    if(!callable(name, it != functions_.end())){
+        arguments_.resize(first);
+        return lastValue_ = 0.0;
+    }
+    grs_ast::FunctionDeclaration& function = *it->second;
+    const size_t saved = savedVariables_.size();
+    for(const auto& local : function.getLocals()){
+        hideVariable(local);
+    }
+    const auto& parameters = function.getParameters();
+    for(size_t i = 0; i < parameters.size(); ++i){
+        const common::ValueType value = i < count ? arguments_[first + i] : 0.0;
+        emitVariableDeclaration(parameters[i].name, parameters[i].type, &value, function.getLocation());
+    }
+    arguments_.resize(first);
+    return runCall(saved, function.getReturnType(), [&]{
+        if(auto body = function.getBody()) body->accept(*this);
+    });
+}
+
+void InstructionGenerator::visit(grs_ast::CallExpression& node){
+    for(auto* arg : node.getArgs()){
+        double number = 0.0;
+        walk(arg).toNumber(number);
+        arguments_.push_back(number);
+    }
+    call(node.getName(), static_cast<std::uint32_t>(node.getArgs().size()));
+}
+
+void InstructionGenerator::visit(grs_ast::ReturnStatement& node){
+    returnValue_ = node.getValue() ? numberOf(evaluateExpression(node.getValue())) : 0.0;
+    returning_ = true;
+}
+
+// Builds the callables for an expression; the variables it names get
+// their entry now, so the callables reach them without a lookup
+struct InstructionGenerator::ExpressionCompiler : public grs_ast::ASTVisitorBase{
+    InstructionGenerator& generator;
+    CompiledExpression compiled;
+
+    explicit ExpressionCompiler(InstructionGenerator& owner) : generator{owner} {}
+
+    CompiledExpression compile(grs_ast::Expression* expr){
+        if(!expr){
+            return []{ return common::Value(0.0);};
+        }
         expr->accept(*this);
-        return currentValue_;
+        return std::move(compiled);
     }
-    return 0.0;
+
+    void visit(grs_ast::BinaryExpression& node) override{
+        InstructionGenerator* self = &generator;
+        if(node.getOperator() == grs_lexer::TokenType::ASSIGN){
+            auto varExpr = dynamic_cast<grs_ast::VariableExpression*>(node.getLeft());
+            if(!varExpr){
+                compiled = [self]{
+                    std::cerr<<"assignment left side must be a variable \n";
+                    return self->lastValue_;
+                };
+                return;
+            }
+            VariableInfo* variable = &generator.declaredVariables_[varExpr->getName()];
+            compiled = [self, name = varExpr->getName(), variable, right = compile(node.getRight())]{
+                if(!variable->declared){
+                    std::cerr<<"Undefined variable: "<< name<<std::endl;
+                    return self->lastValue_;
+                }
+                return self->storeAssignment(name, *variable, right());
+            };
+            return;
+        }
+        compiled = [self, op = node.getOperator(), left = compile(node.getLeft()), right = compile(node.getRight())]{
+            const common::Value leftValue = left();
+            return self->applyBinary(op, leftValue, right());
+        };
+    }
+
+    void visit(grs_ast::UnaryExpression& node) override{
+        InstructionGenerator* self = &generator;
+        compiled = [self, op = node.getOperator(), operand = compile(node.getExpression())]{
+            return self->applyUnary(op, operand());
+        };
+    }
+
+    void visit(grs_ast::LiteraExpression& node) override{
+        InstructionGenerator* self = &generator;
+        common::Value value;
+        if(generator.literalValue(node.getValue(), value)){
+            compiled = [self, value]{ return self->lastValue_ = value;};
+        } else {
+            compiled = [self]{ return self->lastValue_;};
+        }
+    }
+
+    void visit(grs_ast::VariableExpression& node) override{
+        InstructionGenerator* self = &generator;
+        const VariableInfo* variable = &generator.declaredVariables_[node.getName()];
+        compiled = [self, name = node.getName(), variable]{ return self->loadVariable(name, variable);};
+    }
+
+    void visit(grs_ast::CallExpression& node) override{
+        InstructionGenerator* self = &generator;
+        std::vector<CompiledExpression> args;
+        for(auto* arg : node.getArgs()){
+            args.push_back(compile(arg));
+        }
+        compiled = [self, name = node.getName(), args = std::move(args)]{
+            for(const auto& arg : args){
+                double number = 0.0;
+                arg().toNumber(number);
+                self->arguments_.push_back(number);
+            }
+            return self->call(name, static_cast<std::uint32_t>(args.size()));
+        };
+    }
+};
+
+common::ValueType InstructionGenerator::evaluateExpression(grs_ast::Expression* expr)
+{
+    if(!expr){
+        return 0.0;
+    }
+    if(repeating_ == 0){
+        return strings_.toValueType(walk(expr));
+    }
+    auto it = compiled_.find(expr);
+    if(it == compiled_.end()){
+        it = compiled_.emplace(expr, ExpressionCompiler(*this).compile(expr)).first;
+    }
+    return strings_.toValueType(it->second());
+}
+
+common::Value InstructionGenerator::walk(grs_ast::Expression* expr){
+    if(!expr){
+        return 0.0;
+    }
+    expr->accept(*this);
+    return lastValue_;
 }
 
+
+// Flat AST walk: same instructions as the visitor, reading the kind tables
+
+InstructionList InstructionGenerator::generateInstructions(const grs_ast::FlatAst& program){
+    program_ = InstructionList{};
+    nameIds_.clear();
+    entryGenerated_ = false;
+    flatFunctions_.clear();
+    depth_ = 0;
+    returning_ = false;
+    arguments_.clear();
+    savedVariables_.clear();
+    if(program.getRoot() != grs_ast::NO_NODE){
+        // the first DEF of a name is the one called, as in functionTable
+        const auto& root = program.getBlock(program.getRoot());
+        for(std::uint32_t i = 0; i < root.childCount; ++i){
+            const grs_ast::NodeId child = program.getChild(root, i);
+            if(program.getKind(child) == grs_ast::ASTNodeType::FunctionDeclaration){
+                flatFunctions_.try_emplace(program.getFunction(child).name, child);
+            }
+        }
+        generate(program, program.getRoot());
+    }
+    return std::move(program_);
 }
+
+void InstructionGenerator::generate(const grs_ast::FlatAst& flat, grs_ast::NodeId node){
+    using Kind = grs_ast::ASTNodeType;
+
+    switch(flat.getKind(node)){
+        case Kind::Program:{
+            const auto& block = flat.getBlock(node);
+            for(std::uint32_t i = 0; i < block.childCount && !returning_; ++i){
+                generate(flat, flat.getChild(block, i));
+            }
+            break;
+        }
+        case Kind::Command:{
+            const auto& motion = flat.getMotion(node);
+            emitMotion(flat.getName(motion.command), flat.getName(motion.name), flat.getLocation(node));
+            break;
+        }
+        case Kind::PositionDeclaration:
+            executeDeclaration<common::Position>(flat, node, grs_lexer::TokenType::POS, Opcode::POSITION_DECL);
+            break;
+        case Kind::FrameDeclaration:
+            executeDeclaration<common::Frame>(flat, node, grs_lexer::TokenType::FRAME, Opcode::FRAME_DECL);
+            break;
+        case Kind::AxisDeclaration:
+            executeDeclaration<common::Axis>(flat, node, grs_lexer::TokenType::AXIS, Opcode::AXIS_DECL);
+            break;
+        case Kind::ExecutePosAndAxisExpression:{
+            const auto& assign = flat.getMemberAssign(node);
+            auto val = std::get<double>(evaluate(flat, assign.value));
+            assignPosAndAxisExpression(flat.getName(assign.name), flat.getName(assign.member), val);
+            break;
+        }
+        case Kind::VariableDeclaration:{
+            const auto& decl = flat.getVariableDecl(node);
+            if(decl.initializer != grs_ast::NO_NODE){
+                common::ValueType initValue = evaluate(flat, decl.initializer);
+                emitVariableDeclaration(flat.getName(decl.name), decl.dataType, &initValue, flat.getLocation(node));
+            } else {
+                emitVariableDeclaration(flat.getName(decl.name), decl.dataType, nullptr, flat.getLocation(node));
+            }
+            break;
+        }
+        case Kind::IfStatement:{
+            const auto& ifNode = flat.getIf(node);
+            const auto location = flat.getLocation(node);
+            bool conditionResult = emitIfStart(evaluate(flat, ifNode.condition), location);
+            if(conditionResult && ifNode.thenBranch != grs_ast::NO_NODE){
+                emitBranch(true, location);
+                generate(flat, ifNode.thenBranch);
+            }
+            else if(!conditionResult && ifNode.elseBranch != grs_ast::NO_NODE){
+                emitBranch(false, location);
+                generate(flat, ifNode.elseBranch);
+            }
+            emitIfEnd();
+            break;
+        }
+        case Kind::ForStatement:{
+            const auto& loop = flat.getFor(node);
+            const double start = numberOf(evaluate(flat, loop.start));
+            const double end = numberOf(evaluate(flat, loop.end));
+            countedLoop(flat.getName(loop.counter), start, end, loop.step, [&]{
+                if(loop.body != grs_ast::NO_NODE) generate(flat, loop.body);
+            });
+            break;
+        }
+        case Kind::WhileStatement:
+        case Kind::RepeatStatement:{
+            const auto& loop = flat.getLoop(node);
+            conditionLoop(flat.getKind(node) == Kind::RepeatStatement,
+                          [&]{ return numberOf(evaluate(flat, loop.condition)) != 0.0;}, [&]{
+                if(loop.body != grs_ast::NO_NODE) generate(flat, loop.body);
+            });
+            break;
+        }
+        case Kind::SwitchStatement:{
+            const auto& switchNode = flat.getSwitch(node);
+            const grs_ast::NodeId body = flat.select(switchNode, numberOf(evaluate(flat, switchNode.selector)));
+            if(body != grs_ast::NO_NODE){
+                generate(flat, body);
+            }
+            break;
+        }
+        case Kind::WaitStatement:
+            emitWait(flat.getWaitTime(node), flat.getLocation(node));
+            break;
+        case Kind::FunctionDeclaration:{
+            const auto& function = flat.getFunction(node);
+            if(!entryGenerated_){
+                entryGenerated_ = true;
+                if(function.body != grs_ast::NO_NODE){
+                    generate(flat, function.body);
+                }
+            }
+            break;
+        }
+        case Kind::ReturnStatement:{
+            const grs_ast::NodeId value = flat.getReturnValue(node);
+            returnValue_ = value != grs_ast::NO_NODE ? numberOf(evaluate(flat, value)) : 0.0;
+            returning_ = true;
+            break;
+        }
+        default:
+            // expression statements
+            evaluate(flat, node);
+            break;
+    }
+}
+
+common::Value InstructionGenerator::call(const grs_ast::FlatAst& flat, const grs_ast::FlatAst::Call& node){
+    for(std::uint32_t i = 0; i < node.argCount; ++i){
+        double number = 0.0;
+        evaluateNode(flat, flat.getArg(node, i)).toNumber(number);
+        arguments_.push_back(number);
+    }
+    const std::string& name = flat.getName(node.name);
+    const size_t first = arguments_.size() - node.argCount;
+    auto it = flatFunctions_.find(node.name);
+    if(!callable(name, it != flatFunctions_.end())){
+        arguments_.resize(first);
+        return lastValue_ = 0.0;
+    }
+    const auto& function = flat.getFunction(it->second);
+    const size_t saved = savedVariables_.size();
+    for(std::uint32_t i = 0; i < function.localCount; ++i){
+        hideVariable(flat.getName(flat.getLocal(function.firstLocal + i)));
+    }
+    for(std::uint32_t i = 0; i < function.paramCount; ++i){
+        const auto& parameter = flat.getParameter(function.firstParam + i);
+        const common::ValueType value = i < node.argCount ? arguments_[first + i] : 0.0;
+        emitVariableDeclaration(flat.getName(parameter.name), parameter.type, &value, flat.getLocation(it->second));
+    }
+    arguments_.resize(first);
+    return runCall(saved, function.returnType, [&]{
+        if(function.body != grs_ast::NO_NODE) generate(flat, function.body);
+    });
+}
+
+common::ValueType InstructionGenerator::evaluate(const grs_ast::FlatAst& flat, grs_ast::NodeId node){
+    return strings_.toValueType(evaluateNode(flat, node));
+}
+
+common::Value InstructionGenerator::evaluateNode(const grs_ast::FlatAst& flat, grs_ast::NodeId node){
+    using Kind = grs_ast::ASTNodeType;
+
+    if(node == grs_ast::NO_NODE){
+        return 0.0;
+    }
+
+    switch(flat.getKind(node)){
+        case Kind::BinaryExpression:{
+            const auto& binary = flat.getBinary(node);
+            if(binary.op == grs_lexer::TokenType::ASSIGN){
+                if(binary.left == grs_ast::NO_NODE || flat.getKind(binary.left) != Kind::VariableExpression){
+                    std::cerr<<"assignment left side must be a variable \n";
+                    break;
+                }
+                const std::string& varName = flat.getName(flat.getVariable(binary.left).name);
+                if(isAssignable(varName)){
+                    return storeAssignment(varName, declaredVariables_[varName], evaluateNode(flat, binary.right));
+                }
+                break;
+            }
+            const common::Value leftValue = evaluateNode(flat, binary.left);
+            return applyBinary(binary.op, leftValue, evaluateNode(flat, binary.right));
+        }
+        case Kind::UnaryExpression:
+            return applyUnary(flat.getUnary(node).op, evaluateNode(flat, flat.getUnary(node).operand));
+        case Kind::LiteralExpression:
+            return loadLiteral(flat.getLiteral(node));
+        case Kind::VariableExpression:{
+            const std::string& name = flat.getName(flat.getVariable(node).name);
+            auto it = declaredVariables_.find(name);
+            return loadVariable(name, it != declaredVariables_.end() ? &it->second : nullptr);
+        }
+        case Kind::CallExpression:
+            return call(flat, flat.getCall(node));
+        default:
+            break;
+    }
+    return lastValue_;
+}
+
+}
\ No newline at end of file
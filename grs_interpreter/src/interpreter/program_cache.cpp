@@ -0,0 +1,237 @@
+#include "interpreter/program_cache.hpp"
+#include "lexer/source_buffer.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+namespace grs_interpreter{
+
+namespace {
+
+constexpr char MAGIC[4] = {'G', 'R', 'S', 'C'};
+
+enum ValueKind : std::uint8_t{
+    KIND_INT,
+    KIND_DOUBLE,
+    KIND_BOOL,
+    KIND_STRING,
+    KIND_POSITION,
+    KIND_FRAME,
+    KIND_AXIS
+};
+
+class Writer{
+    public:
+    template<class T>
+    void put(const T& value){
+        static_assert(std::is_trivially_copyable_v<T>);
+        bytes_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    void putString(std::string_view text){
+        put(static_cast<std::uint32_t>(text.size()));
+        bytes_.append(text.data(), text.size());
+    }
+    const std::string& bytes()const{ return bytes_;}
+
+    private:
+    std::string bytes_;
+};
+
+// Bounds-checked cursor over the mapped file; every read fails softly
+class Reader{
+    public:
+    explicit Reader(std::string_view bytes) : bytes_{bytes} {}
+
+    template<class T>
+    bool get(T& value){
+        static_assert(std::is_trivially_copyable_v<T>);
+        if(bytes_.size() - offset_ < sizeof(T)){
+            return false;
+        }
+        std::memcpy(&value, bytes_.data() + offset_, sizeof(T));
+        offset_ += sizeof(T);
+        return true;
+    }
+    bool getString(std::string& text){
+        std::uint32_t length = 0;
+        if(!get(length) || bytes_.size() - offset_ < length){
+            return false;
+        }
+        text.assign(bytes_.data() + offset_, length);
+        offset_ += length;
+        return true;
+    }
+    bool atEnd()const{ return offset_ == bytes_.size();}
+
+    private:
+    std::string_view bytes_;
+    size_t offset_ = 0;
+};
+
+void putValue(Writer& out, const common::ValueType& value){
+    std::visit([&out](const auto& v){
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, int>){ out.put(KIND_INT); out.put(v);}
+        else if constexpr (std::is_same_v<T, double>){ out.put(KIND_DOUBLE); out.put(v);}
+        else if constexpr (std::is_same_v<T, bool>){ out.put(KIND_BOOL); out.put(static_cast<std::uint8_t>(v));}
+        else if constexpr (std::is_same_v<T, std::string>){ out.put(KIND_STRING); out.putString(v);}
+        else if constexpr (std::is_same_v<T, common::Position>){ out.put(KIND_POSITION); out.put(v);}
+        else if constexpr (std::is_same_v<T, common::Frame>){ out.put(KIND_FRAME); out.put(v);}
+        else { out.put(KIND_AXIS); out.put(v);}
+    }, value);
+}
+
+template<class T>
+bool getAs(Reader& in, common::ValueType& value){
+    T v;
+    if(!in.get(v)){
+        return false;
+    }
+    value = v;
+    return true;
+}
+
+bool getValue(Reader& in, common::ValueType& value){
+    std::uint8_t kind = 0;
+    if(!in.get(kind)){
+        return false;
+    }
+    switch(kind){
+        case KIND_INT:      return getAs<int>(in, value);
+        case KIND_DOUBLE:   return getAs<double>(in, value);
+        case KIND_BOOL:{
+            std::uint8_t flag = 0;
+            if(!in.get(flag)) return false;
+            value = flag != 0;
+            return true;
+        }
+        case KIND_STRING:{
+            std::string text;
+            if(!in.getString(text)) return false;
+            value = std::move(text);
+            return true;
+        }
+        case KIND_POSITION: return getAs<common::Position>(in, value);
+        case KIND_FRAME:    return getAs<common::Frame>(in, value);
+        case KIND_AXIS:     return getAs<common::Axis>(in, value);
+        default:            return false;
+    }
+}
+
+}
+
+ProgramCache::ProgramCache(std::string path) : path_{std::move(path)} {}
+
+std::string ProgramCache::pathFor(const std::string& sourcePath){
+    return std::filesystem::path(sourcePath).replace_extension(".grsc").string();
+}
+
+// 64-bit FNV-1a
+std::uint64_t ProgramCache::hashSource(std::string_view source){
+    std::uint64_t hash = 14695981039346656037ull;
+    for(unsigned char c : source){
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::optional<InstructionList> ProgramCache::load(std::string_view source)const{
+    grs_lexer::SourceBuffer file;
+    try{
+        file = grs_lexer::SourceBuffer::fromFile(path_);
+    } catch(const std::exception&){
+        return std::nullopt;
+    }
+    Reader in(file.view());
+
+    char magic[4];
+    std::uint32_t formatVersion = 0;
+    std::uint64_t sourceHash = 0, sourceSize = 0;
+    std::string version;
+    if(!in.get(magic) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+       !in.get(formatVersion) || formatVersion != FORMAT_VERSION ||
+       !in.get(sourceHash) || !in.get(sourceSize) || !in.getString(version)){
+        return std::nullopt;
+    }
+    if(sourceSize != source.size() || version != GRS_INTERPRETER_VERSION || sourceHash != hashSource(source)){
+        return std::nullopt;
+    }
+
+    InstructionList instructions;
+    std::uint32_t count = 0;
+    if(!in.get(count)){
+        return std::nullopt;
+    }
+    instructions.names.resize(count);
+    for(auto& name : instructions.names){
+        if(!in.getString(name)){
+            return std::nullopt;
+        }
+    }
+    if(!in.get(count)){
+        return std::nullopt;
+    }
+    instructions.constants.resize(count);
+    for(auto& value : instructions.constants){
+        if(!getValue(in, value)){
+            return std::nullopt;
+        }
+    }
+    if(!in.get(count)){
+        return std::nullopt;
+    }
+    instructions.code.resize(count);
+    for(auto& instruction : instructions.code){
+        if(!in.get(instruction) || instruction.op > Opcode::IF_END ||
+           (instruction.name != NO_INDEX && instruction.name >= instructions.names.size()) ||
+           (instruction.value != NO_INDEX && instruction.value >= instructions.constants.size())){
+            return std::nullopt;
+        }
+    }
+    if(!in.atEnd()){
+        return std::nullopt;
+    }
+    return instructions;
+}
+
+bool ProgramCache::store(std::string_view source, const InstructionList& instructions)const{
+    Writer out;
+    out.put(MAGIC);
+    out.put(FORMAT_VERSION);
+    out.put(hashSource(source));
+    out.put(static_cast<std::uint64_t>(source.size()));
+    out.putString(GRS_INTERPRETER_VERSION);
+
+    out.put(static_cast<std::uint32_t>(instructions.names.size()));
+    for(const auto& name : instructions.names){
+        out.putString(name);
+    }
+    out.put(static_cast<std::uint32_t>(instructions.constants.size()));
+    for(const auto& value : instructions.constants){
+        putValue(out, value);
+    }
+    out.put(static_cast<std::uint32_t>(instructions.code.size()));
+    for(const auto& instruction : instructions.code){
+        out.put(instruction);
+    }
+
+    // write aside and rename, so a reader never maps a half-written file
+    const std::string temporary = path_ + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if(!file.write(out.bytes().data(), static_cast<std::streamsize>(out.bytes().size()))){
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path_, error);
+    if(error){
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+}
@@ -1,187 +1,412 @@
 #include "../include/lexer/lexer.hpp"
+#include "../include/lexer/scan_kernels.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <limits>
+#include <thread>
 namespace grs_lexer {
 
     Lexer::Lexer(){
-        initTokenPatterns();
         initKeywords();
     }
 
 
+    void Lexer::addKeyword(std::string_view word, TokenType type) {
+        SymbolId id = symbols_.intern(word);
+        if (keywordTypes_.size() <= id) {
+            keywordTypes_.resize(id + 1, TokenType::IDENTIFIER);
+        }
+        keywordTypes_[id] = type;
+    }
+
     void Lexer::initKeywords() {
-        keywords_["DEF"] = TokenType::DEF;
-        keywords_["END"] = TokenType::END;   
-        keywords_["DECL"] = TokenType::DECL;
-        keywords_["INT"] = TokenType::INT;
-        keywords_["REAL"] = TokenType::REAL;
-        keywords_["BOOL"] = TokenType::BOOL;
-        keywords_["CHAR"] = TokenType::CHAR;
-        keywords_["IF"] = TokenType::IF;
-        keywords_["THEN"] = TokenType::THEN;
-        keywords_["ELSE"] = TokenType::ELSE;
-        keywords_["ENDIF"] = TokenType::ENDIF;
-        keywords_["FOR"] = TokenType::FOR;
-        keywords_["TO"] = TokenType::TO;
-        keywords_["STEP"] = TokenType::STEP;
-        keywords_["ENDFOR"] = TokenType::ENDFOR;
-        keywords_["WHILE"] = TokenType::WHILE;
-        keywords_["ENDWHILE"] = TokenType::ENDWHILE;
-        keywords_["REPEAT"] = TokenType::REPEAT;
-        keywords_["UNTIL"] = TokenType::UNTIL;
-        keywords_["SWITCH"] = TokenType::SWITCH;
-        keywords_["CASE"] = TokenType::CASE;
-        keywords_["DEFAULT"] = TokenType::DEFAULT;
-        keywords_["ENDSWITCH"] = TokenType::ENDSWITCH;
-        keywords_["GOTO"] = TokenType::GOTO;
-        keywords_["HALT"] = TokenType::HALT;
-        keywords_["RETURN"] = TokenType::RETURN;
+        addKeyword("DEF", TokenType::DEF);
+        addKeyword("END", TokenType::END);   
+        addKeyword("DECL", TokenType::DECL);
+        addKeyword("INT", TokenType::INT);
+        addKeyword("REAL", TokenType::REAL);
+        addKeyword("BOOL", TokenType::BOOL);
+        addKeyword("CHAR", TokenType::CHAR);
+        addKeyword("IF", TokenType::IF);
+        addKeyword("THEN", TokenType::THEN);
+        addKeyword("ELSE", TokenType::ELSE);
+        addKeyword("ENDIF", TokenType::ENDIF);
+        addKeyword("FOR", TokenType::FOR);
+        addKeyword("TO", TokenType::TO);
+        addKeyword("STEP", TokenType::STEP);
+        addKeyword("ENDFOR", TokenType::ENDFOR);
+        addKeyword("WHILE", TokenType::WHILE);
+        addKeyword("ENDWHILE", TokenType::ENDWHILE);
+        addKeyword("REPEAT", TokenType::REPEAT);
+        addKeyword("UNTIL", TokenType::UNTIL);
+        addKeyword("SWITCH", TokenType::SWITCH);
+        addKeyword("CASE", TokenType::CASE);
+        addKeyword("DEFAULT", TokenType::DEFAULT);
+        addKeyword("ENDSWITCH", TokenType::ENDSWITCH);
+        addKeyword("GOTO", TokenType::GOTO);
+        addKeyword("HALT", TokenType::HALT);
+        addKeyword("RETURN", TokenType::RETURN);
     
         // Motion commands
-        keywords_["PTP"] = TokenType::PTP;
-        keywords_["LIN"] = TokenType::LIN;
-        keywords_["CIRC"] = TokenType::CIRC;
-        keywords_["SPLINE"] = TokenType::SPLINE;
+        addKeyword("PTP", TokenType::PTP);
+        addKeyword("LIN", TokenType::LIN);
+        addKeyword("CIRC", TokenType::CIRC);
+        addKeyword("SPLINE", TokenType::SPLINE);
      
-        keywords_["PTP_REL"] = TokenType::PTP_REL;
-        keywords_["LIN_REL"] = TokenType::LIN_REL;
-        keywords_["CIRC_REL"] = TokenType::CIRC_REL;
-        keywords_["SPLINE_REL"] = TokenType::SPLINE_REL;
+        addKeyword("PTP_REL", TokenType::PTP_REL);
+        addKeyword("LIN_REL", TokenType::LIN_REL);
+        addKeyword("CIRC_REL", TokenType::CIRC_REL);
+        addKeyword("SPLINE_REL", TokenType::SPLINE_REL);
     
         // System functions
-        keywords_["WAIT"] = TokenType::WAIT;
-        keywords_["DELAY"] = TokenType::DELAY;
+        addKeyword("WAIT", TokenType::WAIT);
+        addKeyword("DELAY", TokenType::DELAY);
     
         // Data types
-        keywords_["FRAME"] = TokenType::FRAME;
-        keywords_["AXIS"] = TokenType::AXIS;
-        keywords_["POS"] = TokenType::POS;
+        addKeyword("FRAME", TokenType::FRAME);
+        addKeyword("AXIS", TokenType::AXIS);
+        addKeyword("POS", TokenType::POS);
     
         // Boolean and constant literals
-        keywords_["TRUE"] = TokenType::GTRUE;
-        keywords_["FALSE"] = TokenType::GFALSE;
-        keywords_["PI"]    = TokenType::PI;
+        addKeyword("TRUE", TokenType::GTRUE);
+        addKeyword("FALSE", TokenType::GFALSE);
+        addKeyword("PI",    TokenType::PI);
+
+        // Logical operators are whole words, so they share the identifier path
+        addKeyword("AND", TokenType::AND);
+        addKeyword("OR",  TokenType::OR);
+        addKeyword("NOT", TokenType::NOT);
     }
     
-    void Lexer::initTokenPatterns() {
-        patterns_.push_back({std::regex(R"(\$IN\[[0-9]+\])"), TokenType::GIN});
-        patterns_.push_back({std::regex(R"(\$OUT\[[0-9]+\])"), TokenType::GOUT});
-        patterns_.push_back({std::regex(R"(:=|:)"), TokenType::ASSIGN});
-        patterns_.push_back({std::regex(R"(=)"), TokenType::EQUAL});
-        patterns_.push_back({std::regex(R"(<>)"), TokenType::NOTEQUAL});
-        patterns_.push_back({std::regex(R"(<=)"), TokenType::LESSEQ});
-        patterns_.push_back({std::regex(R"(>=)"), TokenType::GREATEREQ});
-        patterns_.push_back({std::regex(R"(\+)"), TokenType::PLUS});
-        patterns_.push_back({std::regex(R"(->)"), TokenType::ARROW});
-        patterns_.push_back({std::regex(R"(-)"), TokenType::MINUS});
-        patterns_.push_back({std::regex(R"(\*)"), TokenType::MULTIPLY});
-        patterns_.push_back({std::regex(R"(/)"), TokenType::DIVIDE});
-        patterns_.push_back({std::regex(R"(<)"), TokenType::LESS});
-        patterns_.push_back({std::regex(R"(>)"), TokenType::GREATER});
-        patterns_.push_back({std::regex(R"(\bAND\b)"), TokenType::AND});
-        patterns_.push_back({std::regex(R"(\bOR\b)"), TokenType::OR});
-        patterns_.push_back({std::regex(R"(\bNOT\b)"), TokenType::NOT});
-        // float before int
-        patterns_.push_back({std::regex(R"([0-9]+\.[0-9]+([eE][+-]?[0-9]+)?)"), TokenType::FLOAT});
-        patterns_.push_back({std::regex(R"([0-9]+)"), TokenType::INTEGER});
-        patterns_.push_back({std::regex(R"("([^"\\]|\\.)*")"), TokenType::STRING});
-
-        patterns_.push_back({std::regex(R"(&)"), TokenType::AMPERSAND});
-        patterns_.push_back({std::regex(R"(\()"), TokenType::LPAREN});
-        patterns_.push_back({std::regex(R"(\))"), TokenType::RPAREN});
-        patterns_.push_back({std::regex(R"(\{)"), TokenType::LBRACE});
-        patterns_.push_back({std::regex(R"(\})"), TokenType::RBRACE});
-        patterns_.push_back({std::regex(R"(,)"), TokenType::COMMA});
-        patterns_.push_back({std::regex(R"(;)"), TokenType::SEMICOLON});
-        patterns_.push_back({std::regex(R"(')"), TokenType::SINGLEQUOTE});
-        patterns_.push_back({std::regex(R"(\r\n|\n|\r)"), TokenType::ENDOFLINE});
-        
-        patterns_.push_back({std::regex(R"([A-Za-z_][A-Za-z0-9_]*)"), TokenType::IDENTIFIER});
+    namespace {
+
+    // Character classes driving the scanner's start state
+    enum CharClass : unsigned char {
+        CC_OTHER,
+        CC_SPACE,
+        CC_DIGIT,
+        CC_IDENT,   // [A-Za-z_]
+    };
+
+    constexpr std::array<unsigned char, 256> makeCharClassTable() {
+        std::array<unsigned char, 256> table{};
+        for (int c = '0'; c <= '9'; ++c) table[c] = CC_DIGIT;
+        for (int c = 'A'; c <= 'Z'; ++c) table[c] = CC_IDENT;
+        for (int c = 'a'; c <= 'z'; ++c) table[c] = CC_IDENT;
+        table['_'] = CC_IDENT;
+        // same set as isspace() in the "C" locale
+        table[' '] = table['\t'] = table['\n'] = table['\v'] = table['\f'] = table['\r'] = CC_SPACE;
+        return table;
     }
 
-    std::vector<Token> Lexer::tokenize(const std::string& code) {
-        std::vector<Token> tokens;
-        std::istringstream stream(code);
-        std::string line;
-        int lineNumber = 1;
-        
-        std::vector<std::pair<TokenType, std::regex>> compiled_patterns;
-        for (const auto& pattern : patterns_) {
-            compiled_patterns.emplace_back(pattern.type, pattern.pattern);
+    constexpr auto charClass = makeCharClassTable();
+
+    inline unsigned char classOf(char c) {
+        return charClass[static_cast<unsigned char>(c)];
+    }
+
+    inline bool isDigit(char c) { return classOf(c) == CC_DIGIT; }
+    inline bool isSpace(char c) { return classOf(c) == CC_SPACE; }
+    inline bool isIdentChar(char c) {
+        auto cc = classOf(c);
+        return cc == CC_IDENT || cc == CC_DIGIT;
+    }
+
+    size_t scanDigits(std::string_view line, size_t pos) {
+        size_t end = pos;
+        while (end < line.size() && isDigit(line[end])) end++;
+        return end - pos;
+    }
+
+    // [0-9]+ or [0-9]+\.[0-9]+([eE][+-]?[0-9]+)?
+    size_t scanNumber(std::string_view line, size_t pos, TokenType& type) {
+        size_t end = pos + scanDigits(line, pos);
+        type = TokenType::INTEGER;
+
+        if (end + 1 < line.size() && line[end] == '.' && isDigit(line[end + 1])) {
+            type = TokenType::FLOAT;
+            end += 1 + scanDigits(line, end + 1);
+
+            if (end < line.size() && (line[end] == 'e' || line[end] == 'E')) {
+                size_t exp = end + 1;
+                if (exp < line.size() && (line[exp] == '+' || line[exp] == '-')) exp++;
+                size_t expDigits = scanDigits(line, exp);
+                if (expDigits > 0) end = exp + expDigits;
+            }
         }
-        
-        while (std::getline(stream, line)) {
-            int columnNumber = 1;
-            size_t pos = 0;
-            const size_t line_length = line.size();
-            
-            if (line.empty()) {
-                tokens.emplace_back(TokenType::ENDOFLINE, "\n", lineNumber, columnNumber);
-                lineNumber++;
+        return end - pos;
+    }
+
+    // Literal values are decoded here so the parser never re-reads the text.
+    // Out-of-range literals saturate (INTEGER) or become NaN (FLOAT) and are
+    // reported by the parser.
+    std::int64_t decodeInteger(std::string_view text) {
+        std::int64_t value = 0;
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (result.ec != std::errc()) {
+            return std::numeric_limits<std::int64_t>::max();
+        }
+        return value;
+    }
+
+    double decodeReal(std::string_view text) {
+        double value = 0.0;
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (result.ec != std::errc()) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        return value;
+    }
+
+    // "([^"\\]|\\.)*" ; returns 0 when the literal is not closed on this line
+    size_t scanString(std::string_view line, size_t pos) {
+        size_t end = pos + 1;
+        while (end < line.size()) {
+            char c = line[end];
+            if (c == '"') return end + 1 - pos;
+            if (c == '\\') {
+                if (end + 1 >= line.size() || line[end + 1] == '\r') return 0;
+                end += 2;
                 continue;
             }
-            
-            while (pos < line_length) {
-                // Skip whitespace 
-                while (pos < line_length && isspace(line[pos])) {
-                    columnNumber++;
-                    pos++;
-                }
-                if (pos >= line_length) break;
-                
-                bool found = false;
-                std::string_view remaining(line.data() + pos, line_length - pos);
-                
-                // Check patterns in order of priority
-                for (const auto& [type, regex] : compiled_patterns) {
-                    std::cmatch match;
-                    const char* start = line.c_str() + pos;
-                    
-                    if (std::regex_search(start, start + remaining.length(), 
-                                         match, regex, 
-                                         std::regex_constants::match_continuous)) {
-                        std::string value = match.str();
-                        TokenType actual_type = type;
-                        
-                        if (type == TokenType::IDENTIFIER) {
-                            auto it = keywords_.find(value);
-                            if (it != keywords_.end()) {
-                                actual_type = it->second;
-                            }
-                        }
-                        
-                        tokens.emplace_back(actual_type, value, lineNumber, columnNumber);
-                        pos += match.length();
-                        columnNumber += match.length();
-                        found = true;
-
-                        // If SEMICOLON IS FOUND SKIP THE REST OF THE LINE
-                        if (actual_type == TokenType::SEMICOLON) {
-                            pos = line_length; // Move to the end of the line
-                        }
-                        break;
-                    }
-                }
-                
-                if (!found) {
-                    size_t invalid_length = 1;
-                    while (pos + invalid_length < line_length && 
-                           !isspace(line[pos + invalid_length])) {
-                        invalid_length++;
+            end++;
+        }
+        return 0;
+    }
+
+    // $IN[n] / $OUT[n] ; returns 0 when the text is not a well-formed port
+    size_t scanIoPort(std::string_view line, size_t pos, TokenType& type) {
+        std::string_view rest = line.substr(pos + 1);
+        size_t prefix = 0;
+        if (rest.substr(0, 3) == "IN[") {
+            type = TokenType::GIN;
+            prefix = 3;
+        } else if (rest.substr(0, 4) == "OUT[") {
+            type = TokenType::GOUT;
+            prefix = 4;
+        } else {
+            return 0;
+        }
+
+        size_t digits = scanDigits(rest, prefix);
+        if (digits == 0 || prefix + digits >= rest.size() || rest[prefix + digits] != ']') {
+            return 0;
+        }
+        return 1 + prefix + digits + 1;
+    }
+
+    } // namespace
+
+    TokenType Lexer::classifyWord(std::string_view word, SymbolId& symbol) {
+        symbol = symbols_.intern(word);
+        return symbol < keywordTypes_.size() ? keywordTypes_[symbol] : TokenType::IDENTIFIER;
+    }
+
+    void Lexer::scanLine(std::string_view line, int lineNumber, std::vector<Token>& tokens) {
+        const size_t line_length = line.size();
+        size_t pos = 0;
+        int columnNumber = 1;
+
+        if (line.empty()) {
+            tokens.emplace_back(TokenType::ENDOFLINE, "\n", lineNumber, columnNumber);
+            return;
+        }
+
+        while (pos < line_length) {
+            // Skip whitespace
+            size_t blanks = simd::skipBlanks(line.data() + pos, line_length - pos);
+            pos += blanks;
+            columnNumber += static_cast<int>(blanks);
+            if (pos >= line_length) break;
+
+            const char c = line[pos];
+            const char next = pos + 1 < line_length ? line[pos + 1] : '\0';
+            TokenType type = TokenType::INVALID;
+            SymbolId symbol = NO_SYMBOL;
+            size_t length = 0;
+
+            switch (classOf(c)) {
+                case CC_DIGIT:
+                    length = scanNumber(line, pos, type);
+                    break;
+
+                case CC_IDENT:
+                    length = 1;
+                    while (pos + length < line_length && isIdentChar(line[pos + length])) length++;
+                    type = classifyWord(line.substr(pos, length), symbol);
+                    break;
+
+                default:
+                    switch (c) {
+                        case '$':  length = scanIoPort(line, pos, type); break;
+                        case '"':  length = scanString(line, pos); type = TokenType::STRING; break;
+                        case ':':  length = next == '=' ? 2 : 1; type = TokenType::ASSIGN; break;
+                        case '=':  length = 1; type = TokenType::EQUAL; break;
+                        case '<':
+                            if (next == '>')      { length = 2; type = TokenType::NOTEQUAL; }
+                            else if (next == '=') { length = 2; type = TokenType::LESSEQ; }
+                            else                  { length = 1; type = TokenType::LESS; }
+                            break;
+                        case '>':
+                            if (next == '=') { length = 2; type = TokenType::GREATEREQ; }
+                            else             { length = 1; type = TokenType::GREATER; }
+                            break;
+                        case '-':
+                            if (next == '>') { length = 2; type = TokenType::ARROW; }
+                            else             { length = 1; type = TokenType::MINUS; }
+                            break;
+                        case '+':  length = 1; type = TokenType::PLUS; break;
+                        case '*':  length = 1; type = TokenType::MULTIPLY; break;
+                        case '/':  length = 1; type = TokenType::DIVIDE; break;
+                        case '&':  length = 1; type = TokenType::AMPERSAND; break;
+                        case '(':  length = 1; type = TokenType::LPAREN; break;
+                        case ')':  length = 1; type = TokenType::RPAREN; break;
+                        case '{':  length = 1; type = TokenType::LBRACE; break;
+                        case '}':  length = 1; type = TokenType::RBRACE; break;
+                        case ',':  length = 1; type = TokenType::COMMA; break;
+                        case ';':  length = 1; type = TokenType::SEMICOLON; break;
+                        case '\'': length = 1; type = TokenType::SINGLEQUOTE; break;
+                        default: break;
                     }
-                    
-                    tokens.emplace_back(TokenType::INVALID, 
-                                      line.substr(pos, invalid_length), 
-                                      lineNumber, columnNumber);
-                    pos += invalid_length;
-                    columnNumber += invalid_length;
+                    break;
+            }
+
+            if (length == 0) {
+                // No state accepted: swallow up to the next blank as one INVALID token
+                length = 1;
+                while (pos + length < line_length && !isSpace(line[pos + length])) {
+                    length++;
                 }
+                type = TokenType::INVALID;
             }
-            
-            if (!line.empty()) {
-                tokens.emplace_back(TokenType::ENDOFLINE, "\n", lineNumber, columnNumber);
+
+            std::string_view text = line.substr(pos, length);
+            if (type == TokenType::INTEGER) {
+                tokens.emplace_back(type, text, lineNumber, columnNumber, decodeInteger(text));
+            } else if (type == TokenType::FLOAT) {
+                tokens.emplace_back(type, text, lineNumber, columnNumber, decodeReal(text));
+            } else {
+                tokens.emplace_back(type, text, lineNumber, columnNumber, symbol);
             }
+            pos += length;
+            columnNumber += length;
+
+            // If SEMICOLON IS FOUND SKIP THE REST OF THE LINE
+            if (type == TokenType::SEMICOLON) {
+                pos = line_length;
+            }
+        }
+
+        tokens.emplace_back(TokenType::ENDOFLINE, "\n", lineNumber, columnNumber);
+    }
+
+    int Lexer::scanLines(std::string_view text, int firstLine, std::vector<Token>& tokens) {
+        int lineNumber = firstLine;
+        size_t lineStart = 0;
+
+        while (lineStart < text.size()) {
+            size_t lineEnd = lineStart + simd::findNewline(text.data() + lineStart, text.size() - lineStart);
+
+            scanLine(text.substr(lineStart, lineEnd - lineStart), lineNumber, tokens);
+            lineStart = lineEnd + 1;
             lineNumber++;
         }
+        return lineNumber - firstLine;
+    }
+
+    std::vector<Token> Lexer::tokenize(const SourceBuffer& buffer) {
+        std::vector<Token> tokens;
+        int lineCount = scanLines(buffer.view(), 1, tokens);
         
+        tokens.emplace_back(TokenType::ENDOFFILE, "", lineCount + 1, 1);
+        return tokens;
+    }
+
+    std::vector<Token> Lexer::tokenizeParallel(const SourceBuffer& buffer, unsigned threads) {
+        std::string_view source = buffer.view();
+
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        size_t chunkCount = std::min<size_t>(threads, source.size() / PARALLEL_MIN_CHUNK);
+        if (chunkCount <= 1) {
+            return tokenize(buffer);
+        }
+
+        // Cut at newlines: every chunk holds whole lines, and since ';'
+        // comments end with their line no token can straddle two chunks
+        std::vector<std::string_view> chunks;
+        size_t chunkStart = 0;
+        for (size_t i = 1; i <= chunkCount && chunkStart < source.size(); ++i) {
+            size_t chunkEnd = source.size();
+            if (i < chunkCount) {
+                size_t cut = std::max(chunkStart, source.size() * i / chunkCount);
+                size_t newline = cut + simd::findNewline(source.data() + cut, source.size() - cut);
+                chunkEnd = std::min(newline + 1, source.size());
+            }
+            chunks.push_back(source.substr(chunkStart, chunkEnd - chunkStart));
+            chunkStart = chunkEnd;
+        }
+
+        // Each worker lexes with its own Lexer so no symbol table is shared.
+        // Keywords are interned in the same order everywhere, so only ids
+        // above the keyword range need remapping afterwards.
+        struct ChunkResult {
+            Lexer lexer;
+            std::vector<Token> tokens;
+            int lineCount = 0;
+        };
+        std::vector<ChunkResult> results(chunks.size());
+
+        auto runWorkers = [&](auto&& job) {
+            std::vector<std::thread> workers;
+            workers.reserve(chunks.size());
+            for (size_t i = 0; i < chunks.size(); ++i) {
+                workers.emplace_back(job, i);
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        };
+
+        runWorkers([&](size_t i) {
+            results[i].lineCount = results[i].lexer.scanLines(chunks[i], 1, results[i].tokens);
+        });
+
+        // Serial, but only over distinct names: interning chunk by chunk in
+        // first-seen order hands out exactly the ids the serial lexer would
+        std::vector<int> firstLines(chunks.size());
+        std::vector<std::vector<SymbolId>> remaps(chunks.size());
+        int lineNumber = 1;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            firstLines[i] = lineNumber;
+            lineNumber += results[i].lineCount;
+
+            const SymbolTable& local = results[i].lexer.symbols_;
+            std::vector<SymbolId>& remap = remaps[i];
+            remap.resize(local.size() + 1);
+            for (SymbolId id = 1; id <= local.size(); ++id) {
+                remap[id] = id < keywordTypes_.size() ? id : symbols_.intern(local.name(id));
+            }
+        }
+
+        runWorkers([&](size_t i) {
+            const int lineOffset = firstLines[i] - 1;
+            for (Token& token : results[i].tokens) {
+                token = token.withLine(token.getLine() + lineOffset).withSymbol(remaps[i][token.getSymbol()]);
+            }
+        });
+
+        size_t total = 1;
+        for (const auto& result : results) {
+            total += result.tokens.size();
+        }
+        std::vector<Token> tokens;
+        tokens.reserve(total);
+        for (const auto& result : results) {
+            tokens.insert(tokens.end(), result.tokens.begin(), result.tokens.end());
+        }
         tokens.emplace_back(TokenType::ENDOFFILE, "", lineNumber, 1);
         return tokens;
     }
@@ -0,0 +1,189 @@
+#include "../include/lexer/scan_kernels.hpp"
+#include <cstdint>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define GRS_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace grs_lexer::simd {
+
+namespace {
+
+// ---------------------------------------------------------------- scalar
+
+size_t skipBlanksScalar(const char* data, size_t size){
+    size_t i = 0;
+    while(i < size && isBlank(data[i])) i++;
+    return i;
+}
+
+size_t findNewlineScalar(const char* data, size_t size){
+    size_t i = 0;
+    while(i < size && data[i] != '\n') i++;
+    return i;
+}
+
+bool isAsciiScalar(const char* data, size_t size){
+    unsigned char bits = 0;
+    for(size_t i = 0; i < size; ++i) bits |= static_cast<unsigned char>(data[i]);
+    return (bits & 0x80) == 0;
+}
+
+#ifdef GRS_SCAN_X86
+
+// ---------------------------------------------------------------- SSE2
+
+// blank <=> c == ' ' || (unsigned)(c - '\t') <= 4
+__attribute__((target("sse2")))
+inline unsigned blankMask16(__m128i bytes){
+    const __m128i shifted = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+    const __m128i inRange = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8('\r' - '\t')), shifted);
+    const __m128i space = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(inRange, space)));
+}
+
+__attribute__((target("sse2")))
+size_t skipBlanksSSE2(const char* data, size_t size){
+    size_t i = 0;
+    for(; i + 16 <= size; i += 16){
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const unsigned nonBlank = ~blankMask16(bytes) & 0xFFFFu;
+        if(nonBlank) return i + __builtin_ctz(nonBlank);
+    }
+    return i + skipBlanksScalar(data + i, size - i);
+}
+
+__attribute__((target("sse2")))
+size_t findNewlineSSE2(const char* data, size_t size){
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t i = 0;
+    for(; i + 16 <= size; i += 16){
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const unsigned hits = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+        if(hits) return i + __builtin_ctz(hits);
+    }
+    return i + findNewlineScalar(data + i, size - i);
+}
+
+__attribute__((target("sse2")))
+bool isAsciiSSE2(const char* data, size_t size){
+    __m128i bits = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 16 <= size; i += 16){
+        bits = _mm_or_si128(bits, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+    }
+    return _mm_movemask_epi8(bits) == 0 && isAsciiScalar(data + i, size - i);
+}
+
+// ---------------------------------------------------------------- AVX2
+
+__attribute__((target("avx2")))
+size_t skipBlanksAVX2(const char* data, size_t size){
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i span = _mm256_set1_epi8('\r' - '\t');
+    const __m256i space = _mm256_set1_epi8(' ');
+    size_t i = 0;
+    for(; i + 32 <= size; i += 32){
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i shifted = _mm256_sub_epi8(bytes, tab);
+        const __m256i inRange = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, span), shifted);
+        const __m256i blank = _mm256_or_si256(inRange, _mm256_cmpeq_epi8(bytes, space));
+        const uint32_t nonBlank = ~static_cast<uint32_t>(_mm256_movemask_epi8(blank));
+        if(nonBlank) return i + __builtin_ctz(nonBlank);
+    }
+    return i + skipBlanksSSE2(data + i, size - i);
+}
+
+__attribute__((target("avx2")))
+size_t findNewlineAVX2(const char* data, size_t size){
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    for(; i + 32 <= size; i += 32){
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const uint32_t hits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline)));
+        if(hits) return i + __builtin_ctz(hits);
+    }
+    return i + findNewlineSSE2(data + i, size - i);
+}
+
+__attribute__((target("avx2")))
+bool isAsciiAVX2(const char* data, size_t size){
+    __m256i bits = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 32 <= size; i += 32){
+        bits = _mm256_or_si256(bits, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+    }
+    return _mm256_movemask_epi8(bits) == 0 && isAsciiSSE2(data + i, size - i);
+}
+
+#endif // GRS_SCAN_X86
+
+struct Kernels {
+    Level level;
+    size_t (*skipBlanks)(const char*, size_t);
+    size_t (*findNewline)(const char*, size_t);
+    bool (*isAscii)(const char*, size_t);
+};
+
+constexpr Kernels scalarKernels{Level::Scalar, skipBlanksScalar, findNewlineScalar, isAsciiScalar};
+#ifdef GRS_SCAN_X86
+constexpr Kernels sse2Kernels{Level::SSE2, skipBlanksSSE2, findNewlineSSE2, isAsciiSSE2};
+constexpr Kernels avx2Kernels{Level::AVX2, skipBlanksAVX2, findNewlineAVX2, isAsciiAVX2};
+#endif
+
+Level supportedLevel(){
+#ifdef GRS_SCAN_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) return Level::AVX2;
+    if(__builtin_cpu_supports("sse2")) return Level::SSE2;
+#endif
+    return Level::Scalar;
+}
+
+const Kernels& kernelsFor(Level level){
+#ifdef GRS_SCAN_X86
+    if(level == Level::AVX2) return avx2Kernels;
+    if(level == Level::SSE2) return sse2Kernels;
+#endif
+    return scalarKernels;
+}
+
+// function-local so the CPU probe runs on first use, whatever the static init order
+const Kernels*& active(){
+    static const Kernels* kernels = &kernelsFor(supportedLevel());
+    return kernels;
+}
+
+} // namespace
+
+Level activeLevel(){
+    return active()->level;
+}
+
+const char* levelName(Level level){
+    switch(level){
+        case Level::AVX2: return "AVX2";
+        case Level::SSE2: return "SSE2";
+        default: return "scalar";
+    }
+}
+
+void setLevel(Level level){
+    const Level supported = supportedLevel();
+    active() = &kernelsFor(static_cast<int>(level) > static_cast<int>(supported) ? supported : level);
+}
+
+size_t skipBlanksKernel(const char* data, size_t size){
+    return active()->skipBlanks(data, size);
+}
+
+size_t findNewline(const char* data, size_t size){
+    return active()->findNewline(data, size);
+}
+
+bool isAscii(const char* data, size_t size){
+    return active()->isAscii(data, size);
+}
+
+}
@@ -0,0 +1,101 @@
+#include "../include/lexer/source_buffer.hpp"
+#include "../include/lexer/scan_kernels.hpp"
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GRS_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace grs_lexer {
+
+SourceBuffer::SourceBuffer(std::string text, std::string name)
+    : text_(std::move(text)), name_(std::move(name)) {}
+
+SourceBuffer::~SourceBuffer(){
+    unmap();
+}
+
+SourceBuffer::SourceBuffer(SourceBuffer&& other) noexcept
+    : text_(std::move(other.text_)), name_(std::move(other.name_)),
+      mappedData_(other.mappedData_), mappedSize_(other.mappedSize_), mapped_(other.mapped_) {
+    other.mappedData_ = nullptr;
+    other.mappedSize_ = 0;
+    other.mapped_ = false;
+}
+
+SourceBuffer& SourceBuffer::operator=(SourceBuffer&& other) noexcept{
+    if(this != &other){
+        unmap();
+        text_ = std::move(other.text_);
+        name_ = std::move(other.name_);
+        mappedData_ = other.mappedData_;
+        mappedSize_ = other.mappedSize_;
+        mapped_ = other.mapped_;
+        other.mappedData_ = nullptr;
+        other.mappedSize_ = 0;
+        other.mapped_ = false;
+    }
+    return *this;
+}
+
+bool SourceBuffer::isAscii() const{
+    std::string_view text = view();
+    return simd::isAscii(text.data(), text.size());
+}
+
+void SourceBuffer::unmap(){
+#ifdef GRS_HAVE_MMAP
+    if(mapped_){
+        munmap(const_cast<char*>(mappedData_), mappedSize_);
+    }
+#endif
+    mappedData_ = nullptr;
+    mappedSize_ = 0;
+    mapped_ = false;
+}
+
+SourceBuffer SourceBuffer::fromFile(const std::string& path){
+#ifdef GRS_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        throw std::runtime_error("Cannot open source file: " + path);
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0){
+        ::close(fd);
+        throw std::runtime_error("Cannot stat source file: " + path);
+    }
+
+    SourceBuffer buffer(std::string(), path);
+    // mmap rejects zero-length mappings; an empty file is just an empty buffer
+    if(info.st_size > 0){
+        void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED){
+            ::close(fd);
+            throw std::runtime_error("Cannot map source file: " + path);
+        }
+        madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+        buffer.mappedData_ = static_cast<const char*>(data);
+        buffer.mappedSize_ = static_cast<size_t>(info.st_size);
+        buffer.mapped_ = true;
+    }
+    ::close(fd);
+    return buffer;
+#else
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open()){
+        throw std::runtime_error("Cannot open source file: " + path);
+    }
+    return SourceBuffer(std::string((std::istreambuf_iterator<char>(file)),
+                                    std::istreambuf_iterator<char>()), path);
+#endif
+}
+
+}
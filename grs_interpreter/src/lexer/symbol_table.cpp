@@ -0,0 +1,27 @@
+#include "../include/lexer/symbol_table.hpp"
+namespace grs_lexer {
+
+SymbolId SymbolTable::intern(std::string_view name){
+    auto it = ids_.find(name);
+    if(it != ids_.end()){
+        return it->second;
+    }
+    const std::string& stored = names_.emplace_back(name);
+    SymbolId id = static_cast<SymbolId>(names_.size());
+    ids_.emplace(stored, id);
+    return id;
+}
+
+SymbolId SymbolTable::find(std::string_view name) const{
+    auto it = ids_.find(name);
+    return it != ids_.end() ? it->second : NO_SYMBOL;
+}
+
+std::string_view SymbolTable::name(SymbolId id) const{
+    if(id == NO_SYMBOL || id > names_.size()){
+        return {};
+    }
+    return names_[id - 1];
+}
+
+}
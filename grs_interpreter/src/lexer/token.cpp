@@ -1,18 +1,46 @@
 #include "../include/lexer/token.hpp" 
 namespace grs_lexer {
 
-Token::Token(TokenType type, const std::string& value, int line, int column)
-    : type_(type), value_(value), line_(line), column_(column) {}
+Token::Token(TokenType type, std::string_view value, int line, int column, SymbolId symbol)
+    : value_(value), type_(type), line_(line), column_(column) {
+    payload_.integer = 0;
+    payload_.symbol = symbol;
+}
+
+Token::Token(TokenType type, std::string_view value, int line, int column, std::int64_t integer)
+    : value_(value), type_(type), line_(line), column_(column) {
+    payload_.integer = integer;
+}
+
+Token::Token(TokenType type, std::string_view value, int line, int column, double real)
+    : value_(value), type_(type), line_(line), column_(column) {
+    payload_.real = real;
+}
 
 
 TokenType Token::getType() const{
     return type_;
 }
 
-std::string Token::getValue() const{
+std::string_view Token::getValue() const{
     return value_;
 }
 
+SymbolId Token::getSymbol() const{
+    return isNumber() ? NO_SYMBOL : payload_.symbol;
+}
+
+std::int64_t Token::getInteger() const{
+    return type_ == TokenType::INTEGER ? payload_.integer : 0;
+}
+
+double Token::getReal() const{
+    if (type_ == TokenType::INTEGER) {
+        return static_cast<double>(payload_.integer);
+    }
+    return type_ == TokenType::FLOAT ? payload_.real : 0.0;
+}
+
 int Token::getLine() const{
     return line_;
 }
@@ -21,6 +49,24 @@ int Token::getColumn() const{
     return column_;
 }
 
+Token Token::withLine(int line) const{
+    Token copy = *this;
+    copy.line_ = line;
+    return copy;
+}
+
+Token Token::withSymbol(SymbolId symbol) const{
+    Token copy = *this;
+    if (!isNumber()) {
+        copy.payload_.symbol = symbol;
+    }
+    return copy;
+}
+
+bool Token::isNumber() const{
+    return type_ == TokenType::INTEGER || type_ == TokenType::FLOAT;
+}
+
 std::string_view Token::typeToString() const{
 
     return typeToStringMap.at(type_);
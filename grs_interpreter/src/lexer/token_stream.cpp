@@ -0,0 +1,100 @@
+#include "../include/lexer/token_stream.hpp"
+#include "../include/lexer/lexer.hpp"
+#include "../include/lexer/scan_kernels.hpp"
+namespace grs_lexer {
+
+namespace {
+// returned when there is no real token to point at
+const Token endOfFileToken{TokenType::ENDOFFILE, "", 0, 0};
+}
+
+TokenStream::TokenStream(Lexer& lexer, const SourceBuffer& source){
+    std::string_view text = source.view();
+    size_t lineStart = 0;
+    int lineNumber = 1;
+    bool endEmitted = false;
+
+    source_ = [&lexer, text, lineStart, lineNumber, endEmitted](std::vector<Token>& lineTokens) mutable {
+        if(lineStart >= text.size()){
+            if(endEmitted){
+                return false;
+            }
+            lineTokens.emplace_back(TokenType::ENDOFFILE, "", lineNumber, 1);
+            endEmitted = true;
+            return true;
+        }
+
+        size_t lineEnd = lineStart + simd::findNewline(text.data() + lineStart, text.size() - lineStart);
+        lexer.scanLine(text.substr(lineStart, lineEnd - lineStart), lineNumber, lineTokens);
+        lineStart = lineEnd + 1;
+        lineNumber++;
+        return true;
+    };
+}
+
+TokenStream::TokenStream(LineSource source)
+    : source_(std::move(source)) {}
+
+TokenStream::TokenStream(const std::vector<Token>& tokens)
+    : TokenStream(tokens.data(), tokens.size()) {}
+
+TokenStream::TokenStream(const Token* tokens, size_t count)
+    : finished_(true), tokens_(tokens), count_(count) {}
+
+const Token* TokenStream::at(size_t index) const{
+    if(tokens_){
+        return index < count_ ? tokens_ + index : nullptr;
+    }
+    if(index < windowStart_ || index >= windowStart_ + window_.size()){
+        return nullptr;
+    }
+    return &window_[index - windowStart_];
+}
+
+// Pull the next line into the window. Returns false once the source
+// has nothing left.
+bool TokenStream::fill(){
+    if(finished_){
+        return false;
+    }
+
+    lineTokens_.clear();
+    if(!source_(lineTokens_)){
+        finished_ = true;
+        return false;
+    }
+    window_.insert(window_.end(), lineTokens_.begin(), lineTokens_.end());
+
+    // drop tokens the parser can no longer reach
+    while(windowStart_ + HISTORY < cursor_ && !window_.empty()){
+        window_.pop_front();
+        windowStart_++;
+    }
+    return true;
+}
+
+const Token& TokenStream::peek(){
+    const Token* token = at(cursor_);
+    while(!token && fill()){
+        token = at(cursor_);
+    }
+    return token ? *token : endOfFileToken;
+}
+
+const Token& TokenStream::previous() const{
+    const Token* token = cursor_ > 0 ? at(cursor_ - 1) : nullptr;
+    return token ? *token : endOfFileToken;
+}
+
+bool TokenStream::isAtEnd(){
+    return peek().getType() == TokenType::ENDOFFILE;
+}
+
+const Token& TokenStream::advance(){
+    if(!isAtEnd()){
+        cursor_++;
+    }
+    return previous();
+}
+
+}
@@ -1,31 +1,41 @@
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <string>
 #include "lexer/lexer.hpp"
 #include "lexer/token.hpp"
+#include "lexer/source_buffer.hpp"
+#include "lexer/token_stream.hpp"
 #include "parser/parser.hpp"
+#include "ast/optimizer.hpp"
 #include "common/utils.hpp"
+#include "common/source_location.hpp"
 #include "interpreter/instruction_generator.hpp"
+#include "interpreter/program_cache.hpp"
+#include "vm/compiler.hpp"
+#include "vm/type_checker.hpp"
+#include "vm/vm.hpp"
 #include "executor/executor.hpp"
 #include <typeinfo>
 
 namespace fs = std::filesystem;
 
 
-void printInstructions(const std::vector<grs_interpreter::Instruction>& instructions) {
+void printInstructions(const grs_interpreter::InstructionList& instructions, const common::LocationTable& locations) {
     std::cout << "Commands:" << std::endl;
-    for (const auto& inst : instructions) {
-        std::cout << "command: " << inst.command << std::endl;        
+    for (const auto& inst : instructions.code) {
+        std::cout << "command: " << instructions.commandName(inst) << std::endl;        
    
-        for (const auto& arg : inst.args) {
+        for (const auto& arg : instructions.arguments(inst)) {
             std::cout << "  " << arg.first << " = ";
             std::visit([](const auto& value){
                 std::cout<<value;
             },  arg.second);
             std::cout<< std::endl;
         }
-          for (const auto& location : inst.commandLocationInfo) {
+        if (inst.location != common::NO_LOCATION) {
+            const auto location = locations.lineColumn(inst.location);
             std::cout << "  Location: Line " << location.first 
                       << ", Column " << location.second << std::endl;
         }
@@ -36,66 +46,142 @@ void printInstructions(const std::vector<grs_interpreter::Instruction>& instruct
     }
 }
 
-int main() {
-
-
-    fs::path testFile = "../tests/pos_type_convertion.txt";
-
-    std::ifstream file(testFile);
-
-    if(!file.is_open()){
-        std::cerr << "Error opening file." << std::endl;
-        return 1;
-    }
-    
-    std::string code((std::istreambuf_iterator<char>(file)),
-                     std::istreambuf_iterator<char>());
-    file.close();
-
-    std::cout << "grs Code:" << std::endl << code << std::endl;
-    std::cout << "-------------------" << std::endl;
-    
-    // Lexer
+// Lex, parse and generate, and compile to bytecode when asked for;
+// returns false (after reporting) on parser errors
+bool compile(const grs_lexer::SourceBuffer& source, const common::LocationTable& locations, common::FileId file,
+             grs_interpreter::InstructionList& instructions, grs_vm::Chunk* bytecode = nullptr) {
+    // Lexer, streamed into the parser line by line
     grs_lexer::Lexer lexer;
-    auto tokens = lexer.tokenize(code);
-    
-    std::cout << "Tokens :" << std::endl;
-    for (const auto& token : tokens) {
-        std::cout << "  " << static_cast<int>(token.getType()) << " - " << token.getValue() << std::endl;
-    }
-    std::cout << "-------------------" << std::endl;
+    grs_lexer::TokenStream tokens(lexer, source);
     
     // Parser
     grs_parser::Parser parser;
+    parser.setLocations(&locations, file);
+    if (std::getenv("GRS_TRACE_PARSER")) {
+        parser.setTrace(&std::cout);
+    }
+    // only the main program is parsed now; other DEFs wait until they are used
     auto ast = parser.parse(tokens);
     
-    if (parser.hasErrors()) {
+    const auto parseErrors = [&parser]() {
+        if (!parser.hasErrors()) {
+            return false;
+        }
         std::cout << "Parser Errors:" << std::endl;
         for (const auto& error : parser.getErrors()) {
             std::cout << "  " << error.message << " (Line: " << error.line << ")" << std::endl;
         }
-        return 1;
+        return true;
+    };
+    if (parseErrors()) {
+        return false;
     }
     
     if (!ast) {
         std::cout << "AST not become!" << std::endl;
-        return 1;
+        return false;
     }
     
     std::cout << "AST succeed!" << std::endl;
     std::cout << "AST statements numbers: " << ast->getStatements().size() << std::endl;
     std::cout << "-------------------" << std::endl;
     
+    grs_ast::Optimizer optimizer;
+    const auto stats = optimizer.optimize(ast.get(), *ast.getArena());
+    if (std::getenv("GRS_OPTIMIZER_STATS")) {
+        std::cout << stats << std::endl;
+    }
+    // the optimizer has parsed the DEFs the program calls
+    if (parseErrors()) {
+        return false;
+    }
+
+    grs_vm::TypeChecker checker;
+    if (!checker.check(ast.get())) {
+        std::cout << "Type Errors:" << std::endl;
+        for (const auto& error : checker.getErrors()) {
+            std::cout << "  " << error.message;
+            if (error.location != common::NO_LOCATION) {
+                std::cout << " (Line: " << locations.lineColumn(error.location).first << ")";
+            }
+            std::cout << std::endl;
+        }
+        return false;
+    }
+
     // Instruction Generator
     grs_interpreter::InstructionGenerator generator;
-    auto instructions = generator.generateInstructions(ast);
+    instructions = generator.generateInstructions(ast.get());
+
+    if (bytecode) {
+        try {
+            *bytecode = grs_vm::Compiler().compile(ast.get());
+        } catch (const std::exception& e) {
+            std::cout << "Bytecode compile error: " << e.what() << std::endl;
+            return false;
+        }
+        if (std::getenv("GRS_DUMP_BYTECODE")) {
+            grs_vm::disassemble(*bytecode, std::cout);
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+
+    // --rebuild ignores (and then refreshes) the compiled-program cache;
+    // --run also compiles to bytecode and runs it on the executor
+    bool rebuild = false;
+    bool run = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--rebuild") {
+            rebuild = true;
+        } else if (std::string(argv[i]) == "--run") {
+            run = true;
+        }
+    }
+
+    fs::path testFile = "../tests/pos_type_convertion.txt";
+
+    grs_lexer::SourceBuffer source;
+    try{
+        source = grs_lexer::SourceBuffer::fromFile(testFile.string());
+    } catch(const std::exception& e){
+        std::cerr << "Error opening file: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "grs Code:" << std::endl << source.view() << std::endl;
+    std::cout << "-------------------" << std::endl;
+
+    common::LocationTable locations;
+    const common::FileId file = locations.addFile(testFile.string(), source.view());
+
+    grs_interpreter::ProgramCache cache(grs_interpreter::ProgramCache::pathFor(testFile.string()));
+    grs_interpreter::InstructionList instructions;
+    grs_vm::Chunk bytecode;
+
+    // the cache holds only the generated instructions, so running needs the AST
+    if (auto cached = (rebuild || run) ? std::nullopt : cache.load(source.view())) {
+        std::cout << "Loaded compiled program from " << cache.getPath() << std::endl;
+        instructions = std::move(*cached);
+    } else {
+        if (!compile(source, locations, file, instructions, run ? &bytecode : nullptr)) {
+            return 1;
+        }
+        if (!cache.store(source.view(), instructions)) {
+            std::cerr << "Could not write compiled program to " << cache.getPath() << std::endl;
+        }
+    }
     
     std::cout << "Instruction numbers: " << instructions.size() << std::endl;
-    printInstructions(instructions);
-
-    // grs_interpreter::Executor executor;
+    printInstructions(instructions, locations);
 
-    // executor.executeInstruction(instructions);
+    if (run) {
+        grs_vm::Vm vm(bytecode);
+        grs_interpreter::Executor executor;
+        executor.run(vm);
+    }
 
         
     return 0;
@@ -0,0 +1,371 @@
+#include "parser/incremental_parser.hpp"
+#include "ast/visitor.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace grs_parser{
+
+namespace {
+
+// units are small; start their arenas small too
+constexpr size_t UNIT_ARENA_CHUNK = 1024;
+
+// Spare location ids left after each line, so that an edit usually fits
+// into the ids of the lines it replaces
+constexpr std::uint32_t LINE_SLACK = 64;
+// ids are laid out afresh before they come near NO_LOCATION
+constexpr std::uint32_t MAX_ID = UINT32_MAX / 2;
+
+// Replaces items [first, first + count) in place, so only a change in their
+// number moves the items after them (as FunctionBlock::replaceStatements)
+template<typename T>
+void replaceRange(std::vector<T>& items, size_t first, size_t count, std::vector<T> replacement){
+    auto begin = items.begin() + first;
+    const size_t overlap = std::min(count, replacement.size());
+    std::move(replacement.begin(), replacement.begin() + overlap, begin);
+    if(count > overlap){
+        items.erase(begin + overlap, begin + count);
+    } else {
+        items.insert(begin + overlap, std::make_move_iterator(replacement.begin() + overlap),
+                     std::make_move_iterator(replacement.end()));
+    }
+}
+
+// Moves the locations of a tree by `delta` ids. Any node may carry one
+// (calls and assignments inside expressions do), so the walk is complete
+class LocationShifter : public grs_ast::ASTVisitorBase{
+    public:
+    explicit LocationShifter(std::int64_t delta) : delta_{delta} {}
+
+    void shift(grs_ast::ASTNode* node){
+        if(node){
+            node->shiftLocation(delta_);
+            node->accept(*this);
+        }
+    }
+
+    void visit(grs_ast::FunctionBlock& node) override{
+        for(const auto& statement : node.getStatements()){
+            shift(statement);
+        }
+    }
+
+    void visit(grs_ast::MotionCommand& node) override{ shiftArguments(node.getArgs());}
+    void visit(grs_ast::BinaryExpression& node) override{
+        shift(node.getLeft());
+        shift(node.getRight());
+    }
+    void visit(grs_ast::UnaryExpression& node) override{ shift(node.getExpression());}
+    void visit(grs_ast::VariableDeclaration& node) override{ shift(node.getInitializer());}
+    void visit(grs_ast::FrameDeclaration& node) override{ shiftArguments(node.getArgs());}
+    void visit(grs_ast::PositionDeclaration& node) override{ shiftArguments(node.getArgs());}
+    void visit(grs_ast::AxisDeclaration& node) override{ shiftArguments(node.getArgs());}
+    void visit(grs_ast::ExecutePosAndAxisExpression& node) override{ shift(node.getExpr());}
+
+    void visit(grs_ast::IfStatement& node) override{
+        shift(node.getCondition());
+        shift(node.getThenBranch());
+        shift(node.getElseBranch());
+    }
+
+    void visit(grs_ast::ForStatement& node) override{
+        shift(node.getStart());
+        shift(node.getEnd());
+        shift(node.getBody());
+    }
+    void visit(grs_ast::WhileStatement& node) override{
+        shift(node.getCondition());
+        shift(node.getBody());
+    }
+    void visit(grs_ast::RepeatStatement& node) override{
+        shift(node.getBody());
+        shift(node.getCondition());
+    }
+    void visit(grs_ast::SwitchStatement& node) override{
+        shift(node.getSelector());
+        for(const auto& branch : node.getCases()){
+            shift(branch.body);
+        }
+        shift(node.getDefault());
+    }
+
+    // bodies are parsed together with their DEF here
+    void visit(grs_ast::FunctionDeclaration& node) override{ shift(node.getBody());}
+    void visit(grs_ast::CallExpression& node) override{
+        for(const auto& arg : node.getArgs()){
+            shift(arg);
+        }
+    }
+    void visit(grs_ast::ReturnStatement& node) override{ shift(node.getValue());}
+
+    private:
+    std::int64_t delta_;
+
+    template<typename Arguments>
+    void shiftArguments(const Arguments& args){
+        for(const auto& arg : args){
+            shift(arg.second);
+        }
+    }
+};
+
+}
+
+std::vector<IncrementalParser::Line> IncrementalParser::lexLines(std::string_view text, int firstLine){
+    std::vector<Line> lines;
+    size_t lineStart = 0;
+    int lineNumber = firstLine;
+
+    while(lineStart < text.size()){
+        size_t lineEnd = text.find('\n', lineStart);
+        if(lineEnd == std::string_view::npos){
+            lineEnd = text.size();
+        }
+
+        Line line;
+        line.text = std::make_unique<const std::string>(text.substr(lineStart, lineEnd - lineStart));
+        lexer_.scanLine(*line.text, lineNumber, line.tokens);
+        lines.push_back(std::move(line));
+
+        lineStart = lineEnd + 1;
+        lineNumber++;
+    }
+    return lines;
+}
+
+void IncrementalParser::placeLines(size_t first, size_t last, std::uint32_t id, std::uint32_t slack){
+    for(size_t i = first; i < last; ++i){
+        lines_[i].id = id;
+        id += static_cast<std::uint32_t>(lines_[i].text->size()) + 1 + slack;
+    }
+}
+
+std::vector<std::uint32_t> IncrementalParser::lineStarts()const{
+    std::vector<std::uint32_t> starts;
+    starts.reserve(lines_.size() + 1);
+    for(const auto& line : lines_){
+        starts.push_back(line.id);
+    }
+    starts.push_back(lines_.empty() ? 0 : endOf(lines_.back()));
+    return starts;
+}
+
+size_t IncrementalParser::unitContaining(int line)const{
+    auto it = std::upper_bound(units_.begin(), units_.end(), line,
+                               [](int value, const Unit& unit){ return value < unit.firstLine; });
+    return it == units_.begin() ? 0 : static_cast<size_t>(it - units_.begin()) - 1;
+}
+
+std::vector<IncrementalParser::Unit> IncrementalParser::parseUnits(int line, size_t& resyncUnit, int lineDelta){
+    size_t next = static_cast<size_t>(line - 1);
+    bool endEmitted = false;
+
+    grs_lexer::TokenStream stream([this, next, endEmitted](std::vector<grs_lexer::Token>& lineTokens) mutable {
+        if(next >= lines_.size()){
+            if(endEmitted){
+                return false;
+            }
+            lineTokens.emplace_back(grs_lexer::TokenType::ENDOFFILE, "", static_cast<int>(lines_.size()) + 1, 1);
+            endEmitted = true;
+            return true;
+        }
+        const int lineNumber = static_cast<int>(next) + 1;
+        for(const auto& token : lines_[next].tokens){
+            lineTokens.push_back(token.withLine(lineNumber));
+        }
+        next++;
+        return true;
+    });
+
+    // a unit's errors are collected as it is parsed, so DEF bodies cannot wait
+    parser_.setLazyBodies(false);
+    parser_.setLocations(&locations_, file_);
+    std::vector<Unit> units;
+    while(!stream.isAtEnd()){
+        Unit unit;
+        unit.firstLine = stream.peek().getLine();
+        unit.arena = std::make_unique<grs_ast::Arena>(UNIT_ARENA_CHUNK);
+        parser_.clearErrors();
+
+        // a unit ends where a statement has consumed its line's ENDOFLINE
+        do{
+            if(auto node = parser_.parseDeclaration(stream, *unit.arena)){
+                unit.nodes.push_back(std::move(node));
+            }
+        } while(!stream.isAtEnd() && stream.previous().getType() != grs_lexer::TokenType::ENDOFLINE);
+
+        const int nextLine = stream.peek().getLine();
+        unit.lineCount = nextLine - unit.firstLine;
+        unit.errors = parser_.getErrors();
+        units.push_back(std::move(unit));
+
+        while(resyncUnit < units_.size() && units_[resyncUnit].firstLine + lineDelta < nextLine){
+            resyncUnit++;
+        }
+        if(resyncUnit < units_.size() && units_[resyncUnit].firstLine + lineDelta == nextLine){
+            break;
+        }
+    }
+    return units;
+}
+
+grs_ast::FunctionBlock* IncrementalParser::load(std::string_view code){
+    lines_ = lexLines(code, 1);
+    placeLines(0, lines_.size(), 0, LINE_SLACK);
+    locations_ = common::LocationTable();
+    file_ = locations_.addFile("", lineStarts());
+
+    units_.clear();
+    size_t noResync = 0;
+    units_ = parseUnits(1, noResync, 0);
+
+    std::vector<grs_ast::ASTNode*> statements;
+    for(const auto& unit : units_){
+        statements.insert(statements.end(), unit.nodes.begin(), unit.nodes.end());
+    }
+    program_ = std::make_unique<grs_ast::FunctionBlock>(std::move(statements));
+    return program_.get();
+}
+
+grs_ast::FunctionBlock* IncrementalParser::applyEdit(const SourceEdit& edit){
+    const int lineCount = static_cast<int>(lines_.size());
+    if(edit.firstLine < 1 || edit.firstLine > lineCount + 1 ||
+       edit.lastLine < edit.firstLine - 1 || edit.lastLine > lineCount){
+        throw std::out_of_range("Edit range " + std::to_string(edit.firstLine) + "-" +
+                                std::to_string(edit.lastLine) + " is outside the program");
+    }
+    if(!program_){
+        load("");
+    }
+
+    // Re-lex only the edited lines
+    std::vector<Line> newLines = lexLines(edit.text, edit.firstLine);
+    const int removed = edit.lastLine - edit.firstLine + 1;
+    const int delta = static_cast<int>(newLines.size()) - removed;
+
+    // The parser peeks one token ahead, so the unit ending just above the
+    // edit may have looked at its first line: re-parse from that unit.
+    // Units past the edit keep their parse; their new first lines are
+    // where the re-parse may stop
+    const size_t firstUnit = units_.empty() ? 0 : unitContaining(std::clamp(edit.firstLine - 1, 1, lineCount));
+    const size_t pastEdit = static_cast<size_t>(
+        std::upper_bound(units_.begin() + firstUnit, units_.end(), edit.lastLine,
+                         [](int value, const Unit& unit){ return value < unit.firstLine; }) - units_.begin());
+
+    // The new lines take the ids between the line above and the line below
+    // the edit, with or without slack; only when they do not fit at all are
+    // the ids below moved
+    const size_t first = static_cast<size_t>(edit.firstLine - 1);
+    const std::uint32_t low = first > 0 ? endOf(lines_[first - 1]) : 0;
+    const std::uint32_t high = edit.lastLine < lineCount ? lines_[edit.lastLine].id : MAX_ID;
+    std::uint32_t tight = 0;
+    for(const auto& line : newLines){
+        tight += static_cast<std::uint32_t>(line.text->size()) + 1;
+    }
+    const std::uint32_t spaced = tight + LINE_SLACK * static_cast<std::uint32_t>(newLines.size());
+    std::uint32_t overflow = low + tight > high ? low + spaced - high : 0;
+
+    const size_t next = first + newLines.size();
+    replaceRange(lines_, first, static_cast<size_t>(removed), std::move(newLines));
+    placeLines(first, next, low, overflow != 0 || low + spaced <= high ? LINE_SLACK : 0);
+
+    // The lines below move down in blocks of one old unit (the first block is
+    // the rest of the edited unit) until the spare ids behind a block take up
+    // what is left to move; moves[k] is how far units_[pastEdit + k] went
+    std::vector<std::uint32_t> moves;
+    size_t line = next;
+    for(size_t unit = pastEdit; overflow != 0; ++unit){
+        if(unit > units_.size()){
+            return relayout();
+        }
+        const size_t end = unit < units_.size() ? static_cast<size_t>(units_[unit].firstLine - 1 + delta) : lines_.size();
+        const std::uint32_t gap = line < end ? (end < lines_.size() ? lines_[end].id : MAX_ID) - endOf(lines_[end - 1]) : 0;
+        for(; line < end; ++line){
+            lines_[line].id += overflow;
+        }
+        if(unit > pastEdit){
+            moves.push_back(overflow);
+        }
+        overflow = gap >= overflow ? 0 : overflow - gap;
+    }
+    locations_.setLineStarts(file_, lineStarts());
+
+    const int reparseFrom = firstUnit < units_.size() ? units_[firstUnit].firstLine : 1;
+    size_t survivorsFrom = pastEdit;
+    std::vector<Unit> reparsed = parseUnits(reparseFrom, survivorsFrom, delta);
+
+    size_t firstStatement = 0;
+    for(size_t i = 0; i < firstUnit; ++i){
+        firstStatement += units_[i].nodes.size();
+    }
+    size_t replacedStatements = 0;
+    for(size_t i = firstUnit; i < survivorsFrom; ++i){
+        replacedStatements += units_[i].nodes.size();
+    }
+
+    std::vector<grs_ast::ASTNode*> statements;
+    for(const auto& unit : reparsed){
+        statements.insert(statements.end(), unit.nodes.begin(), unit.nodes.end());
+    }
+    program_->replaceStatements(firstStatement, replacedStatements, std::move(statements));
+
+    // the survivors' nodes keep their ids unless their lines moved
+    for(size_t i = survivorsFrom; i < pastEdit + moves.size(); ++i){
+        LocationShifter shifter(moves[i - pastEdit]);
+        for(const auto& node : units_[i].nodes){
+            shifter.shift(node);
+        }
+    }
+    if(delta != 0){
+        for(size_t i = survivorsFrom; i < units_.size(); ++i){
+            units_[i].firstLine += delta;
+            for(auto& error : units_[i].errors){
+                error.line += delta;
+            }
+        }
+    }
+
+    replaceRange(units_, firstUnit, survivorsFrom - firstUnit, std::move(reparsed));
+    return program_.get();
+}
+
+grs_ast::FunctionBlock* IncrementalParser::relayout(){
+    placeLines(0, lines_.size(), 0, LINE_SLACK);
+    locations_.setLineStarts(file_, lineStarts());
+
+    size_t noResync = units_.size();
+    std::vector<Unit> units = parseUnits(1, noResync, 0);
+    std::vector<grs_ast::ASTNode*> statements;
+    for(const auto& unit : units){
+        statements.insert(statements.end(), unit.nodes.begin(), unit.nodes.end());
+    }
+    program_->replaceStatements(0, program_->getStatements().size(), std::move(statements));
+    units_ = std::move(units);
+    return program_.get();
+}
+
+std::vector<ParserError> IncrementalParser::getErrors()const{
+    std::vector<ParserError> errors;
+    for(const auto& unit : units_){
+        errors.insert(errors.end(), unit.errors.begin(), unit.errors.end());
+    }
+    return errors;
+}
+
+bool IncrementalParser::hasErrors()const{
+    return std::any_of(units_.begin(), units_.end(), [](const Unit& unit){ return !unit.errors.empty(); });
+}
+
+std::vector<grs_lexer::Token> IncrementalParser::getTokens()const{
+    std::vector<grs_lexer::Token> tokens;
+    for(size_t i = 0; i < lines_.size(); ++i){
+        const int lineNumber = static_cast<int>(i) + 1;
+        for(const auto& token : lines_[i].tokens){
+            tokens.push_back(token.withLine(lineNumber));
+        }
+    }
+    tokens.emplace_back(grs_lexer::TokenType::ENDOFFILE, "", static_cast<int>(lines_.size()) + 1, 1);
+    return tokens;
+}
+
+}
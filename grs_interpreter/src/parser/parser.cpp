@@ -1,37 +1,71 @@
 #include "parser/parser.hpp"
+#include <array>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <unordered_set>
 namespace grs_parser{
 
-Parser::Parser() : current_{0} {}
+Parser::Parser() : tokens_{nullptr}, arena_{nullptr}, trace_{nullptr}, lazyBodies_{true},
+                   locations_{nullptr}, file_{0}, location_{common::NO_LOCATION} {}
 
 Parser::~Parser(){}
 
 //main parsing function, parsing whole declarations
-std::shared_ptr<grs_ast::FunctionBlock> Parser::parse(const std::vector<grs_lexer::Token>& tokens){
-std::cout << "Parser started..." << std::endl;
-tokens_ = tokens;
-current_ = 0;
+grs_ast::Program Parser::parse(const std::vector<grs_lexer::Token>& tokens){
+    return parse(tokens.data(), tokens.size());
+}
+
+grs_ast::Program Parser::parse(const grs_lexer::Token* tokens, size_t count){
+    grs_lexer::TokenStream stream(tokens, count);
+    return parse(stream);
+}
+
+grs_ast::Program Parser::parse(grs_lexer::TokenStream& tokens){
+if(trace_) *trace_ << "Parser started..." << '\n';
+tokens_ = &tokens;
 errors_.clear();
+entrySeen_ = false;
 
-std::vector<std::shared_ptr<grs_ast::ASTNode>> statement;
+auto arena = std::make_unique<grs_ast::Arena>();
+std::vector<grs_ast::ASTNode*> statement;
 
 while(!isAtEnd()){
-    std::cout << "Token is being processed: " << current_ << " - " 
-                  << static_cast<int>(peek().getType()) << " - " 
-                  << peek().getValue() << std::endl;
+    auto stmt = parseDeclaration(tokens, *arena);
+    if(stmt){
+        statement.push_back(stmt);
+    }
+}
+if(trace_) *trace_ << "Parsing finished." << '\n';
+auto root = arena->make<grs_ast::FunctionBlock>(std::move(statement));
+arena_ = nullptr;
+return grs_ast::Program(std::move(arena), root);
+
+}
+
+grs_ast::ASTNode* Parser::parseDeclaration(grs_lexer::TokenStream& tokens, grs_ast::Arena& arena){
+    tokens_ = &tokens;
+    arena_ = &arena;
+    const size_t start = tokens.position();
+    if(trace_){
+        *trace_ << "Token is being processed: " << start << " - " 
+                << static_cast<int>(peek().getType()) << " - " 
+                << peek().getValue() << '\n';
+    }
+
+    grs_ast::ASTNode* stmt = nullptr;
     try{
-        auto stmt = declaration();
-        if(stmt){
-            statement.push_back(stmt);
-        }
+        stmt = declaration();
     } catch(const std::exception& e){
         std::cerr << " Error during parsing: "<<e.what()<<std::endl;
         advance();
     }
-}
-std::cout << "Parsing finished." << std::endl;
-return std::make_shared<grs_ast::FunctionBlock>(statement);
 
+    // a statement rejected before consuming anything would be retried forever
+    if(tokens.position() == start){
+        advance();
+    }
+    return stmt;
 }
 
 
@@ -39,27 +73,20 @@ return std::make_shared<grs_ast::FunctionBlock>(statement);
 
 
 bool Parser::isAtEnd() const {
-    return current_>= tokens_.size() || tokens_[current_].getType() == grs_lexer::TokenType::ENDOFFILE;
+    return tokens_->isAtEnd();
 }
 
-grs_lexer::Token Parser::peek() const {
-    if(isAtEnd()){
-        return grs_lexer::Token{grs_lexer::TokenType::ENDOFFILE, "", 0, 0};
-    }
-    return tokens_[current_];
+const grs_lexer::Token& Parser::peek() const {
+    return tokens_->peek();
 }
 
-grs_lexer::Token Parser::previous() const {
-    if(current_ == 0){
-        return grs_lexer::Token{grs_lexer::TokenType::ENDOFFILE, "", 0, 0};
-    }
-    return tokens_[current_-1];
+const grs_lexer::Token& Parser::previous() const {
+    return tokens_->previous();
 }
-grs_lexer::Token Parser::advance(){
+const grs_lexer::Token& Parser::advance(){
     if(!isAtEnd()){
-        current_++;
-    std::cout << "Token advanced: " << (current_ - 1) << " -> " << current_ << std::endl;
-
+        tokens_->advance();
+        if(trace_) *trace_ << "Token advanced: " << (tokens_->position() - 1) << " -> " << tokens_->position() << '\n';
     }
     return previous();
 }
@@ -75,8 +102,7 @@ bool Parser::check(grs_lexer::TokenType type) const {
 bool Parser::match(std::initializer_list<grs_lexer::TokenType> types){
     for(auto type : types){
         if(check(type)){
-            std::cout << "Token is been matched: " << grs_lexer::typeToStringMap.at(type) << std::endl;
-
+            if(trace_) *trace_ << "Token is been matched: " << grs_lexer::typeToStringMap.at(type) << '\n';
             advance();
             return true;
         }
@@ -85,20 +111,21 @@ bool Parser::match(std::initializer_list<grs_lexer::TokenType> types){
 }
 
 void Parser::addError(const std::string& message){
-    grs_lexer::Token token = peek();
+    const grs_lexer::Token& token = peek();
     errors_.push_back({message, token.getLine(), token.getColumn()});
 }
 
-void Parser::eraseFirstPosition(){
-    if(lineAndColumn_.size() > 0){
-        lineAndColumn_.erase(lineAndColumn_.begin());
-    }
-    lineAndColumn_.emplace_back(std::make_pair(peek().getLine(),peek().getColumn()));
+common::LocationId Parser::locationOf(const grs_lexer::Token& token)const{
+    return locations_ ? locations_->encode(file_, token.getLine(), token.getColumn()) : common::NO_LOCATION;
+}
+
+void Parser::markLocation(){
+    location_ = locationOf(peek());
 }
 // Recursive descent ASTNodes
 
 //top level parsing
-std::shared_ptr<grs_ast::ASTNode> Parser::declaration(){
+grs_ast::ASTNode* Parser::declaration(){
     //grs language variable and function definition
     if(match({grs_lexer::TokenType::DEF})){                
         return functionDeclaration();
@@ -110,8 +137,19 @@ std::shared_ptr<grs_ast::ASTNode> Parser::declaration(){
     return statement();
 }
 
-std::shared_ptr<grs_ast::ASTNode> Parser::functionDeclaration(){
+// DEF [INT | REAL | BOOL] name([type parameter, ...])
+grs_ast::ASTNode* Parser::functionDeclaration(){
     std::string functionName;
+    const common::LocationId location = locationOf(peek());
+
+    grs_lexer::TokenType returnType = grs_lexer::TokenType::ENDOFFILE;
+    if(match({grs_lexer::TokenType::INT, grs_lexer::TokenType::REAL, grs_lexer::TokenType::BOOL})){
+        returnType = previous().getType();
+    } else if(check(grs_lexer::TokenType::CHAR) || check(grs_lexer::TokenType::POS) ||
+              check(grs_lexer::TokenType::FRAME) || check(grs_lexer::TokenType::AXIS)){
+        addError("DEF can only return INT, REAL or BOOL");
+        return nullptr;
+    }
 
     if(!check(grs_lexer::TokenType::IDENTIFIER)){
         addError("Expeceted function name after DEF");
@@ -123,21 +161,105 @@ std::shared_ptr<grs_ast::ASTNode> Parser::functionDeclaration(){
             addError("Expected '(' after function name");
             return nullptr;
         }
+        std::vector<grs_ast::FunctionDeclaration::Parameter> parameters;
+        if(!check(grs_lexer::TokenType::RPAREN)){
+            do{
+                if(!match({grs_lexer::TokenType::INT, grs_lexer::TokenType::REAL, grs_lexer::TokenType::BOOL})){
+                    addError("Expected parameter type (INT, REAL or BOOL)");
+                    return nullptr;
+                }
+                const grs_lexer::TokenType type = previous().getType();
+                if(!check(grs_lexer::TokenType::IDENTIFIER)){
+                    addError("Expected parameter name");
+                    return nullptr;
+                }
+                std::string name(advance().getValue());
+                for(const auto& parameter : parameters){
+                    if(parameter.name == name){
+                        addError("Duplicate parameter '" + name + "'");
+                        return nullptr;
+                    }
+                }
+                parameters.push_back({type, std::move(name)});
+            } while(match({grs_lexer::TokenType::COMMA}));
+        }
         if(!match({grs_lexer::TokenType::RPAREN})){
             addError("Expected ')' after parameters");
             return nullptr;
         }
 
-        auto body = block();
+        // the first DEF is the main program, which runs at once: parse it
+        // straight from the stream instead of recording its tokens
+        const bool entry = !entrySeen_;
+        entrySeen_ = true;
+        if(!lazyBodies_ || entry){
+            auto body = block();
+            if(!match({grs_lexer::TokenType::END})){
+                addError({"Expected 'END' after function body"});
+                return nullptr;
+            }
+            return arena_->make<grs_ast::FunctionDeclaration>(functionName, std::move(parameters), returnType,
+                                                              static_cast<grs_ast::FunctionBlock*>(body), location);
+        }
+
+        // pre-scan: record the body up to its END, nested DEF ... END included
+        std::vector<grs_lexer::Token> bodyTokens;
+        int depth = 0;
+        while(!isAtEnd()){
+            const auto type = peek().getType();
+            if(type == grs_lexer::TokenType::END && depth == 0){
+                break;
+            }
+            if(type == grs_lexer::TokenType::DEF){
+                depth++;
+            } else if(type == grs_lexer::TokenType::END){
+                depth--;
+            }
+            bodyTokens.push_back(advance());
+        }
+        const grs_lexer::Token& end = peek();
+        bodyTokens.emplace_back(grs_lexer::TokenType::ENDOFFILE, "", end.getLine(), end.getColumn());
 
         if(!match({grs_lexer::TokenType::END})){
             addError({"Expected 'END' after function body"});
             return nullptr;
         }
-        return body;
+
+        return arena_->make<grs_ast::FunctionDeclaration>(functionName, std::move(parameters), returnType,
+                                                          std::move(bodyTokens), this, *arena_, location);
+}
+
+grs_ast::FunctionBlock* Parser::parseBody(grs_ast::FunctionDeclaration& function){
+    // called on first use, usually long after parse(); leave the parser as found
+    auto* outerTokens = tokens_;
+    auto* outerArena = arena_;
+
+    const auto& bodyTokens = function.getBodyTokens();
+    grs_lexer::TokenStream stream(bodyTokens.data(), bodyTokens.size());
+    tokens_ = &stream;
+    arena_ = &function.getArena();
+    if(trace_) *trace_ << "Parsing body of " << function.getName() << '\n';
+
+    grs_ast::FunctionBlock* body = nullptr;
+    try{
+        body = static_cast<grs_ast::FunctionBlock*>(block());
+        // block() stops early at a stray ENDIF, ENDFOR, ENDWHILE, UNTIL, ELSE,
+        // CASE, DEFAULT or ENDSWITCH
+        if(!isAtEnd()){
+            addError({"Expected 'END' after function body"});
+            body = nullptr;
+        }
+    } catch(const std::exception& e){
+        std::cerr << " Error during parsing: "<<e.what()<<std::endl;
+        body = nullptr;
+    }
+
+    tokens_ = outerTokens;
+    arena_ = outerArena;
+    return body;
 }
 
-std::shared_ptr<grs_ast::ASTNode> Parser::variableDeclaration(){
+grs_ast::ASTNode* Parser::variableDeclaration(){
     //type control
     grs_lexer::TokenType dataType;
 
@@ -160,15 +282,15 @@ std::shared_ptr<grs_ast::ASTNode> Parser::variableDeclaration(){
         return nullptr;
     }
     
-    eraseFirstPosition();
+    markLocation();
 
     if(!check(grs_lexer::TokenType::IDENTIFIER)){
         addError("Expected variable name");
         return nullptr;
     }
-    std::string name = advance().getValue();
+    std::string name(advance().getValue());
 
-    std::shared_ptr<grs_ast::Expression> initializer = nullptr;
+    grs_ast::Expression* initializer = nullptr;
     if(match({grs_lexer::TokenType::ASSIGN})){
         initializer = expression();
     }
@@ -177,27 +299,27 @@ std::shared_ptr<grs_ast::ASTNode> Parser::variableDeclaration(){
         addError("Expected end of line after variable declaration");
     }
 
-    return std::make_shared<grs_ast::VariableDeclaration>(dataType, name, initializer, lineAndColumn_);
+    return arena_->make<grs_ast::VariableDeclaration>(dataType, name, initializer, location_);
 }
 
-std::shared_ptr<grs_ast::ASTNode> Parser::frameDeclaration(){
+grs_ast::ASTNode* Parser::frameDeclaration(){
 
     return parserDeclaration<grs_ast::FrameDeclaration>("FRAME");
 }
 
-std::shared_ptr<grs_ast::ASTNode> Parser::positionDeclaration(){
+grs_ast::ASTNode* Parser::positionDeclaration(){
    
     return parserDeclaration<grs_ast::PositionDeclaration>("POSITION");
 }
 
 
-std::shared_ptr<grs_ast::ASTNode> Parser::axisDeclaration(){
+grs_ast::ASTNode* Parser::axisDeclaration(){
    
    return parserDeclaration<grs_ast::AxisDeclaration>("AXIS");
 }
 
 
-std::shared_ptr<grs_ast::ASTNode> Parser::statement(){
+grs_ast::ASTNode* Parser::statement(){
     
     if(match({grs_lexer::TokenType::PTP,grs_lexer::TokenType::PTP_REL, grs_lexer::TokenType::LIN,grs_lexer::TokenType::LIN_REL,
      grs_lexer::TokenType::CIRC,grs_lexer::TokenType::CIRC_REL, grs_lexer::TokenType::SPLINE,grs_lexer::TokenType::SPLINE_REL})){
@@ -206,14 +328,26 @@ std::shared_ptr<grs_ast::ASTNode> Parser::statement(){
     else if(match({grs_lexer::TokenType::IF})){
         return ifStatement();
     }
+    else if(match({grs_lexer::TokenType::FOR})){
+        return forStatement();
+    }
+    else if(match({grs_lexer::TokenType::WHILE})){
+        return whileStatement();
+    }
+    else if(match({grs_lexer::TokenType::REPEAT})){
+        return repeatStatement();
+    }
+    else if(match({grs_lexer::TokenType::SWITCH})){
+        return switchStatement();
+    }
     else if(match({grs_lexer::TokenType::RETURN})){
         return returnStatement();
     }
     else if(match({grs_lexer::TokenType::WAIT})){
         return waitStatement();
     }
-    else if(std::string posName = previous().getValue(); match({grs_lexer::TokenType::ARROW})){
-        return parserExpression(posName);
+    else if(const grs_lexer::Token& posToken = previous(); match({grs_lexer::TokenType::ARROW})){
+        return parserExpression(std::string(posToken.getValue()));
     }
     else if(match({grs_lexer::TokenType::ENDOFLINE})){
         return nullptr;
@@ -223,27 +357,27 @@ std::shared_ptr<grs_ast::ASTNode> Parser::statement(){
 }
 
 
-std::shared_ptr<grs_ast::ASTNode> Parser::motionCommand(){ 
+grs_ast::ASTNode* Parser::motionCommand(){ 
     std::string motionCommandName = static_cast<std::string>(grs_lexer::typeToStringMap.at(previous().getType()));
     
 
-    eraseFirstPosition();
+    markLocation();
     if(!check(grs_lexer::TokenType::IDENTIFIER)){
         addError("Expected position name after motion command");
         return nullptr;
     }
 
-    std::string positionName = advance().getValue();
-    std::vector<std::pair<std::string, std::shared_ptr<grs_ast::Expression>>> arguments;
-    arguments.emplace_back("position", std::make_shared<grs_ast::VariableExpression>(positionName));
-    return std::make_shared<grs_ast::MotionCommand>(motionCommandName, positionName, arguments, lineAndColumn_);
+    std::string positionName(advance().getValue());
+    std::vector<std::pair<std::string, grs_ast::Expression*>> arguments;
+    arguments.emplace_back("position", arena_->make<grs_ast::VariableExpression>(positionName));
+    return arena_->make<grs_ast::MotionCommand>(motionCommandName, positionName, arguments, location_);
 
 }
 
- std::shared_ptr<grs_ast::ASTNode> Parser::parserExpression(const std::string& posName){
+ grs_ast::ASTNode* Parser::parserExpression(const std::string& posName){
     
-    eraseFirstPosition();
-    std::string paramName = peek().getValue();
+    markLocation();
+    std::string paramName(peek().getValue());
 
     if(!match({grs_lexer::TokenType::IDENTIFIER})){
         addError("Expected position name before arrow operator");
@@ -257,19 +391,27 @@ std::shared_ptr<grs_ast::ASTNode> Parser::motionCommand(){
 
     auto expr = assignment();
 
-    return std::make_shared<grs_ast::ExecutePosAndAxisExpression>(posName,paramName,expr);
+    return arena_->make<grs_ast::ExecutePosAndAxisExpression>(posName,paramName,expr,location_);
     
 }
 
-std::shared_ptr<grs_ast::ASTNode> Parser::waitStatement(){
+grs_ast::ASTNode* Parser::waitStatement(){
 
-    eraseFirstPosition();
+    markLocation();
     if(!match({grs_lexer::TokenType::LPAREN})){
         addError("Expected wait command after '(' ");
         return nullptr;
     }
     
-    auto val = std::stod(advance().getValue());
+    if(!match({grs_lexer::TokenType::INTEGER, grs_lexer::TokenType::FLOAT})){
+        addError("Expected numeric time inside WAIT()");
+        return nullptr;
+    }
+    double val = previous().getReal();
+    if(!std::isfinite(val)){
+        addError("Numeric literal out of range");
+        return nullptr;
+    }
 
     if(!match({grs_lexer::TokenType::RPAREN})){
         addError("Expected literal time expression after ')'");
@@ -277,13 +419,15 @@ std::shared_ptr<grs_ast::ASTNode> Parser::waitStatement(){
     }
 
 
-    return std::make_shared<grs_ast::WaitStatement>(val, lineAndColumn_);
+    return arena_->make<grs_ast::WaitStatement>(val, location_);
 
 }
 
-std::shared_ptr<grs_ast::ASTNode> Parser::ifStatement(){
+grs_ast::ASTNode* Parser::ifStatement(){
 
-    eraseFirstPosition();
+    markLocation();
+    // the branches mark their own statements
+    const common::LocationId location = location_;
     auto condition = expression();
   
     if(!match({grs_lexer::TokenType::THEN})){
@@ -299,7 +443,7 @@ std::shared_ptr<grs_ast::ASTNode> Parser::ifStatement(){
 
   auto thenBrance = block();
 
-  std::shared_ptr<grs_ast::ASTNode> elseBranch = nullptr;
+  grs_ast::ASTNode* elseBranch = nullptr;
 
   if(match({grs_lexer::TokenType::ELSE})){
     if(!match({grs_lexer::TokenType::ENDOFLINE}))
@@ -315,37 +459,212 @@ std::shared_ptr<grs_ast::ASTNode> Parser::ifStatement(){
     return nullptr;
 }
 
-return std::make_shared<grs_ast::IfStatement>(condition, thenBrance, elseBranch, lineAndColumn_);
+return arena_->make<grs_ast::IfStatement>(condition, thenBrance, elseBranch, location);
 
 }
 
-std::shared_ptr<grs_ast::ASTNode> Parser::returnStatement(){
+// FOR counter = start TO end [STEP step]; like KRL, the step is an integer
+// constant, so the direction of the loop is known before it runs
+grs_ast::ASTNode* Parser::forStatement(){
 
-    
-return nullptr;
+    markLocation();
+    const common::LocationId location = location_;
+    if(!check(grs_lexer::TokenType::IDENTIFIER)){
+        addError("Expected counter name after 'FOR'");
+        return nullptr;
+    }
+    std::string counter(advance().getValue());
+
+    if(!match({grs_lexer::TokenType::EQUAL, grs_lexer::TokenType::ASSIGN})){
+        addError("Expected '=' after FOR counter");
+        return nullptr;
+    }
+    auto start = expression();
+
+    if(!match({grs_lexer::TokenType::TO})){
+        addError("Expected 'TO' after FOR start value");
+        return nullptr;
+    }
+    auto end = expression();
+
+    std::int32_t step = 1;
+    if(match({grs_lexer::TokenType::STEP})){
+        if(!integerConstant("STEP", step)){
+            return nullptr;
+        }
+        if(step == 0){
+            addError("FOR STEP cannot be 0");
+            return nullptr;
+        }
+    }
+
+    if(!match({grs_lexer::TokenType::ENDOFLINE})){
+        addError("Expected 'ENDOFLINE' after FOR header");
+        return nullptr;
+    }
+
+    auto body = block();
+
+    if(!match({grs_lexer::TokenType::ENDFOR})){
+        addError("Expected 'ENDFOR' to close FOR loop");
+        return nullptr;
+    }
+    return arena_->make<grs_ast::ForStatement>(counter, start, end, step, body, location);
+}
+
+grs_ast::ASTNode* Parser::whileStatement(){
+
+    markLocation();
+    const common::LocationId location = location_;
+    auto condition = expression();
+
+    if(!match({grs_lexer::TokenType::ENDOFLINE})){
+        addError("Expected 'ENDOFLINE' after 'WHILE' condition");
+        return nullptr;
+    }
+
+    auto body = block();
+
+    if(!match({grs_lexer::TokenType::ENDWHILE})){
+        addError("Expected 'ENDWHILE' to close WHILE loop");
+        return nullptr;
+    }
+    return arena_->make<grs_ast::WhileStatement>(condition, body, location);
+}
+
+grs_ast::ASTNode* Parser::repeatStatement(){
+
+    markLocation();
+    const common::LocationId location = location_;
+    if(!match({grs_lexer::TokenType::ENDOFLINE})){
+        addError("Expected 'ENDOFLINE' after 'REPEAT'");
+        return nullptr;
+    }
+
+    auto body = block();
+
+    if(!match({grs_lexer::TokenType::UNTIL})){
+        addError("Expected 'UNTIL' to close REPEAT loop");
+        return nullptr;
+    }
+    auto condition = expression();
+    return arena_->make<grs_ast::RepeatStatement>(body, condition, location);
+}
+
+// SWITCH selector, then CASE blocks (each listing integer constants) and
+// an optional last DEFAULT block, then ENDSWITCH
+grs_ast::ASTNode* Parser::switchStatement(){
+
+    markLocation();
+    const common::LocationId location = location_;
+    auto selector = expression();
+
+    if(!match({grs_lexer::TokenType::ENDOFLINE})){
+        addError("Expected 'ENDOFLINE' after 'SWITCH' selector");
+        return nullptr;
+    }
+    while(match({grs_lexer::TokenType::ENDOFLINE})){}
+
+    std::vector<grs_ast::SwitchStatement::Case> cases;
+    std::unordered_set<std::int32_t> seen;
+    while(match({grs_lexer::TokenType::CASE})){
+        grs_ast::SwitchStatement::Case branch;
+        do{
+            std::int32_t value = 0;
+            if(!integerConstant("CASE", value)){
+                return nullptr;
+            }
+            if(!seen.insert(value).second){
+                addError("Duplicate CASE value " + std::to_string(value));
+                return nullptr;
+            }
+            branch.values.push_back(value);
+        } while(match({grs_lexer::TokenType::COMMA}));
+
+        if(!match({grs_lexer::TokenType::ENDOFLINE})){
+            addError("Expected 'ENDOFLINE' after CASE values");
+            return nullptr;
+        }
+        branch.body = block();
+        cases.push_back(std::move(branch));
+    }
+
+    grs_ast::ASTNode* defaultBody = nullptr;
+    if(match({grs_lexer::TokenType::DEFAULT})){
+        if(!match({grs_lexer::TokenType::ENDOFLINE})){
+            addError("Expected 'ENDOFLINE' after 'DEFAULT'");
+            return nullptr;
+        }
+        defaultBody = block();
+    }
+
+    if(!match({grs_lexer::TokenType::ENDSWITCH})){
+        addError(cases.empty() && !defaultBody ? "Expected 'CASE' after SWITCH selector"
+                                               : "Expected 'ENDSWITCH' to close SWITCH");
+        return nullptr;
+    }
+    return arena_->make<grs_ast::SwitchStatement>(selector, std::move(cases), defaultBody, location);
 }
 
-std::shared_ptr<grs_ast::ASTNode> Parser::expressionStatement(){
+// [-]INTEGER, as a FOR STEP or CASE value
+bool Parser::integerConstant(const std::string& after, std::int32_t& value){
+    const bool negative = match({grs_lexer::TokenType::MINUS});
+    if(!match({grs_lexer::TokenType::INTEGER})){
+        addError("Expected integer constant after '" + after + "'");
+        return false;
+    }
+    const std::int64_t magnitude = previous().getInteger();
+    if(magnitude > std::numeric_limits<int>::max()){
+        addError("Integer literal out of range");
+        return false;
+    }
+    value = static_cast<std::int32_t>(negative ? -magnitude : magnitude);
+    return true;
+}
+
+// RETURN [value]
+grs_ast::ASTNode* Parser::returnStatement(){
+    markLocation();
+    const common::LocationId location = location_;
+    grs_ast::Expression* value = nullptr;
+    if(!check(grs_lexer::TokenType::ENDOFLINE) && !isAtEnd()){
+        value = expression();
+    }
+    return arena_->make<grs_ast::ReturnStatement>(value, location);
+}
+
+grs_ast::ASTNode* Parser::expressionStatement(){
+    markLocation();
     auto expr = expression();
     return expr;
 }
 
 
-std::shared_ptr<grs_ast::ASTNode> Parser::block(){
-    std::vector<std::shared_ptr<grs_ast::ASTNode>> statements;
+grs_ast::ASTNode* Parser::block(){
+    std::vector<grs_ast::ASTNode*> statements;
 
     while(!check(grs_lexer::TokenType::ENDFOR) && 
+          !check(grs_lexer::TokenType::ENDWHILE) &&
+          !check(grs_lexer::TokenType::UNTIL)  &&
+          !check(grs_lexer::TokenType::CASE)   &&
+          !check(grs_lexer::TokenType::DEFAULT) &&
+          !check(grs_lexer::TokenType::ENDSWITCH) &&
           !check(grs_lexer::TokenType::ENDIF)  &&
           !check(grs_lexer::TokenType::ELSE)   &&
           !check(grs_lexer::TokenType::END)    &&
           !isAtEnd()) {
 
+            const size_t start = tokens_->position();
             auto stmt = declaration();
             if(stmt){
                 statements.push_back(stmt);
             }
+            // same forward-progress guard as parseDeclaration()
+            if(tokens_->position() == start){
+                advance();
+            }
         }
-    return std::make_shared<grs_ast::FunctionBlock>(statements);
+    return arena_->make<grs_ast::FunctionBlock>(statements);
 }
 
 
@@ -353,21 +672,18 @@ std::shared_ptr<grs_ast::ASTNode> Parser::block(){
 
  //recursive descent Expression
  
-std::shared_ptr<grs_ast::Expression> Parser::expression(){
-    std::cout << "expression() called \n";
+grs_ast::Expression* Parser::expression(){
+    if(trace_) *trace_ << "expression() called \n";
 
     return assignment();
 }
 
-std::shared_ptr<grs_ast::Expression> Parser::assignment(){
-    auto expr = logicalOr();
+grs_ast::Expression* Parser::assignment(){
+    auto expr = binary(1);
     if(match({grs_lexer::TokenType::ASSIGN})){
-        grs_lexer::Token equals = previous();
         auto value = assignment();
-        if(auto varExpr = std::reinterpret_pointer_cast<grs_ast::VariableExpression>(expr)){
-            return std::make_shared<grs_ast::BinaryExpression>(grs_lexer::TokenType::ASSIGN,
-                                                                                    std::move(expr), 
-                                                                                    std::move(value));
+        if(dynamic_cast<grs_ast::VariableExpression*>(expr)){
+            return arena_->make<grs_ast::BinaryExpression>(grs_lexer::TokenType::ASSIGN, expr, value, location_);
         }
         
         addError("Invalid assignment target");
@@ -376,127 +692,132 @@ std::shared_ptr<grs_ast::Expression> Parser::assignment(){
     return expr;
 }
 
-std::shared_ptr<grs_ast::Expression> Parser::logicalOr(){
-    auto expr = logicalAnd();
-
-    while(match({grs_lexer::TokenType::OR})){
-        grs_lexer::Token op = previous();
-        auto right = logicalAnd();
-        expr = std::make_shared<grs_ast::BinaryExpression>(op.getType(), std::move(expr), std::move(right));
-    }
-    
-    return expr;
-}
-
-std::shared_ptr<grs_ast::Expression> Parser::logicalAnd(){
-    auto expr = equality();
-
-    while(match({grs_lexer::TokenType::AND})){
-        grs_lexer::Token op = previous();
-        auto right = equality();
-        expr = std::make_shared<grs_ast::BinaryExpression>(op.getType(), std::move(expr), std::move(right));
-    }
-
-    return expr;
-}
+namespace {
 
+// Binding power of each binary operator; 0 means "not a binary operator".
+// All levels are left-associative: OR < AND < equality < comparison < term < factor
+constexpr size_t TOKEN_TYPE_COUNT = static_cast<size_t>(grs_lexer::TokenType::INVALID) + 1;
 
-std::shared_ptr<grs_ast::Expression> Parser::equality(){
-    auto expr = comparison();
-
-    while (match({grs_lexer::TokenType::EQUAL, grs_lexer::TokenType::NOTEQUAL})){
-        grs_lexer::Token op = previous();
-        auto right = comparison();
-        expr = std::make_shared<grs_ast::BinaryExpression>(op.getType(), std::move(expr),std::move(right));
-    }
-    
-    return expr;
-    
+constexpr std::array<uint8_t, TOKEN_TYPE_COUNT> makePrecedenceTable(){
+    std::array<uint8_t, TOKEN_TYPE_COUNT> table{};
+    auto set = [&table](grs_lexer::TokenType type, uint8_t precedence){
+        table[static_cast<size_t>(type)] = precedence;
+    };
+    set(grs_lexer::TokenType::OR, 1);
+    set(grs_lexer::TokenType::AND, 2);
+    set(grs_lexer::TokenType::EQUAL, 3);
+    set(grs_lexer::TokenType::NOTEQUAL, 3);
+    set(grs_lexer::TokenType::LESS, 4);
+    set(grs_lexer::TokenType::GREATER, 4);
+    set(grs_lexer::TokenType::LESSEQ, 4);
+    set(grs_lexer::TokenType::GREATEREQ, 4);
+    set(grs_lexer::TokenType::PLUS, 5);
+    set(grs_lexer::TokenType::MINUS, 5);
+    set(grs_lexer::TokenType::MULTIPLY, 6);
+    set(grs_lexer::TokenType::DIVIDE, 6);
+    return table;
 }
 
-std::shared_ptr<grs_ast::Expression> Parser::comparison(){
-    auto expr = term();
+constexpr auto binaryPrecedence = makePrecedenceTable();
 
-    while(match({grs_lexer::TokenType::LESS, grs_lexer::TokenType::GREATER,
-                grs_lexer::TokenType::LESSEQ,grs_lexer::TokenType::GREATEREQ})){
-                    grs_lexer::Token op = previous();
-                    auto right = term();
-                    expr = std::make_shared<grs_ast::BinaryExpression>(op.getType(), std::move(expr), std::move(right));
-                }
-                return expr;
 }
 
+// Precedence climbing: one loop handles every binary level, so a literal
+// costs a single binary() -> unary() -> primary() descent
+grs_ast::Expression* Parser::binary(int minPrecedence){
+    auto left = unary();
 
-
-std::shared_ptr<grs_ast::Expression> Parser::term(){
-    auto expr = factor();
-    while (match({grs_lexer::TokenType::PLUS, grs_lexer::TokenType::MINUS}))
-    {
-        grs_lexer::Token op = previous();
-        auto right = factor();
-        expr = std::make_shared<grs_ast::BinaryExpression>(op.getType(), std::move(expr), std::move(right));
-    }
-    return expr;
-    
-}
-std::shared_ptr<grs_ast::Expression> Parser::factor(){
-    auto expr = unary();
-
-    while (match({grs_lexer::TokenType::MULTIPLY, grs_lexer::TokenType::DIVIDE}))
-    {
-        grs_lexer::Token op = previous();
-        auto right = unary();
-        expr = std::make_shared<grs_ast::BinaryExpression>(op.getType(), std::move(expr),std::move(right));
+    while(!isAtEnd()){
+        const grs_lexer::TokenType op = peek().getType();
+        const int precedence = binaryPrecedence[static_cast<size_t>(op)];
+        if(precedence == 0 || precedence < minPrecedence){
+            break;
+        }
+        advance();
+        auto right = binary(precedence + 1);
+        left = arena_->make<grs_ast::BinaryExpression>(op, left, right);
     }
-    return expr;    
+    return left;
 }
 
 
-std::shared_ptr<grs_ast::Expression> Parser::unary(){
+grs_ast::Expression* Parser::unary(){
     if(match({grs_lexer::TokenType::MINUS, grs_lexer::TokenType::NOT})){
-        grs_lexer::Token op = previous();
+        const grs_lexer::TokenType op = previous().getType();
         auto right = unary();
-        return std::make_shared<grs_ast::UnaryExpression>(op.getType(), std::move(right));
+        return arena_->make<grs_ast::UnaryExpression>(op, right);
     }
     return primary();
 }
 
-std::shared_ptr<grs_ast::Expression> Parser::primary(){
-    std::cout << "primary() called: " << peek().getValue()
-       << " (Type: " << grs_lexer::typeToStringMap.at(peek().getType()) << ")" << std::endl;
+// name( was read: the arguments and the closing ')'
+grs_ast::Expression* Parser::call(const std::string& name){
+    std::vector<grs_ast::Expression*> args;
+    if(!check(grs_lexer::TokenType::RPAREN)){
+        do{
+            args.push_back(expression());
+        } while(match({grs_lexer::TokenType::COMMA}));
+    }
+    if(!match({grs_lexer::TokenType::RPAREN})){
+        addError("Expected ')' after arguments");
+        return nullptr;
+    }
+    return arena_->make<grs_ast::CallExpression>(name, std::move(args), location_);
+}
+
+grs_ast::Expression* Parser::primary(){
+    if(trace_){
+        *trace_ << "primary() called: " << peek().getValue()
+                << " (Type: " << grs_lexer::typeToStringMap.at(peek().getType()) << ")" << '\n';
+    }
 
     if(match({grs_lexer::TokenType::GFALSE, grs_lexer::TokenType::GTRUE}))
     {
         bool value = previous().getType() == grs_lexer::TokenType::GTRUE;
-        return std::make_shared<grs_ast::LiteraExpression>(value);
+        return arena_->make<grs_ast::LiteraExpression>(value);
     }
 
 
    if(match({grs_lexer::TokenType::INTEGER})) {
-        int value = std::stoi(previous().getValue());
-        return std::make_shared<grs_ast::LiteraExpression>(value);
+        std::int64_t value = previous().getInteger();
+        if (value > std::numeric_limits<int>::max()) {
+            addError("Integer literal out of range");
+            return nullptr;
+        }
+        return arena_->make<grs_ast::LiteraExpression>(static_cast<int>(value));
     }
 
      if (match({grs_lexer::TokenType::FLOAT}))
     {
-        double value = std::stod(std::string(previous().getValue()));
-        return std::make_shared<grs_ast::LiteraExpression>(value);
+        double value = previous().getReal();
+        if (!std::isfinite(value)) {
+            addError("Numeric literal out of range");
+            return nullptr;
+        }
+        return arena_->make<grs_ast::LiteraExpression>(value);
+    }
+
+    if (match({grs_lexer::TokenType::PI}))
+    {
+        return arena_->make<grs_ast::LiteraExpression>(3.14159265358979323846);
     }
     
     if (match({grs_lexer::TokenType::STRING}))
     {
-        std::string value = previous().getValue();
+        std::string_view quoted = previous().getValue();
         
-        if(value.size() >= 2){
-            value = value.substr(1, value.size()- 2);
-        }
-        return std::make_shared<grs_ast::LiteraExpression>(value);
+        std::string value(quoted.size() >= 2 ? quoted.substr(1, quoted.size() - 2) : quoted);
+        return arena_->make<grs_ast::LiteraExpression>(value);
 
     }
     
     if (match({grs_lexer::TokenType::IDENTIFIER}))
     {
-        return std::make_shared<grs_ast::VariableExpression>(std::string(previous().getValue()));
+        std::string name(previous().getValue());
+        if(match({grs_lexer::TokenType::LPAREN})){
+            return call(name);
+        }
+        return arena_->make<grs_ast::VariableExpression>(std::move(name));
     }
 
     if(match({grs_lexer::TokenType::LPAREN}))
@@ -0,0 +1,106 @@
+#include "vm/bytecode.hpp"
+#include "lexer/token.hpp"
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+
+namespace grs_vm{
+
+const char* opCodeName(OpCode op){
+    switch(op){
+#define GRS_VM_NAME(name) case OpCode::name: return #name;
+        GRS_VM_OPCODES(GRS_VM_NAME)
+#undef GRS_VM_NAME
+    }
+    return "?";
+}
+
+std::int32_t fieldIndex(const std::string& member){
+    static const char* const names[] = {"x", "y", "z", "a", "b", "c", "a1", "a2", "a3", "a4", "a5", "a6"};
+    std::string lower(member);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char ch){ return static_cast<char>(std::tolower(ch)); });
+    for(std::int32_t i = 0; i < 12; ++i){
+        if(lower == names[i]){
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char* fieldName(std::int32_t field){
+    static const char* const names[] = {"x", "y", "z", "a", "b", "c", "A1", "A2", "A3", "A4", "A5", "A6"};
+    return field >= 0 && field < 12 ? names[field] : "?";
+}
+
+void disassemble(const Chunk& chunk, std::ostream& out){
+    for(size_t i = 0; i < chunk.code.size(); ++i){
+        const Instr& instr = chunk.code[i];
+        out << std::setw(5) << i << "  " << std::left << std::setw(12) << opCodeName(instr.op) << std::right
+            << static_cast<int>(instr.a) << ' ' << instr.b << ' ' << instr.c;
+        switch(instr.op){
+            case OpCode::LOADK:
+            case OpCode::WAIT:
+                out << "\t; ";
+                std::visit([&out](const auto& value){ out << value; }, chunk.pool.toValueType(chunk.constants[instr.b]));
+                break;
+            case OpCode::GETVAR:
+            case OpCode::SETVAR:
+            case OpCode::GETVAR_INT:
+            case OpCode::GETVAR_REAL:
+            case OpCode::GETVAR_BOOL:
+            case OpCode::SETVAR_INT:
+            case OpCode::SETVAR_REAL:
+            case OpCode::SETVAR_BOOL:
+            case OpCode::DECL:
+            case OpCode::DECL_INIT:
+            case OpCode::DECL_STRUCT:
+                out << "\t; " << chunk.slotNames[instr.b];
+                break;
+            case OpCode::SETFIELD:
+                out << "\t; " << chunk.slotNames[instr.b] << "->" << fieldName(instr.c);
+                break;
+            case OpCode::MOTION:
+                out << "\t; " << grs_lexer::typeToStringMap.at(static_cast<grs_lexer::TokenType>(instr.c))
+                    << ' ' << chunk.slotNames[instr.b];
+                break;
+            case OpCode::JMP:
+            case OpCode::JMPF:
+            case OpCode::JMPZ:
+                out << "\t; -> " << static_cast<std::int64_t>(i) + 1 + instr.c;
+                break;
+            case OpCode::FORPREP:
+            case OpCode::FORLOOP:
+                out << "\t; " << chunk.slotNames[instr.b] << " -> " << static_cast<std::int64_t>(i) + 1 + instr.c;
+                break;
+            case OpCode::CALL:
+                out << "\t; " << chunk.functions[instr.c].name << " -> ";
+                if(instr.b == UNRESOLVED){
+                    out << "unresolved";
+                } else {
+                    out << instr.b;
+                }
+                break;
+            case OpCode::JMPTABLE:
+            case OpCode::JMPSEARCH:{
+                const SwitchTable& table = chunk.switches[instr.b];
+                out << "\t;";
+                for(size_t entry = 0; entry < table.targets.size(); ++entry){
+                    const std::int64_t value = instr.op == OpCode::JMPTABLE
+                                             ? static_cast<std::int64_t>(table.low) + static_cast<std::int64_t>(entry)
+                                             : table.keys[entry];
+                    if(table.targets[entry] != table.defaultTarget){
+                        out << ' ' << value << " -> " << table.targets[entry] << ',';
+                    }
+                }
+                out << " default -> " << table.defaultTarget;
+                break;
+            }
+            default:
+                break;
+        }
+        out << '\n';
+    }
+}
+
+}
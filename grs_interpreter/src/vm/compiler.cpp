@@ -0,0 +1,812 @@
+#include "vm/compiler.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include "interpreter/instruction.hpp"
+
+namespace grs_vm{
+
+namespace {
+
+OpCode binaryOpCode(grs_lexer::TokenType op){
+    switch(op){
+        case grs_lexer::TokenType::PLUS:      return OpCode::ADD;
+        case grs_lexer::TokenType::MINUS:     return OpCode::SUB;
+        case grs_lexer::TokenType::MULTIPLY:  return OpCode::MUL;
+        case grs_lexer::TokenType::DIVIDE:    return OpCode::DIV;
+        case grs_lexer::TokenType::LESS:      return OpCode::LT;
+        case grs_lexer::TokenType::LESSEQ:    return OpCode::LE;
+        case grs_lexer::TokenType::GREATER:   return OpCode::GT;
+        case grs_lexer::TokenType::GREATEREQ: return OpCode::GE;
+        case grs_lexer::TokenType::EQUAL:     return OpCode::EQ;
+        case grs_lexer::TokenType::NOTEQUAL:  return OpCode::NE;
+        case grs_lexer::TokenType::AND:       return OpCode::AND;
+        case grs_lexer::TokenType::OR:        return OpCode::OR;
+        default:
+            throw std::runtime_error("Unsupported binary operator: " + std::to_string(static_cast<int>(op)));
+    }
+}
+
+// the same operation on operands known to be doubles
+OpCode numberForm(OpCode op){
+    switch(op){
+        case OpCode::ADD: return OpCode::ADD_F;
+        case OpCode::SUB: return OpCode::SUB_F;
+        case OpCode::MUL: return OpCode::MUL_F;
+        case OpCode::DIV: return OpCode::DIV_F;
+        case OpCode::LT:  return OpCode::LT_F;
+        case OpCode::LE:  return OpCode::LE_F;
+        case OpCode::GT:  return OpCode::GT_F;
+        case OpCode::GE:  return OpCode::GE_F;
+        case OpCode::EQ:  return OpCode::EQ_F;
+        case OpCode::NE:  return OpCode::NE_F;
+        case OpCode::AND: return OpCode::AND_F;
+        case OpCode::OR:  return OpCode::OR_F;
+        case OpCode::NOT: return OpCode::NOT_F;
+        case OpCode::NEG: return OpCode::NEG_F;
+        default:          return op;
+    }
+}
+
+bool isNumber(const grs_ast::Expression* expr){
+    if(!expr){
+        return false;
+    }
+    const auto type = expr->getStaticType();
+    return type == grs_lexer::TokenType::INT || type == grs_lexer::TokenType::REAL || type == grs_lexer::TokenType::BOOL;
+}
+
+// a literal read as a number, as a folded condition is; a string is 0
+bool literalNumber(const grs_ast::Expression* expr, double& value){
+    auto literal = dynamic_cast<const grs_ast::LiteraExpression*>(expr);
+    if(!literal){
+        return false;
+    }
+    value = 0.0;
+    const auto& condition = literal->getValue();
+    if(auto val = std::get_if<double>(&condition)) value = *val;
+    else if(auto val = std::get_if<int>(&condition)) value = *val;
+    else if(auto val = std::get_if<bool>(&condition)) value = *val ? 1.0 : 0.0;
+    return true;
+}
+
+// a hoisted value takes a MOVE instead of its own instructions, which only
+// pays for an operator
+bool worthHoisting(const grs_ast::Expression* expr){
+    return expr->getType() == grs_ast::ASTNodeType::BinaryExpression ||
+           expr->getType() == grs_ast::ASTNodeType::UnaryExpression;
+}
+
+// loops stop hoisting once this many registers are live, leaving the rest
+// for the expressions of their body
+constexpr std::uint32_t HOIST_REGISTERS = 128;
+
+// a SWITCH gets a jump table while at least one in TABLE_FILL of its
+// entries is a CASE value; sparser ones search their sorted values
+constexpr std::int64_t TABLE_FILL = 4;
+
+}
+
+// Walks a loop: the variables it writes, whether it hands a command to the
+// executor, and every expression it evaluates, outermost first
+struct Compiler::LoopScan : public grs_ast::ASTVisitorBase{
+    std::unordered_set<std::string> written;
+    bool commands = false;
+    std::vector<grs_ast::Expression*> expressions;
+
+    void scan(grs_ast::ASTNode* node){
+        if(node){
+            node->accept(*this);
+        }
+    }
+    void evaluated(grs_ast::Expression* expr){
+        if(expr){
+            expressions.push_back(expr);
+            expr->accept(*this);
+        }
+    }
+    template<typename NodeType>
+    void structDeclaration(NodeType& node){
+        written.insert(node.getName());
+        for(const auto& arg : node.getArgs()){
+            evaluated(arg.second);
+        }
+    }
+
+    void visit(grs_ast::FunctionBlock& node) override{
+        for(auto* statement : node.getStatements()){
+            if(auto expr = dynamic_cast<grs_ast::Expression*>(statement)){
+                evaluated(expr);
+            } else {
+                scan(statement);
+            }
+        }
+    }
+    void visit(grs_ast::BinaryExpression& node) override{
+        if(node.getOperator() == grs_lexer::TokenType::ASSIGN){
+            if(auto variable = dynamic_cast<grs_ast::VariableExpression*>(node.getLeft())){
+                written.insert(variable->getName());
+            }
+        }
+        scan(node.getLeft());
+        scan(node.getRight());
+    }
+    void visit(grs_ast::UnaryExpression& node) override{ scan(node.getExpression());}
+    void visit(grs_ast::VariableDeclaration& node) override{
+        written.insert(node.getName());
+        evaluated(node.getInitializer());
+    }
+    void visit(grs_ast::FrameDeclaration& node) override{ structDeclaration(node);}
+    void visit(grs_ast::PositionDeclaration& node) override{ structDeclaration(node);}
+    void visit(grs_ast::AxisDeclaration& node) override{ structDeclaration(node);}
+    void visit(grs_ast::ExecutePosAndAxisExpression& node) override{
+        written.insert(node.getName());
+        evaluated(node.getExpr());
+    }
+    void visit(grs_ast::IfStatement& node) override{
+        evaluated(node.getCondition());
+        scan(node.getThenBranch());
+        scan(node.getElseBranch());
+    }
+    void visit(grs_ast::ForStatement& node) override{
+        written.insert(node.getCounter());
+        evaluated(node.getStart());
+        evaluated(node.getEnd());
+        scan(node.getBody());
+    }
+    void visit(grs_ast::WhileStatement& node) override{
+        evaluated(node.getCondition());
+        scan(node.getBody());
+    }
+    void visit(grs_ast::RepeatStatement& node) override{
+        scan(node.getBody());
+        evaluated(node.getCondition());
+    }
+    void visit(grs_ast::SwitchStatement& node) override{
+        evaluated(node.getSelector());
+        for(const auto& branch : node.getCases()){
+            scan(branch.body);
+        }
+        scan(node.getDefault());
+    }
+    void visit(grs_ast::MotionCommand&) override{ commands = true;}
+    void visit(grs_ast::WaitStatement&) override{ commands = true;}
+    // a DEF inside a loop is left alone, and so is the loop
+    void visit(grs_ast::FunctionDeclaration&) override{ commands = true;}
+    // so is a loop calling one: its body may write anything
+    void visit(grs_ast::CallExpression& node) override{
+        commands = true;
+        for(auto* arg : node.getArgs()){
+            scan(arg);
+        }
+    }
+    void visit(grs_ast::ReturnStatement& node) override{ evaluated(node.getValue());}
+};
+
+Chunk Compiler::compile(grs_ast::FunctionBlock* program){
+    chunk_ = Chunk{};
+    slots_.clear();
+    nextRegister_ = 0;
+    liveRegisters_ = 0;
+    entryCompiled_ = false;
+    conditional_ = 0;
+    declared_.clear();
+    hoisted_.clear();
+    locals_.clear();
+    inFunction_ = false;
+    declarations_ = grs_ast::functionTable(program);
+    functionIndex_.clear();
+    callees_.clear();
+    calls_.clear();
+    location_ = common::NO_LOCATION;
+    if(program){
+        program->accept(*this);
+    }
+    emit(OpCode::HALT, 0, 0, 0);
+    // compiling a DEF can add the ones it calls
+    for(std::uint32_t index = 0; index < chunk_.functions.size(); ++index){
+        compileFunction(index);
+    }
+    for(size_t at : calls_){
+        chunk_.code[at].b = chunk_.functions[static_cast<size_t>(chunk_.code[at].c)].entry;
+    }
+    return std::move(chunk_);
+}
+
+std::uint32_t Compiler::function(const std::string& name){
+    auto [it, inserted] = functionIndex_.try_emplace(name, static_cast<std::uint32_t>(chunk_.functions.size()));
+    if(inserted){
+        Function function;
+        function.name = name;
+        auto declaration = declarations_.find(name);
+        callees_.push_back(declaration != declarations_.end() ? declaration->second : nullptr);
+        if(auto callee = callees_.back()){
+            for(const auto& parameter : callee->getParameters()){
+                function.parameters.push_back(parameter.type);
+            }
+            function.returnType = callee->getReturnType();
+        }
+        chunk_.functions.push_back(std::move(function));
+    }
+    return it->second;
+}
+
+//   entry: <body>; RET
+void Compiler::compileFunction(std::uint32_t index){
+    grs_ast::FunctionDeclaration* callee = callees_[index];
+    if(!callee){
+        return;
+    }
+    locals_.clear();
+    declared_.clear();
+    hoisted_.clear();
+    nextRegister_ = 0;
+    liveRegisters_ = 0;
+    conditional_ = 0;
+    inFunction_ = true;
+    const auto firstLocal = static_cast<std::uint32_t>(chunk_.slotNames.size());
+    for(const auto& name : callee->getLocals()){
+        locals_.emplace(name, static_cast<std::uint32_t>(chunk_.slotNames.size()));
+        chunk_.slotNames.push_back(name);
+        chunk_.slotTypes.push_back(grs_lexer::TokenType::ENDOFFILE);
+    }
+    // the parameters come first and are declared by the CALL
+    for(std::uint32_t i = 0; i < callee->getParameters().size(); ++i){
+        declared_.insert(firstLocal + i);
+    }
+    Function& function = chunk_.functions[index];
+    function.entry = static_cast<std::uint32_t>(chunk_.code.size());
+    function.firstLocal = firstLocal;
+    function.localCount = static_cast<std::uint32_t>(chunk_.slotNames.size()) - firstLocal;
+    if(auto body = callee->getBody()){
+        body->accept(*this);
+    }
+    location_ = callee->getLocation();
+    emit(OpCode::RET, 0, 0, 0);
+    inFunction_ = false;
+}
+
+size_t Compiler::emit(OpCode op, std::uint8_t a, std::uint32_t b, std::int32_t c){
+    chunk_.code.push_back({op, a, b, c});
+    chunk_.locations.push_back(location_);
+    return chunk_.code.size() - 1;
+}
+
+void Compiler::patchJump(size_t at){
+    patchJump(at, chunk_.code.size());
+}
+
+void Compiler::patchJump(size_t at, size_t target){
+    chunk_.code[at].c = static_cast<std::int32_t>(target) - static_cast<std::int32_t>(at) - 1;
+}
+
+// the first mention of a variable, declaration or not, gives it its slot
+std::uint32_t Compiler::slot(const std::string& variable){
+    if(auto local = locals_.find(variable); local != locals_.end()){
+        return local->second;
+    }
+    auto [it, inserted] = slots_.try_emplace(variable, static_cast<std::uint32_t>(chunk_.slotNames.size()));
+    if(inserted){
+        chunk_.slotNames.push_back(variable);
+        chunk_.slotTypes.push_back(grs_lexer::TokenType::ENDOFFILE);
+    }
+    return it->second;
+}
+
+const std::uint32_t* Compiler::knownSlot(const std::string& variable)const{
+    if(auto local = locals_.find(variable); local != locals_.end()){
+        return &local->second;
+    }
+    auto it = slots_.find(variable);
+    return it != slots_.end() ? &it->second : nullptr;
+}
+
+// the typed form of a variable access, or `generic` when the variable's
+// type is not known; a slot reached through a typed form keeps that type
+OpCode Compiler::variableAccess(const grs_ast::Expression& variable, std::uint32_t slot, OpCode generic){
+    const bool get = generic == OpCode::GETVAR;
+    OpCode op = generic;
+    switch(variable.getStaticType()){
+        case grs_lexer::TokenType::INT:  op = get ? OpCode::GETVAR_INT : OpCode::SETVAR_INT; break;
+        case grs_lexer::TokenType::REAL: op = get ? OpCode::GETVAR_REAL : OpCode::SETVAR_REAL; break;
+        case grs_lexer::TokenType::BOOL: op = get ? OpCode::GETVAR_BOOL : OpCode::SETVAR_BOOL; break;
+        default:                         return generic;
+    }
+    chunk_.slotTypes[slot] = variable.getStaticType();
+    return op;
+}
+
+// literals are loaded the way the generator loads them: numbers and
+// booleans as doubles, strings unchanged
+std::uint32_t Compiler::constant(const common::ValueType& value){
+    if(auto val = std::get_if<int>(&value)){
+        chunk_.constants.emplace_back(static_cast<double>(*val));
+    } else if(auto val = std::get_if<bool>(&value)){
+        chunk_.constants.emplace_back(*val ? 1.0 : 0.0);
+    } else {
+        chunk_.constants.push_back(chunk_.pool.toValue(value));
+    }
+    return static_cast<std::uint32_t>(chunk_.constants.size() - 1);
+}
+
+std::uint8_t Compiler::allocate(){
+    if(nextRegister_ > UINT8_MAX){
+        throw std::runtime_error("Expression too complex: more than 256 registers needed");
+    }
+    const auto reg = static_cast<std::uint8_t>(nextRegister_++);
+    chunk_.registerCount = std::max(chunk_.registerCount, nextRegister_);
+    return reg;
+}
+
+void Compiler::expression(grs_ast::Expression* expr, std::uint8_t target){
+    if(!expr){
+        emit(OpCode::LOADK, target, constant(0.0), 0);
+        return;
+    }
+    if(auto it = hoisted_.find(expr); it != hoisted_.end()){
+        emit(OpCode::MOVE, target, it->second, 0);
+        return;
+    }
+    target_ = target;
+    expr->accept(*this);
+}
+
+void Compiler::visit(grs_ast::FunctionBlock& node){
+    for(const auto& statement : node.getStatements()){
+        if(!statement){
+            continue;
+        }
+        nextRegister_ = liveRegisters_;
+        if(auto expr = dynamic_cast<grs_ast::Expression*>(statement)){
+            location_ = expr->getLocation();
+            expression(expr, allocate());
+        } else {
+            statement->accept(*this);
+        }
+    }
+}
+
+// Only the first DEF is compiled; it is the module's main program
+void Compiler::visit(grs_ast::FunctionDeclaration& node){
+    if(entryCompiled_){
+        return;
+    }
+    entryCompiled_ = true;
+    if(auto body = node.getBody()){
+        body->accept(*this);
+    }
+}
+
+// <args> -> R[a], R[a+1], ...; CALL a, entry, function; MOVE target, a
+void Compiler::visit(grs_ast::CallExpression& node){
+    const std::uint8_t target = target_;
+    const std::uint32_t index = function(node.getName());
+    const auto& args = node.getArgs();
+    // a missing argument is 0, an extra one is evaluated and dropped
+    const size_t count = std::max(args.size(), chunk_.functions[index].parameters.size());
+    const std::uint8_t base = allocate();
+    for(size_t i = 1; i < count; ++i){
+        allocate();
+    }
+    for(size_t i = 0; i < count; ++i){
+        expression(i < args.size() ? args[i] : nullptr, static_cast<std::uint8_t>(base + i));
+    }
+    calls_.push_back(emit(OpCode::CALL, base, UNRESOLVED, static_cast<std::int32_t>(index)));
+    if(target != base){
+        emit(OpCode::MOVE, target, base, 0);
+    }
+    nextRegister_ = base;
+}
+
+// in a DEF: <value> -> R[r]; RET r, 1 (or RET 0, 0); in the main program
+// it ends the run
+void Compiler::visit(grs_ast::ReturnStatement& node){
+    location_ = node.getLocation();
+    std::uint8_t value = 0;
+    if(node.getValue()){
+        value = allocate();
+        expression(node.getValue(), value);
+    }
+    if(inFunction_){
+        emit(OpCode::RET, value, node.getValue() ? 1 : 0, 0);
+    } else {
+        emit(OpCode::HALT, 0, 0, 0);
+    }
+}
+
+void Compiler::visit(grs_ast::BinaryExpression& node){
+    const std::uint8_t target = target_;
+
+    if(node.getOperator() == grs_lexer::TokenType::ASSIGN){
+        auto varExpr = dynamic_cast<grs_ast::VariableExpression*>(node.getLeft());
+        if(!varExpr){
+            throw std::runtime_error("assignment left side must be a variable");
+        }
+        expression(node.getRight(), target);
+        const std::uint32_t variable = slot(varExpr->getName());
+        const OpCode op = isNumber(node.getRight()) ? variableAccess(*varExpr, variable, OpCode::SETVAR) : OpCode::SETVAR;
+        emit(op, target, variable, 0);
+        return;
+    }
+
+    OpCode op = binaryOpCode(node.getOperator());
+    if(isNumber(node.getLeft()) && isNumber(node.getRight())){
+        op = numberForm(op);
+    }
+    expression(node.getLeft(), target);
+    const std::uint8_t right = allocate();
+    expression(node.getRight(), right);
+    emit(op, target, target, right);
+    nextRegister_ = right;
+}
+
+void Compiler::visit(grs_ast::UnaryExpression& node){
+    const std::uint8_t target = target_;
+    expression(node.getExpression(), target);
+    OpCode op = node.getOperator() == grs_lexer::TokenType::MINUS ? OpCode::NEG : OpCode::NOT;
+    if(isNumber(node.getExpression())){
+        op = numberForm(op);
+    }
+    emit(op, target, target, 0);
+}
+
+void Compiler::visit(grs_ast::LiteraExpression& node){
+    emit(OpCode::LOADK, target_, constant(node.getValue()), 0);
+}
+
+void Compiler::visit(grs_ast::VariableExpression& node){
+    const std::uint32_t variable = slot(node.getName());
+    emit(variableAccess(node, variable, OpCode::GETVAR), target_, variable, 0);
+}
+
+void Compiler::visit(grs_ast::VariableDeclaration& node){
+    location_ = node.getLocation();
+    const auto type = static_cast<std::int32_t>(node.getDataType());
+    const std::uint32_t variable = slot(node.getName());
+    if(node.getInitializer()){
+        const std::uint8_t value = allocate();
+        expression(node.getInitializer(), value);
+        emit(OpCode::DECL_INIT, value, variable, type);
+    } else {
+        emit(OpCode::DECL, 0, variable, type);
+    }
+    if(conditional_ == 0){
+        declared_.insert(variable);
+    }
+}
+
+template<typename NodeType>
+void Compiler::structDeclaration(NodeType& node, grs_lexer::TokenType type){
+    location_ = node.getLocation();
+    const std::uint32_t variable = slot(node.getName());
+    // fields are evaluated before the variable exists, as in the generator
+    std::vector<std::pair<std::int32_t, std::uint8_t>> fields;
+    for(const auto& arg : node.getArgs()){
+        std::int32_t field = fieldIndex(arg.first);
+        const bool axisField = field >= 6;
+        if(field < 0 || axisField != (type == grs_lexer::TokenType::AXIS)){
+            continue;
+        }
+        const std::uint8_t value = allocate();
+        expression(arg.second, value);
+        fields.emplace_back(field, value);
+    }
+    emit(OpCode::DECL_STRUCT, 0, variable, static_cast<std::int32_t>(type));
+    for(const auto& [field, value] : fields){
+        emit(OpCode::SETFIELD, value, variable, field);
+    }
+}
+
+void Compiler::visit(grs_ast::PositionDeclaration& node){
+    structDeclaration(node, grs_lexer::TokenType::POS);
+}
+
+void Compiler::visit(grs_ast::FrameDeclaration& node){
+    structDeclaration(node, grs_lexer::TokenType::FRAME);
+}
+
+void Compiler::visit(grs_ast::AxisDeclaration& node){
+    structDeclaration(node, grs_lexer::TokenType::AXIS);
+}
+
+void Compiler::visit(grs_ast::ExecutePosAndAxisExpression& node){
+    location_ = node.getLocation();
+    const std::uint8_t value = allocate();
+    expression(node.getExpr(), value);
+    emit(OpCode::SETFIELD, value, slot(node.getName()), fieldIndex(node.getArg()));
+}
+
+void Compiler::visit(grs_ast::MotionCommand& node){
+    location_ = node.getLocation();
+    emit(OpCode::MOTION, 0, slot(node.getName()), static_cast<std::int32_t>(grs_interpreter::motionType(node.getCommand())));
+}
+
+void Compiler::visit(grs_ast::WaitStatement& node){
+    location_ = node.getLocation();
+    emit(OpCode::WAIT, 0, constant(node.waitTime_), 0);
+}
+
+void Compiler::visit(grs_ast::IfStatement& node){
+    location_ = node.getLocation();
+    // a condition the optimizer folded needs no jump; its dead branch is gone
+    if(double value = 0.0; literalNumber(node.getCondition(), value)){
+        grs_ast::ASTNode* taken = value != 0.0 ? node.getThenBranch() : node.getElseBranch();
+        if(taken){
+            ++conditional_;
+            taken->accept(*this);
+            --conditional_;
+        }
+        return;
+    }
+    const std::uint8_t condition = allocate();
+    expression(node.getCondition(), condition);
+    const size_t skipThen = emit(isNumber(node.getCondition()) ? OpCode::JMPZ : OpCode::JMPF, condition, 0, 0);
+    ++conditional_;
+    if(node.getThenBranch()){
+        node.getThenBranch()->accept(*this);
+    }
+    if(node.getElseBranch()){
+        location_ = node.getLocation();
+        const size_t skipElse = emit(OpCode::JMP, 0, 0, 0);
+        patchJump(skipThen);
+        node.getElseBranch()->accept(*this);
+        patchJump(skipElse);
+    } else {
+        patchJump(skipThen);
+    }
+    --conditional_;
+}
+
+// R[base] .. R[base + 2] hold the counter, end and step for the whole loop:
+//   start -> R[base]; end -> R[base+1]; step -> R[base+2]; <hoisted>
+//   FORPREP base, exit; body: <body>; FORLOOP base, body; exit:
+void Compiler::visit(grs_ast::ForStatement& node){
+    location_ = node.getLocation();
+    const std::uint32_t live = liveRegisters_;
+    const std::uint8_t base = allocate();
+    allocate();
+    allocate();
+    expression(node.getStart(), base);
+    expression(node.getEnd(), static_cast<std::uint8_t>(base + 1));
+    emit(OpCode::LOADK, static_cast<std::uint8_t>(base + 2), constant(static_cast<double>(node.getStep())), 0);
+
+    const auto hoisted = hoist(node.getBody(), nullptr, &node.getCounter());
+    const std::uint32_t counter = slot(node.getCounter());
+    const size_t prep = emit(OpCode::FORPREP, base, counter, 0);
+    ++conditional_;
+    if(node.getBody()){
+        node.getBody()->accept(*this);
+    }
+    --conditional_;
+    location_ = node.getLocation();
+    const size_t loop = emit(OpCode::FORLOOP, base, counter, 0);
+    patchJump(loop, prep + 1);
+    patchJump(prep);
+    endLoop(hoisted, live);
+}
+
+//   <hoisted>; top: <condition>; JMPZ exit; <body>; JMP top; exit:
+void Compiler::visit(grs_ast::WhileStatement& node){
+    location_ = node.getLocation();
+    double value = 0.0;
+    const bool folded = literalNumber(node.getCondition(), value);
+    if(folded && value == 0.0){
+        return;
+    }
+    const std::uint32_t live = liveRegisters_;
+    const auto hoisted = hoist(node.getBody(), folded ? nullptr : node.getCondition(), nullptr);
+    const size_t top = chunk_.code.size();
+    size_t exit = 0;
+    if(!folded){
+        const std::uint8_t condition = allocate();
+        expression(node.getCondition(), condition);
+        exit = emit(isNumber(node.getCondition()) ? OpCode::JMPZ : OpCode::JMPF, condition, 0, 0);
+    }
+    ++conditional_;
+    if(node.getBody()){
+        node.getBody()->accept(*this);
+    }
+    --conditional_;
+    location_ = node.getLocation();
+    patchJump(emit(OpCode::JMP, 0, 0, 0), top);
+    if(!folded){
+        patchJump(exit);
+    }
+    endLoop(hoisted, live);
+}
+
+//   <hoisted>; top: <body>; <condition>; JMPZ top
+void Compiler::visit(grs_ast::RepeatStatement& node){
+    location_ = node.getLocation();
+    double value = 0.0;
+    const bool folded = literalNumber(node.getCondition(), value);
+    const std::uint32_t live = liveRegisters_;
+    // UNTIL TRUE runs the body once: nothing to hoist
+    const auto hoisted = folded && value != 0.0 ? std::vector<const grs_ast::Expression*>{}
+                                                : hoist(node.getBody(), folded ? nullptr : node.getCondition(), nullptr);
+    const size_t top = chunk_.code.size();
+    ++conditional_;
+    if(node.getBody()){
+        node.getBody()->accept(*this);
+    }
+    --conditional_;
+    location_ = node.getLocation();
+    nextRegister_ = liveRegisters_;
+    if(!folded){
+        const std::uint8_t condition = allocate();
+        expression(node.getCondition(), condition);
+        patchJump(emit(isNumber(node.getCondition()) ? OpCode::JMPZ : OpCode::JMPF, condition, 0, 0), top);
+    } else if(value == 0.0){
+        patchJump(emit(OpCode::JMP, 0, 0, 0), top);
+    }
+    endLoop(hoisted, live);
+}
+
+// <selector> -> R[s]; JMPTABLE / JMPSEARCH s, table; then every CASE body
+// followed by a JMP to the exit, then the DEFAULT body; exit:
+void Compiler::visit(grs_ast::SwitchStatement& node){
+    location_ = node.getLocation();
+    // a selector the optimizer folded picks its body here
+    if(double value = 0.0; literalNumber(node.getSelector(), value)){
+        if(auto taken = node.select(value)){
+            ++conditional_;
+            taken->accept(*this);
+            --conditional_;
+        }
+        return;
+    }
+    const std::uint8_t selector = allocate();
+    expression(node.getSelector(), selector);
+    // nested SWITCHes add theirs while the bodies compile
+    const auto index = static_cast<std::uint32_t>(chunk_.switches.size());
+    chunk_.switches.emplace_back();
+    const size_t dispatch = emit(OpCode::JMPSEARCH, selector, index, 0);
+
+    // CASE value -> first instruction of its body
+    std::vector<std::pair<std::int32_t, std::uint32_t>> targets;
+    std::vector<size_t> exits;
+    const auto& cases = node.getCases();
+    ++conditional_;
+    for(size_t i = 0; i < cases.size(); ++i){
+        const auto start = static_cast<std::uint32_t>(chunk_.code.size());
+        for(std::int32_t value : cases[i].values){
+            targets.emplace_back(value, start);
+        }
+        if(cases[i].body){
+            cases[i].body->accept(*this);
+        }
+        // the last body ends at the exit unless DEFAULT follows
+        if(i + 1 < cases.size() || node.getDefault()){
+            location_ = node.getLocation();
+            exits.push_back(emit(OpCode::JMP, 0, 0, 0));
+        }
+    }
+    const auto defaultTarget = static_cast<std::uint32_t>(chunk_.code.size());
+    if(node.getDefault()){
+        node.getDefault()->accept(*this);
+    }
+    --conditional_;
+    for(size_t exit : exits){
+        patchJump(exit);
+    }
+
+    std::sort(targets.begin(), targets.end());
+    SwitchTable& table = chunk_.switches[index];
+    table.defaultTarget = defaultTarget;
+    if(!targets.empty()){
+        const std::int64_t span = static_cast<std::int64_t>(targets.back().first) - targets.front().first + 1;
+        if(span <= TABLE_FILL * static_cast<std::int64_t>(targets.size())){
+            chunk_.code[dispatch].op = OpCode::JMPTABLE;
+            table.low = targets.front().first;
+            table.targets.assign(static_cast<size_t>(span), defaultTarget);
+            for(const auto& [value, target] : targets){
+                table.targets[static_cast<size_t>(static_cast<std::int64_t>(value) - table.low)] = target;
+            }
+            return;
+        }
+    }
+    for(const auto& [value, target] : targets){
+        table.keys.push_back(value);
+        table.targets.push_back(target);
+    }
+}
+
+std::vector<const grs_ast::Expression*> Compiler::hoist(grs_ast::ASTNode* body, grs_ast::Expression* condition,
+                                                        const std::string* counter){
+    std::vector<const grs_ast::Expression*> hoisted;
+    LoopScan scan;
+    if(counter){
+        scan.written.insert(*counter);
+    }
+    scan.scan(body);
+    scan.evaluated(condition);
+    if(!scan.commands){
+        std::vector<grs_ast::Expression*> found;
+        for(auto* expr : scan.expressions){
+            if(invariant(expr, scan, found) && worthHoisting(expr)){
+                found.push_back(expr);
+            }
+        }
+        for(auto* expr : found){
+            if(nextRegister_ >= HOIST_REGISTERS){
+                break;
+            }
+            const std::uint8_t value = allocate();
+            expression(expr, value);
+            hoisted_.emplace(expr, value);
+            hoisted.push_back(expr);
+        }
+    }
+    liveRegisters_ = nextRegister_;
+    return hoisted;
+}
+
+bool Compiler::invariant(grs_ast::Expression* expr, const LoopScan& scan, std::vector<grs_ast::Expression*>& found){
+    if(!expr){
+        return false;
+    }
+    if(hoisted_.count(expr)){
+        return true;
+    }
+    const auto keep = [&](grs_ast::Expression* part){
+        if(worthHoisting(part) && !hoisted_.count(part)){
+            found.push_back(part);
+        }
+    };
+    switch(expr->getType()){
+        case grs_ast::ASTNodeType::LiteralExpression:
+            return isNumber(expr);
+        case grs_ast::ASTNodeType::VariableExpression:{
+            // read with a typed GETVAR, which cannot fail on a declared slot
+            const std::string& name = static_cast<grs_ast::VariableExpression*>(expr)->getName();
+            const std::uint32_t* variable = knownSlot(name);
+            return isNumber(expr) && !scan.written.count(name) && variable && declared_.count(*variable);
+        }
+        case grs_ast::ASTNodeType::BinaryExpression:{
+            auto binary = static_cast<grs_ast::BinaryExpression*>(expr);
+            if(binary->getOperator() == grs_lexer::TokenType::ASSIGN){
+                if(invariant(binary->getRight(), scan, found)){
+                    keep(binary->getRight());
+                }
+                return false;
+            }
+            const bool left = invariant(binary->getLeft(), scan, found);
+            const bool right = invariant(binary->getRight(), scan, found);
+            // only the typed forms, and no division that may report a zero divisor
+            double divisor = 0.0;
+            if(left && right && isNumber(binary->getLeft()) && isNumber(binary->getRight()) &&
+               (binary->getOperator() != grs_lexer::TokenType::DIVIDE ||
+                (literalNumber(binary->getRight(), divisor) && divisor != 0.0))){
+                return true;
+            }
+            if(left){
+                keep(binary->getLeft());
+            }
+            if(right){
+                keep(binary->getRight());
+            }
+            return false;
+        }
+        case grs_ast::ASTNodeType::UnaryExpression:{
+            auto unary = static_cast<grs_ast::UnaryExpression*>(expr);
+            const bool operand = invariant(unary->getExpression(), scan, found);
+            if(operand && isNumber(unary->getExpression())){
+                return true;
+            }
+            if(operand){
+                keep(unary->getExpression());
+            }
+            return false;
+        }
+        default:
+            return false;
+    }
+}
+
+void Compiler::endLoop(const std::vector<const grs_ast::Expression*>& hoisted, std::uint32_t live){
+    for(auto* expr : hoisted){
+        hoisted_.erase(expr);
+    }
+    liveRegisters_ = live;
+}
+
+}
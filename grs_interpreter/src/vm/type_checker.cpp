@@ -0,0 +1,364 @@
+#include "vm/type_checker.hpp"
+#include "vm/bytecode.hpp"
+
+namespace grs_vm{
+
+namespace {
+
+using grs_lexer::TokenType;
+
+bool isNumber(TokenType type){
+    return type == TokenType::INT || type == TokenType::REAL || type == TokenType::BOOL;
+}
+
+bool isStruct(TokenType type){
+    return type == TokenType::POS || type == TokenType::FRAME || type == TokenType::AXIS;
+}
+
+std::string nameOf(TokenType type){
+    return std::string(grs_lexer::typeToStringMap.at(type));
+}
+
+// false for a member `type` does not have
+bool hasField(TokenType type, const std::string& member){
+    const std::int32_t field = fieldIndex(member);
+    return field >= 0 && (field >= 6) == (type == TokenType::AXIS);
+}
+
+// Collects the type of every DECL that can run, before any use is checked,
+// so a variable read in a branch above its DECL still gets its type. The
+// main program's are in its top-level statements and first DEF; a DEF's
+// body has its own, and skips the DEFs nested in it
+class Declarations : public grs_ast::ASTVisitorBase{
+    public:
+    std::unordered_map<std::string, TokenType>& types;
+    explicit Declarations(std::unordered_map<std::string, TokenType>& found, bool inFunction = false)
+    : types{found}, entrySeen_{inFunction} {}
+
+    void declare(const std::string& name, TokenType type){
+        auto [it, inserted] = types.try_emplace(name, type);
+        if(!inserted && it->second != type){
+            it->second = TokenType::ENDOFFILE;
+        }
+    }
+    void visit(grs_ast::FunctionBlock& node) override{
+        for(auto* statement : node.getStatements()){
+            if(statement) statement->accept(*this);
+        }
+    }
+    void visit(grs_ast::FunctionDeclaration& node) override{
+        if(!entrySeen_){
+            entrySeen_ = true;
+            if(auto body = node.getBody()) body->accept(*this);
+        }
+    }
+    void visit(grs_ast::IfStatement& node) override{
+        if(node.getThenBranch()) node.getThenBranch()->accept(*this);
+        if(node.getElseBranch()) node.getElseBranch()->accept(*this);
+    }
+    void visit(grs_ast::ForStatement& node) override{
+        if(node.getBody()) node.getBody()->accept(*this);
+    }
+    void visit(grs_ast::WhileStatement& node) override{
+        if(node.getBody()) node.getBody()->accept(*this);
+    }
+    void visit(grs_ast::RepeatStatement& node) override{
+        if(node.getBody()) node.getBody()->accept(*this);
+    }
+    void visit(grs_ast::SwitchStatement& node) override{
+        for(const auto& branch : node.getCases()){
+            if(branch.body) branch.body->accept(*this);
+        }
+        if(node.getDefault()) node.getDefault()->accept(*this);
+    }
+    void visit(grs_ast::VariableDeclaration& node) override{ declare(node.getName(), node.getDataType());}
+    void visit(grs_ast::FrameDeclaration& node) override{ declare(node.getName(), TokenType::FRAME);}
+    void visit(grs_ast::PositionDeclaration& node) override{ declare(node.getName(), TokenType::POS);}
+    void visit(grs_ast::AxisDeclaration& node) override{ declare(node.getName(), TokenType::AXIS);}
+
+    private:
+    bool entrySeen_ = false;
+};
+
+}
+
+bool TypeChecker::check(grs_ast::FunctionBlock* program){
+    errors_.clear();
+    variables_.clear();
+    entrySeen_ = false;
+    functions_ = grs_ast::functionTable(program);
+    callees_.clear();
+    called_.clear();
+    function_ = nullptr;
+    location_ = common::NO_LOCATION;
+    if(program){
+        Declarations declarations(variables_);
+        program->accept(declarations);
+        globals_ = variables_;
+        program->accept(*this);
+        // checking a DEF can add the ones it calls
+        for(size_t i = 0; i < callees_.size(); ++i){
+            checkFunction(*callees_[i]);
+        }
+    }
+    return errors_.empty();
+}
+
+void TypeChecker::checkFunction(grs_ast::FunctionDeclaration& function){
+    std::unordered_map<std::string, TokenType> locals;
+    Declarations declarations(locals, true);
+    for(const auto& parameter : function.getParameters()){
+        declarations.declare(parameter.name, parameter.type);
+    }
+    auto body = function.getBody();
+    if(body){
+        body->accept(declarations);
+    }
+    variables_ = globals_;
+    for(const auto& [name, type] : locals){
+        variables_[name] = type;
+    }
+    function_ = &function;
+    if(body){
+        body->accept(*this);
+    }
+    function_ = nullptr;
+}
+
+TokenType TypeChecker::variableType(const std::string& name){
+    auto it = variables_.find(name);
+    if(it != variables_.end()){
+        return it->second;
+    }
+    // the generator would find the variable of a DEF still running
+    if(function_){
+        error("'" + name + "' is neither a local of '" + function_->getName() + "' nor a main program variable");
+    }
+    return TokenType::ENDOFFILE;
+}
+
+TokenType TypeChecker::typeOf(grs_ast::Expression* expr){
+    if(!expr){
+        return TokenType::ENDOFFILE;
+    }
+    expr->accept(*this);
+    return expr->getStaticType();
+}
+
+template<typename Describe>
+void TypeChecker::expectNumber(TokenType type, Describe&& what){
+    if(type != TokenType::ENDOFFILE && !isNumber(type)){
+        error(what() + " needs a number, not " + nameOf(type));
+    }
+}
+
+void TypeChecker::error(const std::string& message){
+    errors_.push_back({message, location_});
+}
+
+void TypeChecker::visit(grs_ast::FunctionBlock& node){
+    for(auto* statement : node.getStatements()){
+        if(!statement){
+            continue;
+        }
+        if(auto expr = dynamic_cast<grs_ast::Expression*>(statement)){
+            location_ = expr->getLocation();
+        }
+        statement->accept(*this);
+    }
+}
+
+void TypeChecker::visit(grs_ast::FunctionDeclaration& node){
+    if(entrySeen_){
+        return;
+    }
+    entrySeen_ = true;
+    if(auto body = node.getBody()){
+        body->accept(*this);
+    }
+}
+
+void TypeChecker::visit(grs_ast::MotionCommand& node){
+    location_ = node.getLocation();
+    const TokenType type = variableType(node.getName());
+    if(type != TokenType::ENDOFFILE && !isStruct(type)){
+        error(node.getCommand() + " needs a POS, FRAME or AXIS, not " + nameOf(type) + " '" + node.getName() + "'");
+    }
+}
+
+void TypeChecker::visit(grs_ast::BinaryExpression& node){
+    const TokenType op = node.getOperator();
+    if(op == TokenType::ASSIGN){
+        auto variable = dynamic_cast<grs_ast::VariableExpression*>(node.getLeft());
+        const TokenType value = typeOf(node.getRight());
+        const TokenType target = variable ? typeOf(variable) : TokenType::ENDOFFILE;
+        if(isStruct(target)){
+            error("Cannot assign to " + nameOf(target) + " '" + variable->getName() + "' as a whole");
+        } else if(target != TokenType::ENDOFFILE){
+            expectNumber(value, [&]{ return "Assigning to " + nameOf(target) + " '" + variable->getName() + "'";});
+        }
+        // the register holds the value, not yet converted
+        node.setStaticType(value);
+        return;
+    }
+
+    const auto what = [op]{ return "Operator '" + nameOf(op) + "'";};
+    expectNumber(typeOf(node.getLeft()), what);
+    expectNumber(typeOf(node.getRight()), what);
+    const bool arithmetic = op == TokenType::PLUS || op == TokenType::MINUS ||
+                            op == TokenType::MULTIPLY || op == TokenType::DIVIDE;
+    node.setStaticType(arithmetic ? TokenType::REAL : TokenType::BOOL);
+}
+
+void TypeChecker::visit(grs_ast::UnaryExpression& node){
+    const TokenType op = node.getOperator();
+    expectNumber(typeOf(node.getExpression()), [op]{ return "Operator '" + nameOf(op) + "'";});
+    node.setStaticType(op == TokenType::MINUS ? TokenType::REAL : TokenType::BOOL);
+}
+
+void TypeChecker::visit(grs_ast::LiteraExpression& node){
+    const common::ValueType& value = node.getValue();
+    if(std::holds_alternative<int>(value)){
+        node.setStaticType(TokenType::INT);
+    } else if(std::holds_alternative<double>(value)){
+        node.setStaticType(TokenType::REAL);
+    } else if(std::holds_alternative<bool>(value)){
+        node.setStaticType(TokenType::BOOL);
+    } else if(std::holds_alternative<std::string>(value)){
+        node.setStaticType(TokenType::CHAR);
+    }
+}
+
+void TypeChecker::visit(grs_ast::VariableExpression& node){
+    node.setStaticType(variableType(node.getName()));
+}
+
+void TypeChecker::visit(grs_ast::VariableDeclaration& node){
+    location_ = node.getLocation();
+    const TokenType value = typeOf(node.getInitializer());
+    const TokenType type = node.getDataType();
+    // a CHAR may start from a string; every other scalar takes a number
+    if(!(type == TokenType::CHAR && value == TokenType::CHAR)){
+        expectNumber(value, [&]{ return "Initialising " + nameOf(type) + " '" + node.getName() + "'";});
+    }
+}
+
+template<typename NodeType>
+void TypeChecker::structDeclaration(NodeType& node, TokenType type){
+    location_ = node.getLocation();
+    for(const auto& arg : node.getArgs()){
+        if(!hasField(type, arg.first)){
+            error(nameOf(type) + " has no member '" + arg.first + "'");
+        }
+        expectNumber(typeOf(arg.second), [&]{ return "Member '" + arg.first + "' of '" + node.getName() + "'";});
+    }
+}
+
+void TypeChecker::visit(grs_ast::FrameDeclaration& node){
+    structDeclaration(node, TokenType::FRAME);
+}
+
+void TypeChecker::visit(grs_ast::PositionDeclaration& node){
+    structDeclaration(node, TokenType::POS);
+}
+
+void TypeChecker::visit(grs_ast::AxisDeclaration& node){
+    structDeclaration(node, TokenType::AXIS);
+}
+
+void TypeChecker::visit(grs_ast::ExecutePosAndAxisExpression& node){
+    location_ = node.getLocation();
+    const TokenType type = variableType(node.getName());
+    if(type != TokenType::ENDOFFILE && !isStruct(type)){
+        error(nameOf(type) + " '" + node.getName() + "' has no members");
+    } else if(isStruct(type) && !hasField(type, node.getArg())){
+        error(nameOf(type) + " has no member '" + node.getArg() + "'");
+    }
+    expectNumber(typeOf(node.getExpr()), [&]{ return "Member '" + node.getArg() + "' of '" + node.getName() + "'";});
+}
+
+void TypeChecker::visit(grs_ast::IfStatement& node){
+    location_ = node.getLocation();
+    expectNumber(typeOf(node.getCondition()), []{ return std::string("IF condition");});
+    if(node.getThenBranch()){
+        node.getThenBranch()->accept(*this);
+    }
+    if(node.getElseBranch()){
+        node.getElseBranch()->accept(*this);
+    }
+}
+
+void TypeChecker::visit(grs_ast::ForStatement& node){
+    location_ = node.getLocation();
+    const TokenType counter = variableType(node.getCounter());
+    if(counter != TokenType::ENDOFFILE && counter != TokenType::INT){
+        error("FOR counter '" + node.getCounter() + "' needs an INT, not " + nameOf(counter));
+    }
+    expectNumber(typeOf(node.getStart()), []{ return std::string("FOR start value");});
+    expectNumber(typeOf(node.getEnd()), []{ return std::string("FOR end value");});
+    if(node.getBody()){
+        node.getBody()->accept(*this);
+    }
+}
+
+void TypeChecker::visit(grs_ast::WhileStatement& node){
+    location_ = node.getLocation();
+    expectNumber(typeOf(node.getCondition()), []{ return std::string("WHILE condition");});
+    if(node.getBody()){
+        node.getBody()->accept(*this);
+    }
+}
+
+void TypeChecker::visit(grs_ast::RepeatStatement& node){
+    if(node.getBody()){
+        node.getBody()->accept(*this);
+    }
+    location_ = node.getLocation();
+    expectNumber(typeOf(node.getCondition()), []{ return std::string("UNTIL condition");});
+}
+
+void TypeChecker::visit(grs_ast::SwitchStatement& node){
+    location_ = node.getLocation();
+    expectNumber(typeOf(node.getSelector()), []{ return std::string("SWITCH selector");});
+    for(const auto& branch : node.getCases()){
+        if(branch.body){
+            branch.body->accept(*this);
+        }
+    }
+    if(node.getDefault()){
+        node.getDefault()->accept(*this);
+    }
+}
+
+void TypeChecker::visit(grs_ast::CallExpression& node){
+    const auto& args = node.getArgs();
+    for(size_t i = 0; i < args.size(); ++i){
+        expectNumber(typeOf(args[i]), [&]{ return "Argument " + std::to_string(i + 1) + " of '" + node.getName() + "'";});
+    }
+    auto it = functions_.find(node.getName());
+    if(it == functions_.end()){
+        error("Unknown function '" + node.getName() + "'");
+        node.setStaticType(TokenType::REAL);
+        return;
+    }
+    grs_ast::FunctionDeclaration& function = *it->second;
+    if(const size_t count = function.getParameters().size(); count != args.size()){
+        error("'" + node.getName() + "' takes " + std::to_string(count) + (count == 1 ? " argument" : " arguments") +
+              ", not " + std::to_string(args.size()));
+    }
+    if(called_.insert(&function).second){
+        callees_.push_back(&function);
+    }
+    const TokenType type = function.getReturnType();
+    node.setStaticType(type == TokenType::ENDOFFILE ? TokenType::REAL : type);
+}
+
+void TypeChecker::visit(grs_ast::ReturnStatement& node){
+    location_ = node.getLocation();
+    const TokenType value = typeOf(node.getValue());
+    if(function_){
+        expectNumber(value, [&]{ return "RETURN from '" + function_->getName() + "'";});
+    }
+}
+
+}
@@ -0,0 +1,628 @@
+#include "vm/vm.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "common/case_value.hpp"
+#include "common/counted_loop.hpp"
+#include "common/int_conversion.hpp"
+
+// labels as values are a GCC / Clang extension; elsewhere, or when built
+// with GRS_VM_SWITCH_DISPATCH, the loop dispatches through a switch
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(GRS_VM_SWITCH_DISPATCH)
+#define GRS_VM_THREADED 1
+#endif
+
+namespace grs_vm{
+
+namespace {
+
+bool isTrue(common::Value value){
+    double number = 0.0;
+    return value.toNumber(number) && number != 0.0;
+}
+
+// the CASE value a SWITCH selector picks; false when only DEFAULT takes it
+bool caseValue(common::Value selector, std::int32_t& value){
+    if(selector.kind() == common::ValueKind::INT){
+        value = selector.getInt();
+        return true;
+    }
+    double number = 0.0;
+    selector.toNumber(number);
+    return common::caseValue(number, value);
+}
+
+common::ValueKind kindOf(grs_lexer::TokenType type){
+    switch(type){
+        case grs_lexer::TokenType::FRAME: return common::ValueKind::FRAME;
+        case grs_lexer::TokenType::AXIS:  return common::ValueKind::AXIS;
+        default:                          return common::ValueKind::POSITION;
+    }
+}
+
+double arithmetic(OpCode op, double left, double right){
+    switch(op){
+        case OpCode::ADD: return left + right;
+        case OpCode::SUB: return left - right;
+        case OpCode::MUL: return left * right;
+        case OpCode::DIV:
+            if(right == 0.0){
+                std::cerr << "Error: Division by zero" << std::endl;
+                return 0.0;
+            }
+            return left / right;
+        case OpCode::LT:  return left < right ? 1.0 : 0.0;
+        case OpCode::LE:  return left <= right ? 1.0 : 0.0;
+        case OpCode::GT:  return left > right ? 1.0 : 0.0;
+        case OpCode::GE:  return left >= right ? 1.0 : 0.0;
+        case OpCode::EQ:  return left == right ? 1.0 : 0.0;
+        case OpCode::NE:  return left != right ? 1.0 : 0.0;
+        case OpCode::AND: return (left != 0.0 && right != 0.0) ? 1.0 : 0.0;
+        case OpCode::OR:  return (left != 0.0 || right != 0.0) ? 1.0 : 0.0;
+        default:          return 0.0;
+    }
+}
+
+template<typename StructType>
+void setMember(StructType& value, std::int32_t field, double number){
+    if constexpr(std::is_same_v<StructType, common::Axis>){
+        double* members[] = {&value.A1, &value.A2, &value.A3, &value.A4, &value.A5, &value.A6};
+        *members[field - 6] = number;
+    } else {
+        double* members[] = {&value.x, &value.y, &value.z, &value.a, &value.b, &value.c};
+        *members[field] = number;
+    }
+}
+
+template<typename StructType>
+void copyFields(StructType& value, double (&fields)[6], bool save){
+    static_assert(sizeof(StructType) == sizeof(fields), "a struct is six doubles");
+    if(save){
+        std::memcpy(fields, &value, sizeof(fields));
+    } else {
+        std::memcpy(&value, fields, sizeof(fields));
+    }
+}
+
+}
+
+Vm::Vm(const Chunk& chunk, std::uint32_t maxCallDepth) : chunk_(chunk),
+    slots_(chunk.slotNames.size(), Slot{grs_lexer::TokenType::REAL, false, 0.0}), pool_(chunk.pool),
+    maxCallDepth_(maxCallDepth), active_(chunk.functions.size(), 0){
+    commands_.names = chunk.slotNames;
+    commands_.constants.resize(1);
+    commands_.code.resize(1);
+    // every call's window starts below the caller's last register
+    const size_t windows = chunk.functions.empty() ? 1 : static_cast<size_t>(maxCallDepth) + 1;
+    registers_.resize(chunk.registerCount * windows);
+    std::uint32_t mostLocals = 0;
+    for(const Function& function : chunk.functions){
+        mostLocals = std::max(mostLocals, function.localCount);
+    }
+    frames_.reserve(chunk.functions.empty() ? 0 : maxCallDepth);
+    saved_.resize(static_cast<size_t>(maxCallDepth) * mostLocals);
+}
+
+void Vm::reset(){
+    pc_ = 0;
+    finished_ = false;
+    executed_ = 0;
+    for(Slot& slot : slots_){
+        slot.declared = false;
+    }
+    std::fill(registers_.begin(), registers_.end(), common::Value(0.0));
+    registerBase_ = 0;
+    frames_.clear();
+    savedTop_ = 0;
+    std::fill(active_.begin(), active_.end(), 0);
+}
+
+std::uint32_t Vm::findSlot(const std::string& name)const{
+    const auto local = [this](std::uint32_t slot){
+        for(const Function& function : chunk_.functions){
+            if(slot >= function.firstLocal && slot - function.firstLocal < function.localCount){
+                return true;
+            }
+        }
+        return false;
+    };
+    for(std::uint32_t slot = 0; slot < chunk_.slotNames.size(); ++slot){
+        if(chunk_.slotNames[slot] == name && !local(slot)){
+            return slot;
+        }
+    }
+    return static_cast<std::uint32_t>(chunk_.slotNames.size());
+}
+
+bool Vm::hasVariable(const std::string& name)const{
+    const std::uint32_t slot = findSlot(name);
+    return slot < slots_.size() && slots_[slot].declared;
+}
+
+common::ValueType Vm::getVariable(const std::string& name)const{
+    const std::uint32_t slot = findSlot(name);
+    return slot < slots_.size() && slots_[slot].declared ? pool_.toValueType(slots_[slot].value) : common::ValueType(0.0);
+}
+
+bool Vm::setVariable(const std::string& name, grs_lexer::TokenType type, const common::ValueType& value){
+    const std::uint32_t slot = findSlot(name);
+    if(slot >= slots_.size()){
+        return false;
+    }
+    // typed opcodes rely on the slot's type: numbers are converted to it,
+    // anything else is refused
+    if(const grs_lexer::TokenType fixed = chunk_.slotTypes[slot]; fixed != grs_lexer::TokenType::ENDOFFILE){
+        double number = 0.0;
+        if(!pool_.toValue(value).toNumber(number)){
+            return false;
+        }
+        slots_[slot] = {fixed, true, convert(fixed, number)};
+        return true;
+    }
+    Slot& variable = slots_[slot];
+    const common::Value current = variable.value;
+    if(auto val = std::get_if<common::Position>(&value); val && current.kind() == common::ValueKind::POSITION){
+        pool_.get<common::Position>(current.getHandle()) = *val;
+    } else if(auto val = std::get_if<common::Frame>(&value); val && current.kind() == common::ValueKind::FRAME){
+        pool_.get<common::Frame>(current.getHandle()) = *val;
+    } else if(auto val = std::get_if<common::Axis>(&value); val && current.kind() == common::ValueKind::AXIS){
+        pool_.get<common::Axis>(current.getHandle()) = *val;
+    } else {
+        variable.value = pool_.toValue(value);
+    }
+    variable.type = type;
+    variable.declared = true;
+    return true;
+}
+
+const char* Vm::getDispatch(){
+#ifdef GRS_VM_THREADED
+    return "threaded";
+#else
+    return "switch";
+#endif
+}
+
+const grs_interpreter::Instruction* Vm::next(){
+    if(finished_){
+        return nullptr;
+    }
+    const Instr* const code = chunk_.code.data();
+    const Instr* instr = nullptr;
+    // the running function's window; moves with every CALL and RET
+    common::Value* registers = registers_.data() + registerBase_;
+#ifdef GRS_VM_THREADED
+    // one indirect jump per handler instead of the switch's shared one, so
+    // the branch predictor sees each opcode's successors separately
+#define GRS_VM_LABEL(name) &&op_##name,
+    static void* const handlers[OPCODE_COUNT] = { GRS_VM_OPCODES(GRS_VM_LABEL) };
+#undef GRS_VM_LABEL
+#define VM_CASE(name) op_##name:
+#define VM_NEXT() do{ instr = &code[pc_++]; ++executed_; goto *handlers[static_cast<std::uint8_t>(instr->op)]; }while(0)
+    VM_NEXT();
+    {
+#else
+#define VM_CASE(name) case OpCode::name:
+#define VM_NEXT() continue
+    for(;;){
+        instr = &code[pc_++];
+        ++executed_;
+        switch(instr->op){
+#endif
+        VM_CASE(LOADK)
+            registers[instr->a] = chunk_.constants[instr->b];
+            VM_NEXT();
+        VM_CASE(MOVE)
+            registers[instr->a] = registers[instr->b];
+            VM_NEXT();
+        VM_CASE(GETVAR)
+            registers[instr->a] = load(instr->b);
+            VM_NEXT();
+        VM_CASE(SETVAR)
+            assign(instr->b, registers[instr->a]);
+            VM_NEXT();
+        VM_CASE(DECL)
+            declare(instr->b, static_cast<grs_lexer::TokenType>(instr->c), nullptr);
+            VM_NEXT();
+        VM_CASE(DECL_INIT)
+            declare(instr->b, static_cast<grs_lexer::TokenType>(instr->c), &registers[instr->a]);
+            VM_NEXT();
+        VM_CASE(DECL_STRUCT)
+            declareStruct(instr->b, static_cast<grs_lexer::TokenType>(instr->c));
+            VM_NEXT();
+        VM_CASE(SETFIELD)
+            setField(instr->b, instr->c, registers[instr->a]);
+            VM_NEXT();
+        VM_CASE(ADD) VM_CASE(SUB) VM_CASE(MUL) VM_CASE(DIV)
+        VM_CASE(LT)  VM_CASE(LE)  VM_CASE(GT)  VM_CASE(GE)
+        VM_CASE(EQ)  VM_CASE(NE)  VM_CASE(AND) VM_CASE(OR){
+            double left = 0.0, right = 0.0;
+            if(!registers[instr->b].toNumber(left) || !registers[instr->c].toNumber(right)){
+                std::cerr << "Cannot convert operand to numeric value" << std::endl;
+                registers[instr->a] = 0.0;
+            } else {
+                registers[instr->a] = arithmetic(instr->op, left, right);
+            }
+            VM_NEXT();
+        }
+        VM_CASE(NOT)
+            registers[instr->a] = isTrue(registers[instr->b]) ? 0.0 : 1.0;
+            VM_NEXT();
+        VM_CASE(NEG){
+            double number = 0.0;
+            if(!registers[instr->b].toNumber(number)){
+                std::cerr << "Cannot convert operand to numeric value" << std::endl;
+            }
+            registers[instr->a] = -number;
+            VM_NEXT();
+        }
+        VM_CASE(GETVAR_INT){
+            const Slot& variable = slots_[instr->b];
+            registers[instr->a] = variable.declared ? static_cast<double>(variable.value.getInt()) : load(instr->b);
+            VM_NEXT();
+        }
+        VM_CASE(GETVAR_REAL){
+            const Slot& variable = slots_[instr->b];
+            registers[instr->a] = variable.declared ? variable.value : load(instr->b);
+            VM_NEXT();
+        }
+        VM_CASE(GETVAR_BOOL){
+            const Slot& variable = slots_[instr->b];
+            registers[instr->a] = variable.declared ? (variable.value.getBool() ? 1.0 : 0.0) : load(instr->b);
+            VM_NEXT();
+        }
+        VM_CASE(SETVAR_INT)
+        VM_CASE(SETVAR_REAL)
+        VM_CASE(SETVAR_BOOL){
+            Slot& variable = slots_[instr->b];
+            const double number = registers[instr->a].getReal();
+            if(!variable.declared){
+                assign(instr->b, number);
+            } else if(instr->op == OpCode::SETVAR_INT){
+                variable.value = common::Value::ofInt(common::storeInt(number));
+            } else if(instr->op == OpCode::SETVAR_BOOL){
+                variable.value = common::Value::ofBool(number != 0.0);
+            } else {
+                variable.value = number;
+            }
+            VM_NEXT();
+        }
+        VM_CASE(ADD_F)
+            registers[instr->a] = registers[instr->b].getReal() + registers[instr->c].getReal();
+            VM_NEXT();
+        VM_CASE(SUB_F)
+            registers[instr->a] = registers[instr->b].getReal() - registers[instr->c].getReal();
+            VM_NEXT();
+        VM_CASE(MUL_F)
+            registers[instr->a] = registers[instr->b].getReal() * registers[instr->c].getReal();
+            VM_NEXT();
+        VM_CASE(DIV_F)
+            registers[instr->a] = arithmetic(OpCode::DIV, registers[instr->b].getReal(), registers[instr->c].getReal());
+            VM_NEXT();
+        VM_CASE(LT_F)
+            registers[instr->a] = registers[instr->b].getReal() < registers[instr->c].getReal() ? 1.0 : 0.0;
+            VM_NEXT();
+        VM_CASE(LE_F)
+            registers[instr->a] = registers[instr->b].getReal() <= registers[instr->c].getReal() ? 1.0 : 0.0;
+            VM_NEXT();
+        VM_CASE(GT_F)
+            registers[instr->a] = registers[instr->b].getReal() > registers[instr->c].getReal() ? 1.0 : 0.0;
+            VM_NEXT();
+        VM_CASE(GE_F)
+            registers[instr->a] = registers[instr->b].getReal() >= registers[instr->c].getReal() ? 1.0 : 0.0;
+            VM_NEXT();
+        VM_CASE(EQ_F)
+            registers[instr->a] = registers[instr->b].getReal() == registers[instr->c].getReal() ? 1.0 : 0.0;
+            VM_NEXT();
+        VM_CASE(NE_F)
+            registers[instr->a] = registers[instr->b].getReal() != registers[instr->c].getReal() ? 1.0 : 0.0;
+            VM_NEXT();
+        VM_CASE(AND_F)
+            registers[instr->a] = (registers[instr->b].getReal() != 0.0 && registers[instr->c].getReal() != 0.0) ? 1.0 : 0.0;
+            VM_NEXT();
+        VM_CASE(OR_F)
+            registers[instr->a] = (registers[instr->b].getReal() != 0.0 || registers[instr->c].getReal() != 0.0) ? 1.0 : 0.0;
+            VM_NEXT();
+        VM_CASE(NOT_F)
+            registers[instr->a] = registers[instr->b].getReal() == 0.0 ? 1.0 : 0.0;
+            VM_NEXT();
+        VM_CASE(NEG_F)
+            registers[instr->a] = -registers[instr->b].getReal();
+            VM_NEXT();
+        VM_CASE(JMPZ)
+            if(registers[instr->a].getReal() == 0.0){
+                pc_ += instr->c;
+            }
+            VM_NEXT();
+        VM_CASE(JMP)
+            pc_ += instr->c;
+            VM_NEXT();
+        VM_CASE(JMPF)
+            if(!isTrue(registers[instr->a])){
+                pc_ += instr->c;
+            }
+            VM_NEXT();
+        VM_CASE(FORPREP){
+            common::Value* const loop = &registers[instr->a];
+            double start = 0.0, end = 0.0;
+            loop[0].toNumber(start);
+            loop[1].toNumber(end);
+            const common::CountedLoop counted(start, end, static_cast<std::int32_t>(loop[2].getReal()));
+            loop[0] = common::Value::ofInt(counted.counter);
+            loop[1] = common::Value::ofInt(counted.limit);
+            loop[2] = common::Value::ofInt(counted.step);
+            // an undefined counter is reported here and skips the loop
+            assign(instr->b, static_cast<double>(counted.counter));
+            if(!slots_[instr->b].declared || !counted.inRange()){
+                pc_ += instr->c;
+            }
+            VM_NEXT();
+        }
+        VM_CASE(FORLOOP){
+            common::Value* const loop = &registers[instr->a];
+            common::CountedLoop counted;
+            counted.counter = loop[0].getInt();
+            counted.limit = loop[1].getInt();
+            counted.step = loop[2].getInt();
+            if(counted.advance()){
+                loop[0] = common::Value::ofInt(counted.counter);
+                Slot& counter = slots_[instr->b];
+                if(counter.declared && counter.type == grs_lexer::TokenType::INT){
+                    counter.value = loop[0];
+                } else {
+                    assign(instr->b, static_cast<double>(counted.counter));
+                }
+                if(counted.inRange()){
+                    pc_ += instr->c;
+                }
+            }
+            VM_NEXT();
+        }
+        VM_CASE(JMPTABLE){
+            const SwitchTable& table = chunk_.switches[instr->b];
+            std::int32_t value = 0;
+            pc_ = table.defaultTarget;
+            if(caseValue(registers[instr->a], value)){
+                // one unsigned compare covers both ends of the table
+                const std::uint64_t index = static_cast<std::uint64_t>(static_cast<std::int64_t>(value) - table.low);
+                if(index < table.targets.size()){
+                    pc_ = table.targets[index];
+                }
+            }
+            VM_NEXT();
+        }
+        VM_CASE(JMPSEARCH){
+            const SwitchTable& table = chunk_.switches[instr->b];
+            std::int32_t value = 0;
+            pc_ = table.defaultTarget;
+            if(caseValue(registers[instr->a], value)){
+                auto it = std::lower_bound(table.keys.begin(), table.keys.end(), value);
+                if(it != table.keys.end() && *it == value){
+                    pc_ = table.targets[it - table.keys.begin()];
+                }
+            }
+            VM_NEXT();
+        }
+        VM_CASE(CALL)
+            if(!call(*instr)){
+                registers[instr->a] = 0.0;
+            }
+            registers = registers_.data() + registerBase_;
+            VM_NEXT();
+        VM_CASE(RET)
+            ret(*instr);
+            registers = registers_.data() + registerBase_;
+            VM_NEXT();
+        VM_CASE(MOTION){
+            grs_interpreter::Instruction& command = commands_.code[0];
+            command = {};
+            command.op = grs_interpreter::Opcode::MOTION;
+            command.type = static_cast<std::uint16_t>(instr->c);
+            command.name = instr->b;
+            command.value = 0;
+            command.location = chunk_.locations[pc_ - 1];
+            const Slot& position = slots_[instr->b];
+            if(position.declared){
+                commands_.constants[0] = pool_.toValueType(position.value);
+            } else {
+                commands_.constants[0] = 0.0;
+            }
+            return &command;
+        }
+        VM_CASE(WAIT){
+            grs_interpreter::Instruction& command = commands_.code[0];
+            command = {};
+            command.op = grs_interpreter::Opcode::WAIT;
+            command.value = 0;
+            command.location = chunk_.locations[pc_ - 1];
+            commands_.constants[0] = pool_.toValueType(chunk_.constants[instr->b]);
+            return &command;
+        }
+        VM_CASE(HALT)
+            finished_ = true;
+            --pc_;
+            return nullptr;
+
+#ifndef GRS_VM_THREADED
+        }
+#endif
+    }
+#undef VM_CASE
+#undef VM_NEXT
+    return nullptr;
+}
+
+bool Vm::call(const Instr& instr){
+    const Function& function = chunk_.functions[instr.c];
+    if(instr.b == UNRESOLVED){
+        std::cerr << "Unknown function '" << function.name << "'" << std::endl;
+        return false;
+    }
+    if(frames_.size() == maxCallDepth_){
+        std::cerr << "Call depth limit of " << maxCallDepth_ << " reached calling '" << function.name << "'" << std::endl;
+        return false;
+    }
+    Frame frame{static_cast<std::uint32_t>(pc_), static_cast<std::uint32_t>(instr.c), registerBase_, NOT_SAVED};
+    Slot* const locals = &slots_[function.firstLocal];
+    if(active_[instr.c]++ > 0){
+        frame.saved = savedTop_;
+        for(std::uint32_t i = 0; i < function.localCount; ++i){
+            SavedSlot& entry = saved_[savedTop_++];
+            entry.slot = locals[i];
+            copyStruct(locals[i].value, entry.fields, true);
+        }
+    }
+    for(std::uint32_t i = 0; i < function.localCount; ++i){
+        locals[i].declared = false;
+    }
+    // the arguments stay where they are until every parameter is declared
+    const common::Value* const args = &registers_[registerBase_ + instr.a];
+    for(std::uint32_t i = 0; i < function.parameters.size(); ++i){
+        declare(function.firstLocal + i, function.parameters[i], &args[i]);
+    }
+    frames_.push_back(frame);
+    registerBase_ += instr.a;
+    pc_ = instr.b;
+    return true;
+}
+
+void Vm::ret(const Instr& instr){
+    const Frame frame = frames_.back();
+    frames_.pop_back();
+    const Function& function = chunk_.functions[frame.function];
+    double number = 0.0;
+    if(instr.b){
+        registers_[registerBase_ + instr.a].toNumber(number);
+    }
+    if(frame.saved != NOT_SAVED){
+        Slot* const locals = &slots_[function.firstLocal];
+        for(std::uint32_t i = 0; i < function.localCount; ++i){
+            SavedSlot& entry = saved_[frame.saved + i];
+            locals[i] = entry.slot;
+            copyStruct(locals[i].value, entry.fields, false);
+        }
+        savedTop_ = frame.saved;
+    }
+    --active_[frame.function];
+    registerBase_ = frame.registerBase;
+    pc_ = frame.returnPc;
+    // R[a] of the CALL
+    registers_[registerBase_ + chunk_.code[pc_ - 1].a] = common::returnValue(function.returnType, number);
+}
+
+void Vm::copyStruct(common::Value value, double (&fields)[6], bool save){
+    switch(value.kind()){
+        case common::ValueKind::POSITION: copyFields(pool_.get<common::Position>(value.getHandle()), fields, save); break;
+        case common::ValueKind::FRAME:    copyFields(pool_.get<common::Frame>(value.getHandle()), fields, save); break;
+        case common::ValueKind::AXIS:     copyFields(pool_.get<common::Axis>(value.getHandle()), fields, save); break;
+        default:                          break;
+    }
+}
+
+common::Value Vm::load(std::uint32_t slot)const{
+    const Slot& variable = slots_[slot];
+    if(!variable.declared){
+        std::cerr << "Undefined variable " << chunk_.slotNames[slot] << std::endl;
+        return 0.0;
+    }
+    if(variable.value.kind() == common::ValueKind::STRING){
+        std::cerr << "Cannot convert string to double" << "\n";
+        return 0.0;
+    }
+    double number = 0.0;
+    if(variable.value.toNumber(number)){
+        return number;
+    }
+    return variable.value;
+}
+
+common::Value Vm::convert(grs_lexer::TokenType type, double number){
+    switch(type){
+        case grs_lexer::TokenType::INT:
+            return common::Value::ofInt(common::storeInt(number));
+        case grs_lexer::TokenType::CHAR:
+            return common::Value::ofHandle(common::ValueKind::STRING, pool_.intern(std::to_string(number)));
+        case grs_lexer::TokenType::BOOL:
+            return common::Value::ofBool(number != 0.0);
+        case grs_lexer::TokenType::REAL:
+        default:
+            return number;
+    }
+}
+
+void Vm::declare(std::uint32_t slot, grs_lexer::TokenType type, const common::Value* init){
+    double number = 0.0;
+    const bool numeric = init && init->toNumber(number);
+    // the value always has the slot's kind, since typed reads take the
+    // matching member; a CHAR given no number keeps 0, as in the generator
+    const common::Value value = numeric || type != grs_lexer::TokenType::CHAR ? convert(type, number) : common::Value(0.0);
+    slots_[slot] = {type, true, value};
+}
+
+void Vm::declareStruct(std::uint32_t slot, grs_lexer::TokenType type){
+    Slot& variable = slots_[slot];
+    const common::ValueKind kind = kindOf(type);
+    // declared again (a loop, or a run after reset): reuse the pooled struct
+    const bool reuse = variable.value.kind() == kind;
+    const std::uint32_t handle = reuse ? variable.value.getHandle() : 0;
+    switch(kind){
+        case common::ValueKind::FRAME:
+            variable.value = common::Value::ofHandle(kind, reuse ? handle : pool_.add(common::Frame{}));
+            pool_.get<common::Frame>(variable.value.getHandle()) = {};
+            break;
+        case common::ValueKind::AXIS:
+            variable.value = common::Value::ofHandle(kind, reuse ? handle : pool_.add(common::Axis{}));
+            pool_.get<common::Axis>(variable.value.getHandle()) = {};
+            break;
+        default:
+            variable.value = common::Value::ofHandle(kind, reuse ? handle : pool_.add(common::Position{}));
+            pool_.get<common::Position>(variable.value.getHandle()) = {};
+            break;
+    }
+    variable.type = type;
+    variable.declared = true;
+}
+
+void Vm::assign(std::uint32_t slot, common::Value value){
+    Slot& variable = slots_[slot];
+    if(!variable.declared){
+        std::cerr << "Undefined variable: " << chunk_.slotNames[slot] << std::endl;
+        return;
+    }
+    double number = 0.0;
+    value.toNumber(number);
+    if(variable.type == grs_lexer::TokenType::CHAR){
+        // unlike a declaration, an assignment keeps only the integer part
+        variable.value = common::Value::ofHandle(common::ValueKind::STRING,
+                                                 pool_.intern(std::to_string(common::storeInt(number))));
+    } else {
+        variable.value = convert(variable.type, number);
+    }
+}
+
+void Vm::setField(std::uint32_t slot, std::int32_t field, common::Value value){
+    Slot& variable = slots_[slot];
+    if(!variable.declared){
+        std::cerr << "Undefined variable " << chunk_.slotNames[slot] << std::endl;
+        return;
+    }
+    double number = 0.0;
+    if(!value.toNumber(number)){
+        std::cerr << "Cannot convert operand to numeric value" << std::endl;
+    }
+    const common::ValueKind kind = variable.value.kind();
+    const std::uint32_t handle = variable.value.getHandle();
+    const bool axisField = field >= 6;
+    if(field >= 0 && !axisField && kind == common::ValueKind::POSITION){
+        setMember(pool_.get<common::Position>(handle), field, number);
+    } else if(field >= 0 && !axisField && kind == common::ValueKind::FRAME){
+        setMember(pool_.get<common::Frame>(handle), field, number);
+    } else if(axisField && kind == common::ValueKind::AXIS){
+        setMember(pool_.get<common::Axis>(handle), field, number);
+    } else {
+        std::cerr << "Type '" << grs_lexer::typeToStringMap.at(variable.type)
+                  << "' does not support member '" << fieldName(field) << "'\n";
+    }
+}
+
+}
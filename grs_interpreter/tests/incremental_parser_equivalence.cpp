@@ -0,0 +1,233 @@
+// Checks IncrementalParser against a from-scratch parse: after every edit
+// the tree (each node's kind, names, literals and decoded position), the
+// errors and the tokens must be those of parsing the edited text anew.
+// Run as ./incremental_parser_equivalence <dir>; every *.txt in <dir> is
+// loaded and edited at random, then a fixed-seed batch of generated
+// programs, with lines that are long enough to force the ids below an
+// edit to move now and then.
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "ast/flat_ast.hpp"
+#include "lexer/lexer.hpp"
+#include "lexer/source_buffer.hpp"
+#include "parser/incremental_parser.hpp"
+#include "parser/parser.hpp"
+
+namespace {
+
+constexpr int EDITS_PER_FILE = 200;
+constexpr int GENERATED_PROGRAMS = 300;
+constexpr int EDITS_PER_PROGRAM = 20;
+
+const char* const POOL[] = {
+    "DEF f()", "END", "DEF INT g(INT n)", "RETURN n + 1",
+    "DECL INT a := 3", "DECL REAL b := 2.5 * a", "DECL POS P1 := {x 1, y 2, z 3}",
+    "DECL AXIS X1 := {A1 1, A2 2}", "LIN P1", "PTP P1", "CIRC X1",
+    "IF a > 2 THEN", "ELSE", "ENDIF", "FOR i := 1 TO 3", "ENDFOR",
+    "WHILE a < 5", "ENDWHILE", "SWITCH a", "CASE 1", "DEFAULT", "ENDSWITCH",
+    "WAIT(3)", "P1->x := 5 + a", "a := a + 1", "a := g(a)", "f()",
+    "", "; comment", ")", "{",
+    // longer than the spare ids of a line
+    "P1->y := 1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 + 10 + 11 + 12 + 13 + 14 + 15 + 16 + 17 + 18 + 19 + 20 ; and a comment",
+};
+
+std::string join(const std::vector<std::string>& lines){
+    std::string text;
+    for(const auto& line : lines){
+        text += line;
+        text += '\n';
+    }
+    return text;
+}
+
+std::vector<std::string> split(const std::string& text){
+    std::vector<std::string> lines;
+    std::istringstream stream(text);
+    std::string line;
+    while(std::getline(stream, line)){
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+std::string position(const common::LocationTable& locations, common::LocationId id){
+    if(id == common::NO_LOCATION){
+        return "-";
+    }
+    const auto [line, column] = locations.lineColumn(id);
+    return std::to_string(line) + ":" + std::to_string(column);
+}
+
+// every node with its position, in post-order
+std::string treeOf(grs_ast::FunctionBlock& program, const common::LocationTable& locations){
+    const grs_ast::FlatAst flat = grs_ast::FlatAst::fromTree(program);
+    std::ostringstream out;
+    for(grs_ast::NodeId node = 0; node < flat.size(); ++node){
+        out << static_cast<int>(flat.getKind(node)) << '@' << position(locations, flat.getLocation(node));
+        switch(flat.getKind(node)){
+            case grs_ast::ASTNodeType::VariableExpression:
+                out << ' ' << flat.getName(flat.getVariable(node).name);
+                break;
+            case grs_ast::ASTNodeType::VariableDeclaration:
+                out << ' ' << flat.getName(flat.getVariableDecl(node).name);
+                break;
+            case grs_ast::ASTNodeType::FunctionDeclaration:
+                out << ' ' << flat.getName(flat.getFunction(node).name);
+                break;
+            case grs_ast::ASTNodeType::CallExpression:
+                out << ' ' << flat.getName(flat.getCall(node).name);
+                break;
+            case grs_ast::ASTNodeType::LiteralExpression:
+                std::visit([&out](const auto& value){
+                    if constexpr(std::is_arithmetic_v<std::decay_t<decltype(value)>>) out << ' ' << value;
+                }, flat.getLiteral(node));
+                break;
+            default:
+                break;
+        }
+        out << '\n';
+    }
+    return out.str();
+}
+
+std::string errorsOf(const std::vector<grs_parser::ParserError>& errors){
+    std::string text;
+    for(const auto& error : errors){
+        text += std::to_string(error.line) + ":" + std::to_string(error.column) + " " + error.message + "\n";
+    }
+    return text;
+}
+
+std::string tokensOf(const std::vector<grs_lexer::Token>& tokens){
+    std::string text;
+    for(const auto& token : tokens){
+        text += std::to_string(static_cast<int>(token.getType())) + " '" + std::string(token.getValue()) + "' "
+              + std::to_string(token.getLine()) + ":" + std::to_string(token.getColumn()) + "\n";
+    }
+    return text;
+}
+
+// prints what differs; true when the incremental state matches `lines`
+bool matches(const std::string& name, const grs_parser::IncrementalParser& incremental,
+             const std::vector<std::string>& lines){
+    const std::string text = join(lines);
+    grs_lexer::SourceBuffer buffer(text, name);
+    grs_lexer::Lexer lexer;
+    const std::vector<grs_lexer::Token> tokens = lexer.tokenize(buffer);
+    grs_parser::Parser parser;
+    parser.setLazyBodies(false);
+    common::LocationTable locations;
+    parser.setLocations(&locations, locations.addFile(name, text));
+    auto program = parser.parse(tokens);
+
+    const std::pair<const char*, std::pair<std::string, std::string>> checks[] = {
+        {"tree", {treeOf(*incremental.getProgram(), incremental.getLocations()), treeOf(*program.get(), locations)}},
+        {"errors", {errorsOf(incremental.getErrors()), errorsOf(parser.getErrors())}},
+        {"tokens", {tokensOf(incremental.getTokens()), tokensOf(tokens)}},
+    };
+    for(const auto& [what, sides] : checks){
+        if(sides.first != sides.second){
+            std::cerr << name << ": " << what << " differs from a full parse of\n" << text
+                      << "--- incremental\n" << sides.first << "--- full\n" << sides.second;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Applies `edits` random edits to `lines`, each followed by a comparison;
+// the replacement lines come from POOL and from the program itself
+bool edit(const std::string& name, std::vector<std::string> lines, int edits, std::mt19937& random){
+    grs_parser::IncrementalParser incremental;
+    grs_ast::FunctionBlock* const program = incremental.load(join(lines));
+    if(!matches(name + " as loaded", incremental, lines)){
+        return false;
+    }
+    const std::vector<std::string> own = lines;
+    for(int i = 0; i < edits; ++i){
+        const int count = static_cast<int>(lines.size());
+        const int first = 1 + static_cast<int>(random() % (count + 1));
+        const int last = first - 1 + (first <= count ? static_cast<int>(random() % std::min(3, count - first + 2)) : 0);
+        std::vector<std::string> added(random() % 3);
+        for(auto& line : added){
+            line = !own.empty() && random() % 3 == 0 ? own[random() % own.size()] : POOL[random() % std::size(POOL)];
+        }
+
+        if(incremental.applyEdit({first, last, join(added)}) != program){
+            std::cerr << name << ": the edit replaced the program's block\n";
+            return false;
+        }
+        lines.erase(lines.begin() + (first - 1), lines.begin() + last);
+        lines.insert(lines.begin() + (first - 1), added.begin(), added.end());
+        if(!matches(name + " after edit " + std::to_string(i) + " of lines " + std::to_string(first) + "-" +
+                    std::to_string(last), incremental, lines)){
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+    if(argc < 2){
+        std::cerr << "usage: incremental_parser_equivalence <dir with *.txt programs>\n";
+        return 2;
+    }
+
+    std::vector<std::filesystem::path> files;
+    for(const auto& entry : std::filesystem::directory_iterator(argv[1])){
+        if(entry.is_regular_file() && entry.path().extension() == ".txt"){
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    if(files.empty()){
+        std::cerr << "no *.txt programs in " << argv[1] << "\n";
+        return 2;
+    }
+
+    std::mt19937 random(3);
+    int failed = 0;
+    int edits = 0;
+    for(const auto& path : files){
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream text;
+        text << file.rdbuf();
+        failed += !edit(path.filename().string(), split(text.str()), EDITS_PER_FILE, random);
+        edits += EDITS_PER_FILE;
+    }
+    for(int i = 0; i < GENERATED_PROGRAMS; ++i){
+        std::vector<std::string> lines(random() % 30);
+        for(auto& line : lines){
+            line = POOL[random() % std::size(POOL)];
+        }
+        failed += !edit("generated #" + std::to_string(i), lines, EDITS_PER_PROGRAM, random);
+        edits += EDITS_PER_PROGRAM;
+    }
+
+    // an edit out of range is refused and leaves the program as it was
+    grs_parser::IncrementalParser incremental;
+    incremental.load("DEF f()\nEND\n");
+    try{
+        incremental.applyEdit({4, 4, "LIN P1"});
+        std::cerr << "an edit past the end was applied\n";
+        failed++;
+    } catch(const std::out_of_range&){
+        failed += !matches("refused edit", incremental, {"DEF f()", "END"});
+    }
+
+    std::cout << edits << " random edits in " << files.size() + GENERATED_PROGRAMS << " programs, "
+              << failed << " programs differ from a full parse\n";
+    return failed == 0 ? 0 : 1;
+}
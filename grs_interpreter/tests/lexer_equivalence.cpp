@@ -0,0 +1,327 @@
+// Checks the DFA lexer against the regex lexer it replaced: both must
+// produce the same type, value, line and column for every token.
+// Run as ./lexer_equivalence <dir>; every *.txt in <dir> is compared,
+// followed by a few inline cases for the trickier patterns. Then all of
+// them, repeated into a text large enough to be split, must come out of
+// Lexer::tokenizeParallel exactly as out of tokenize().
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "lexer/lexer.hpp"
+#include "lexer/source_buffer.hpp"
+
+namespace {
+
+using grs_lexer::TokenType;
+
+struct RefToken {
+    TokenType type;
+    std::string value;
+    int line;
+    int column;
+};
+
+// The pattern table and loop of the original regex lexer, kept as the
+// reference implementation
+class RegexLexer {
+public:
+    RegexLexer(){
+        initTokenPatterns();
+        initKeywords();
+    }
+
+    std::vector<RefToken> tokenize(const std::string& code)const{
+        std::vector<RefToken> tokens;
+        std::istringstream stream(code);
+        std::string line;
+        int lineNumber = 1;
+
+        while(std::getline(stream, line)){
+            int columnNumber = 1;
+            size_t pos = 0;
+            const size_t lineLength = line.size();
+
+            if(line.empty()){
+                tokens.push_back({TokenType::ENDOFLINE, "\n", lineNumber, columnNumber});
+                lineNumber++;
+                continue;
+            }
+
+            while(pos < lineLength){
+                while(pos < lineLength && isspace(static_cast<unsigned char>(line[pos]))){
+                    columnNumber++;
+                    pos++;
+                }
+                if(pos >= lineLength) break;
+
+                bool found = false;
+                const char* start = line.c_str() + pos;
+                const char* end = line.c_str() + lineLength;
+
+                // patterns in order of priority
+                for(const auto& [pattern, type] : patterns_){
+                    std::cmatch match;
+                    if(!std::regex_search(start, end, match, pattern, std::regex_constants::match_continuous)){
+                        continue;
+                    }
+                    std::string value = match.str();
+                    TokenType actualType = type;
+                    if(type == TokenType::IDENTIFIER){
+                        auto it = keywords_.find(value);
+                        if(it != keywords_.end()){
+                            actualType = it->second;
+                        }
+                    }
+                    tokens.push_back({actualType, value, lineNumber, columnNumber});
+                    pos += match.length();
+                    columnNumber += static_cast<int>(match.length());
+                    found = true;
+
+                    // a comment runs to the end of the line
+                    if(actualType == TokenType::SEMICOLON){
+                        pos = lineLength;
+                    }
+                    break;
+                }
+
+                if(!found){
+                    size_t invalidLength = 1;
+                    while(pos + invalidLength < lineLength && !isspace(static_cast<unsigned char>(line[pos + invalidLength]))){
+                        invalidLength++;
+                    }
+                    tokens.push_back({TokenType::INVALID, line.substr(pos, invalidLength), lineNumber, columnNumber});
+                    pos += invalidLength;
+                    columnNumber += static_cast<int>(invalidLength);
+                }
+            }
+
+            tokens.push_back({TokenType::ENDOFLINE, "\n", lineNumber, columnNumber});
+            lineNumber++;
+        }
+
+        tokens.push_back({TokenType::ENDOFFILE, "", lineNumber, 1});
+        return tokens;
+    }
+
+private:
+    std::vector<std::pair<std::regex, TokenType>> patterns_;
+    std::unordered_map<std::string, TokenType> keywords_;
+
+    void initTokenPatterns(){
+        patterns_.emplace_back(std::regex(R"(\$IN\[[0-9]+\])"), TokenType::GIN);
+        patterns_.emplace_back(std::regex(R"(\$OUT\[[0-9]+\])"), TokenType::GOUT);
+        patterns_.emplace_back(std::regex(R"(:=|:)"), TokenType::ASSIGN);
+        patterns_.emplace_back(std::regex(R"(=)"), TokenType::EQUAL);
+        patterns_.emplace_back(std::regex(R"(<>)"), TokenType::NOTEQUAL);
+        patterns_.emplace_back(std::regex(R"(<=)"), TokenType::LESSEQ);
+        patterns_.emplace_back(std::regex(R"(>=)"), TokenType::GREATEREQ);
+        patterns_.emplace_back(std::regex(R"(\+)"), TokenType::PLUS);
+        patterns_.emplace_back(std::regex(R"(->)"), TokenType::ARROW);
+        patterns_.emplace_back(std::regex(R"(-)"), TokenType::MINUS);
+        patterns_.emplace_back(std::regex(R"(\*)"), TokenType::MULTIPLY);
+        patterns_.emplace_back(std::regex(R"(/)"), TokenType::DIVIDE);
+        patterns_.emplace_back(std::regex(R"(<)"), TokenType::LESS);
+        patterns_.emplace_back(std::regex(R"(>)"), TokenType::GREATER);
+        patterns_.emplace_back(std::regex(R"(\bAND\b)"), TokenType::AND);
+        patterns_.emplace_back(std::regex(R"(\bOR\b)"), TokenType::OR);
+        patterns_.emplace_back(std::regex(R"(\bNOT\b)"), TokenType::NOT);
+        // float before int
+        patterns_.emplace_back(std::regex(R"([0-9]+\.[0-9]+([eE][+-]?[0-9]+)?)"), TokenType::FLOAT);
+        patterns_.emplace_back(std::regex(R"([0-9]+)"), TokenType::INTEGER);
+        patterns_.emplace_back(std::regex(R"("([^"\\]|\\.)*")"), TokenType::STRING);
+        patterns_.emplace_back(std::regex(R"(&)"), TokenType::AMPERSAND);
+        patterns_.emplace_back(std::regex(R"(\()"), TokenType::LPAREN);
+        patterns_.emplace_back(std::regex(R"(\))"), TokenType::RPAREN);
+        patterns_.emplace_back(std::regex(R"(\{)"), TokenType::LBRACE);
+        patterns_.emplace_back(std::regex(R"(\})"), TokenType::RBRACE);
+        patterns_.emplace_back(std::regex(R"(,)"), TokenType::COMMA);
+        patterns_.emplace_back(std::regex(R"(;)"), TokenType::SEMICOLON);
+        patterns_.emplace_back(std::regex(R"(')"), TokenType::SINGLEQUOTE);
+        patterns_.emplace_back(std::regex(R"(\r\n|\n|\r)"), TokenType::ENDOFLINE);
+        patterns_.emplace_back(std::regex(R"([A-Za-z_][A-Za-z0-9_]*)"), TokenType::IDENTIFIER);
+    }
+
+    void initKeywords(){
+        const std::pair<const char*, TokenType> words[] = {
+            {"DEF", TokenType::DEF}, {"END", TokenType::END}, {"DECL", TokenType::DECL},
+            {"INT", TokenType::INT}, {"REAL", TokenType::REAL}, {"BOOL", TokenType::BOOL},
+            {"CHAR", TokenType::CHAR}, {"IF", TokenType::IF}, {"THEN", TokenType::THEN},
+            {"ELSE", TokenType::ELSE}, {"ENDIF", TokenType::ENDIF}, {"FOR", TokenType::FOR},
+            {"TO", TokenType::TO}, {"STEP", TokenType::STEP}, {"ENDFOR", TokenType::ENDFOR},
+            {"WHILE", TokenType::WHILE}, {"ENDWHILE", TokenType::ENDWHILE},
+            {"REPEAT", TokenType::REPEAT}, {"UNTIL", TokenType::UNTIL},
+            {"SWITCH", TokenType::SWITCH}, {"CASE", TokenType::CASE},
+            {"DEFAULT", TokenType::DEFAULT}, {"ENDSWITCH", TokenType::ENDSWITCH},
+            {"GOTO", TokenType::GOTO}, {"HALT", TokenType::HALT}, {"RETURN", TokenType::RETURN},
+            {"PTP", TokenType::PTP}, {"LIN", TokenType::LIN}, {"CIRC", TokenType::CIRC},
+            {"SPLINE", TokenType::SPLINE}, {"PTP_REL", TokenType::PTP_REL},
+            {"LIN_REL", TokenType::LIN_REL}, {"CIRC_REL", TokenType::CIRC_REL},
+            {"SPLINE_REL", TokenType::SPLINE_REL}, {"WAIT", TokenType::WAIT},
+            {"DELAY", TokenType::DELAY}, {"FRAME", TokenType::FRAME}, {"AXIS", TokenType::AXIS},
+            {"POS", TokenType::POS}, {"TRUE", TokenType::GTRUE}, {"FALSE", TokenType::GFALSE},
+            {"PI", TokenType::PI},
+        };
+        for(const auto& [word, type] : words){
+            keywords_[word] = type;
+        }
+    }
+};
+
+std::string describe(TokenType type, std::string_view value, int line, int column){
+    std::string text(grs_lexer::typeToStringMap.at(type));
+    text += " '";
+    text += value;
+    text += "' at " + std::to_string(line) + ":" + std::to_string(column);
+    return text;
+}
+
+// prints the first mismatch; true when the streams are identical
+bool compare(const std::string& name, const std::string& text){
+    const std::vector<RefToken> expected = RegexLexer().tokenize(text);
+    grs_lexer::SourceBuffer buffer(text, name);
+    grs_lexer::Lexer lexer;
+    const std::vector<grs_lexer::Token> actual = lexer.tokenize(buffer);
+
+    const size_t count = std::min(expected.size(), actual.size());
+    for(size_t i = 0; i < count; ++i){
+        const RefToken& want = expected[i];
+        const grs_lexer::Token& got = actual[i];
+        if(want.type != got.getType() || want.value != got.getValue()
+           || want.line != got.getLine() || want.column != got.getColumn()){
+            std::cerr << name << ": token " << i << " is "
+                      << describe(got.getType(), got.getValue(), got.getLine(), got.getColumn())
+                      << ", expected " << describe(want.type, want.value, want.line, want.column) << "\n";
+            return false;
+        }
+    }
+    if(expected.size() != actual.size()){
+        std::cerr << name << ": " << actual.size() << " tokens, expected " << expected.size() << "\n";
+        return false;
+    }
+    return true;
+}
+
+const std::pair<const char*, const char*> INLINE_CASES[] = {
+    {"io", "$IN[1] $OUT[12] := $IN[0]\n$IN[] $OUT[x] $IN [2]\n"},
+    {"assign", "a := 1\nb:2\nc = 3\nd :== 4\n"},
+    {"compare", "a <> b <= c >= d < e > f -> g <>= h\n"},
+    {"float", "1.5 2.0e10 3.25E-4 4.5e+3 5.e3 6e7 7.8e 9.0E+\n"},
+    {"comment", "a := 1 ; b := 2 \"x\"\n;\n  ; indented\nc ;\n"},
+    {"words", "AND ANDY a AND b NOT_x OR1 _OR PTP_REL SPLINE\n"},
+    {"strings", "\"a\\\"b\" \"unterminated\n'c' \"\\\\\"\n"},
+    {"invalid", "# @x y ?z\n\xc3\xbc\n"},
+    {"lines", "\n\nDEF a()\r\n  \t\nEND"},
+};
+
+// tokenizeParallel only splits when every worker gets this much text
+constexpr size_t PARALLEL_MIN_CHUNK = 256 * 1024;
+const unsigned WORKER_COUNTS[] = {2, 3, 4, 7};
+
+// `corpus` repeated until 7 workers get a chunk each, with a comment line
+// longer than a chunk in the middle; ends without a newline
+std::string parallelInput(const std::string& corpus){
+    std::string text;
+    while(text.size() < 8 * PARALLEL_MIN_CHUNK){
+        text += corpus;
+        if(text.size() > 4 * PARALLEL_MIN_CHUNK && text.size() < 5 * PARALLEL_MIN_CHUNK){
+            text += "; " + std::string(PARALLEL_MIN_CHUNK + PARALLEL_MIN_CHUNK / 2, 'x') + "\n";
+        }
+    }
+    return text + "END";
+}
+
+// prints the first mismatch; true when tokenizeParallel gives tokenize()'s
+// tokens, symbol ids and symbol table
+bool compareParallel(const std::string& text, unsigned threads){
+    const std::string name = "parallel, " + std::to_string(threads) + " workers";
+    grs_lexer::SourceBuffer buffer(text, name);
+    grs_lexer::Lexer serial;
+    const std::vector<grs_lexer::Token> expected = serial.tokenize(buffer);
+    grs_lexer::Lexer parallel;
+    const std::vector<grs_lexer::Token> actual = parallel.tokenizeParallel(buffer, threads);
+
+    const size_t count = std::min(expected.size(), actual.size());
+    for(size_t i = 0; i < count; ++i){
+        const grs_lexer::Token& want = expected[i];
+        const grs_lexer::Token& got = actual[i];
+        if(want.getType() != got.getType() || want.getValue() != got.getValue() || want.getLine() != got.getLine()
+           || want.getColumn() != got.getColumn() || want.getSymbol() != got.getSymbol()){
+            std::cerr << name << ": token " << i << " is "
+                      << describe(got.getType(), got.getValue(), got.getLine(), got.getColumn())
+                      << " #" << got.getSymbol() << ", expected "
+                      << describe(want.getType(), want.getValue(), want.getLine(), want.getColumn())
+                      << " #" << want.getSymbol() << "\n";
+            return false;
+        }
+    }
+    if(expected.size() != actual.size()){
+        std::cerr << name << ": " << actual.size() << " tokens, expected " << expected.size() << "\n";
+        return false;
+    }
+
+    const grs_lexer::SymbolTable& want = serial.getSymbols();
+    const grs_lexer::SymbolTable& got = parallel.getSymbols();
+    if(want.size() != got.size()){
+        std::cerr << name << ": " << got.size() << " symbols, expected " << want.size() << "\n";
+        return false;
+    }
+    for(grs_lexer::SymbolId id = 1; id <= want.size(); ++id){
+        if(want.name(id) != got.name(id)){
+            std::cerr << name << ": symbol " << id << " is '" << got.name(id) << "', expected '" << want.name(id) << "'\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+    if(argc < 2){
+        std::cerr << "usage: lexer_equivalence <dir with *.txt programs>\n";
+        return 2;
+    }
+
+    std::vector<std::filesystem::path> files;
+    for(const auto& entry : std::filesystem::directory_iterator(argv[1])){
+        if(entry.is_regular_file() && entry.path().extension() == ".txt"){
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    if(files.empty()){
+        std::cerr << "no *.txt programs in " << argv[1] << "\n";
+        return 2;
+    }
+
+    int failed = 0;
+    std::string corpus;
+    for(const auto& path : files){
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream text;
+        text << file.rdbuf();
+        if(!compare(path.filename().string(), text.str())) failed++;
+        corpus += text.str() + "\n";
+    }
+    for(const auto& [name, text] : INLINE_CASES){
+        if(!compare(name, text)) failed++;
+        corpus += std::string(text) + "\n";
+    }
+
+    const std::string large = parallelInput(corpus);
+    for(unsigned threads : WORKER_COUNTS){
+        if(!compareParallel(large, threads)) failed++;
+    }
+
+    const size_t total = files.size() + std::size(INLINE_CASES) + std::size(WORKER_COUNTS);
+    std::cout << total - failed << " of " << total << " inputs lex the same\n";
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+// A variable the host changes through Vm::setVariable while the program
+// waits must be read again afterwards, even though the program itself
+// never assigns it: the optimizer may only treat it as a constant up to
+// the first MOTION or WAIT, including one inside a called DEF.
+// Run as ./optimizer_host_write; exits non-zero on the first failure.
+#include <iostream>
+#include <string>
+#include <variant>
+
+#include "ast/optimizer.hpp"
+#include "lexer/lexer.hpp"
+#include "lexer/source_buffer.hpp"
+#include "parser/parser.hpp"
+#include "vm/compiler.hpp"
+#include "vm/type_checker.hpp"
+#include "vm/vm.hpp"
+
+namespace {
+
+// `sel` is read before the WAIT (and may be folded there) and after it
+const char* const DIRECT =
+    "DEF main()\n"
+    "DECL INT sel := 0\n"
+    "DECL INT r := 0\n"
+    "DECL INT before := 0\n"
+    "before := sel + 1\n"
+    "WAIT(0)\n"
+    "IF sel = 1 THEN\n"
+    "r := 5\n"
+    "ELSE\n"
+    "r := 7\n"
+    "ENDIF\n"
+    "END\n";
+
+const char* const THROUGH_CALL =
+    "DEF main()\n"
+    "DECL INT sel := 0\n"
+    "DECL INT r := 0\n"
+    "DECL INT before := 0\n"
+    "before := sel + 1\n"
+    "pause()\n"
+    "IF sel = 1 THEN\n"
+    "r := 5\n"
+    "ELSE\n"
+    "r := 7\n"
+    "ENDIF\n"
+    "END\n"
+    "DEF pause()\n"
+    "WAIT(0)\n"
+    "END\n";
+
+double numberOf(const common::ValueType& value){
+    if(auto val = std::get_if<int>(&value)) return *val;
+    if(auto val = std::get_if<double>(&value)) return *val;
+    if(auto val = std::get_if<bool>(&value)) return *val ? 1.0 : 0.0;
+    return -1.0;
+}
+
+// runs `text` optimized; when `write`, sets sel to 1 at the WAIT.
+// Returns r, or -1 if the program does not compile.
+double run(const char* text, bool write, size_t& propagated){
+    grs_lexer::SourceBuffer buffer(text);
+    grs_lexer::Lexer lexer;
+    auto tokens = lexer.tokenize(buffer);
+    grs_parser::Parser parser;
+    parser.setLazyBodies(false);
+    auto program = parser.parse(tokens);
+    if(!program || !parser.getErrors().empty()){
+        return -1.0;
+    }
+    grs_ast::Optimizer optimizer;
+    propagated = optimizer.optimize(program.get(), *program.getArena()).propagatedConstants;
+    grs_vm::TypeChecker checker;
+    if(!checker.check(program.get())){
+        return -1.0;
+    }
+    const grs_vm::Chunk chunk = grs_vm::Compiler().compile(program.get());
+
+    grs_vm::Vm vm(chunk);
+    while(const grs_interpreter::Instruction* command = vm.next()){
+        if(write && command->op == grs_interpreter::Opcode::WAIT){
+            vm.setVariable("sel", grs_lexer::TokenType::INT, 1);
+        }
+    }
+    return numberOf(vm.getVariable("r"));
+}
+
+bool expect(const char* name, const char* text, bool write, double expected){
+    size_t propagated = 0;
+    const double r = run(text, write, propagated);
+    if(r != expected){
+        std::cerr << name << (write ? " with" : " without") << " host write: r = " << r
+                  << ", expected " << expected << "\n";
+        return false;
+    }
+    // the read before the WAIT is still folded
+    if(propagated != 1){
+        std::cerr << name << ": " << propagated << " constants propagated, expected 1\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(){
+    int failed = 0;
+    failed += !expect("direct WAIT", DIRECT, true, 5.0);
+    failed += !expect("direct WAIT", DIRECT, false, 7.0);
+    failed += !expect("WAIT in a called DEF", THROUGH_CALL, true, 5.0);
+    failed += !expect("WAIT in a called DEF", THROUGH_CALL, false, 7.0);
+    std::cout << (failed == 0 ? "host writes are seen after a WAIT\n" : "");
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,289 @@
+// Checks the bytecode VM against the instruction generator: for each
+// program the MOTION and WAIT commands (name, arguments, location) must
+// be the same from the generator on the tree, on the optimized tree and
+// on the flat AST, and from the VM running the compiled chunk, run twice.
+// Run as ./vm_equivalence <dir>; every *.txt in <dir> that parses and
+// type-checks is compared, then inline loop, SWITCH and call cases and a
+// fixed-seed batch of generated programs.
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ast/flat_ast.hpp"
+#include "ast/optimizer.hpp"
+#include "interpreter/instruction_generator.hpp"
+#include "lexer/lexer.hpp"
+#include "lexer/source_buffer.hpp"
+#include "parser/parser.hpp"
+#include "vm/compiler.hpp"
+#include "vm/type_checker.hpp"
+#include "vm/vm.hpp"
+
+namespace {
+
+using grs_interpreter::Instruction;
+using grs_interpreter::InstructionList;
+using grs_interpreter::Opcode;
+
+std::string describe(const InstructionList& list, const Instruction& command){
+    std::ostringstream out;
+    out << list.commandName(command);
+    for(const auto& [name, value] : list.arguments(command)){
+        out << ' ' << name << '=';
+        std::visit([&out](const auto& v){ out << v; }, value);
+    }
+    out << " @" << command.location << '\n';
+    return out.str();
+}
+
+std::string commandsOf(const InstructionList& list){
+    std::string text;
+    for(const auto& instruction : list.code){
+        if(instruction.op == Opcode::MOTION || instruction.op == Opcode::WAIT){
+            text += describe(list, instruction);
+        }
+    }
+    return text;
+}
+
+enum class Outcome{ SAME, DIFFERENT, SKIPPED };
+
+// Both sides print their runtime errors; those are not compared
+class Silence{
+    public:
+    Silence() : out_{std::cout.rdbuf(sink_.rdbuf())}, err_{std::cerr.rdbuf(sink_.rdbuf())} {}
+    ~Silence(){
+        std::cout.rdbuf(out_);
+        std::cerr.rdbuf(err_);
+    }
+    private:
+    std::ostringstream sink_;
+    std::streambuf* out_;
+    std::streambuf* err_;
+};
+
+Outcome compare(const std::string& name, const std::string& text, std::uint32_t callDepth){
+    std::string generated, optimized, flat, vm, again;
+    bool rejected = false;
+    {
+        Silence silence;
+        grs_lexer::SourceBuffer buffer(text, name);
+        grs_lexer::Lexer lexer;
+        auto tokens = lexer.tokenize(buffer);
+        grs_parser::Parser parser;
+        common::LocationTable locations;
+        parser.setLocations(&locations, locations.addFile(name, buffer.view()));
+        auto program = parser.parse(tokens);
+
+        grs_interpreter::InstructionGenerator generator;
+        generator.setCallDepthLimit(callDepth);
+        generated = commandsOf(generator.generateInstructions(program.get()));
+
+        grs_ast::Optimizer().optimize(program.get(), *program.getArena());
+        grs_interpreter::InstructionGenerator afterOptimizer;
+        afterOptimizer.setCallDepthLimit(callDepth);
+        optimized = commandsOf(afterOptimizer.generateInstructions(program.get()));
+
+        const grs_ast::FlatAst flatAst = grs_ast::FlatAst::fromTree(*program.get());
+        grs_interpreter::InstructionGenerator flatGenerator;
+        flatGenerator.setCallDepthLimit(callDepth);
+        flat = commandsOf(flatGenerator.generateInstructions(flatAst));
+
+        grs_vm::TypeChecker checker;
+        rejected = !checker.check(program.get()) || parser.hasErrors();
+        if(!rejected){
+            const grs_vm::Chunk chunk = grs_vm::Compiler().compile(program.get());
+            grs_vm::Vm machine(chunk, callDepth);
+            for(std::string* run : {&vm, &again}){
+                machine.reset();
+                while(const Instruction* command = machine.next()){
+                    *run += describe(machine.getCommands(), *command);
+                }
+            }
+        }
+    }
+    if(rejected){
+        return Outcome::SKIPPED;
+    }
+    if(generated == optimized && generated == flat && generated == vm && vm == again){
+        return Outcome::SAME;
+    }
+    std::cerr << name << ": commands differ\n" << text << "--- generator\n" << generated
+              << "--- optimized\n" << optimized << "--- flat AST\n" << flat
+              << "--- VM\n" << vm << "--- VM after reset\n" << again;
+    return Outcome::DIFFERENT;
+}
+
+const std::pair<const char*, const char*> INLINE_CASES[] = {
+    {"counted FOR",
+     "DEF main()\nDECL INT i := 0\nDECL POS P1 := {x 0}\n"
+     "FOR i = 1 TO 4\nP1->x := i * 10\nLIN P1\nENDFOR\n"
+     "FOR i = 10 TO 4.5 STEP -3\nP1->y := i\nPTP P1\nENDFOR\nEND\n"},
+    {"WHILE and REPEAT",
+     "DEF main()\nDECL INT w := 0\nDECL POS P1 := {x 0}\n"
+     "WHILE w < 3\nP1->x := w\nLIN P1\nw := w + 1\nENDWHILE\n"
+     "REPEAT\nw := w - 1\nP1->y := w\nPTP P1\nWAIT(1)\nUNTIL w <= 0\nEND\n"},
+    {"SWITCH",
+     "DEF main()\nDECL INT i := 0\nDECL POS P1 := {x 0}\n"
+     "FOR i = -1 TO 5\nSWITCH i\nCASE 1\nP1->x := 1\nCASE 3, 4\nP1->x := 34\nCASE -1\nP1->x := -1\n"
+     "DEFAULT\nP1->x := 99\nENDSWITCH\nLIN P1\nENDFOR\nEND\n"},
+    {"recursion",
+     "DEF main()\nDECL INT a := 0\nDECL POS P1 := {x 0}\n"
+     "a := fact(5)\nP1->x := a\nLIN P1\nEND\n"
+     "DEF INT fact(INT n)\nDECL POS Q := {x 0}\nQ->x := n\nLIN Q\n"
+     "IF n <= 1 THEN\nRETURN 1\nENDIF\nRETURN n * fact(n - 1)\nEND\n"},
+    {"call depth limit",
+     "DEF main()\nDECL INT a := 0\nDECL POS P1 := {x 0}\na := down(400)\nP1->x := a\nLIN P1\nEND\n"
+     "DEF INT down(INT n)\nIF n <= 0 THEN\nRETURN 0\nENDIF\nRETURN down(n - 1) + 1\nEND\n"},
+    {"INT conversion",
+     "DEF main()\nDECL INT a := 0\nDECL REAL r := 3.0e9\nDECL POS P1 := {x 0}\n"
+     "a := r\nP1->x := a\na := -r\nP1->y := a\na := 7.9\nP1->z := a\nLIN P1\n"
+     "a := big(r)\nP1->x := a\nLIN P1\nEND\n"
+     "DEF INT big(REAL v)\nRETURN v\nEND\n"},
+};
+
+// Programs built from the statements below, with IF, loops and SWITCH
+// nested up to three deep; main calls DEFs with parameters, locals,
+// early RETURNs and recursion. Each nesting depth has its own loop
+// counters, so an inner loop cannot keep an outer one going, and f has
+// no loops since main calls it from inside its own.
+class ProgramGenerator{
+    public:
+    explicit ProgramGenerator(unsigned seed) : rng_{seed} {}
+
+    std::string next(){
+        std::string text = "DEF main()\nDECL INT a := " + std::to_string(rng_() % 5) +
+                           "\nDECL REAL b := 2\nDECL INT i := 0\nDECL INT j := 0\n"
+                           "DECL POS P1 := {x 1, y 2, z 3}\nDECL AXIS X1 := {A1 1, A2 2}\n";
+        for(int depth = 0; depth < 3; ++depth){
+            for(const char* counter : {"k", "m", "w"}){
+                text += "DECL INT " + std::string(counter) + std::to_string(depth) + " := 0\n";
+            }
+        }
+        text += block(0, MAIN, true) + "END\n";
+        text += "DEF INT f(INT x, REAL y)\nDECL INT t := x\nDECL REAL u := 0\n" + block(1, BODY, false) + "RETURN t + u\nEND\n";
+        text += "DEF REAL g(REAL x)\nIF x > 100 THEN\nRETURN 100\nENDIF\nRETURN x / 2 * 3 + 1\nEND\n";
+        text += "DEF INT rec(INT n)\nDECL INT t := 0\nDECL POS Q := {x 0}\nQ->x := n\n"
+                "IF n > 0 THEN\nt := rec(n - 1)\nENDIF\nIF n < 3 THEN\nLIN Q\nENDIF\nRETURN t + n\nEND\n";
+        return text;
+    }
+
+    private:
+    std::mt19937 rng_;
+
+    const std::vector<std::string> MAIN = {
+        "a := f(a, b)", "b := g(b) + f(1, 2)", "P1->x := f(a, 2) * 2", "LIN P1", "PTP P1", "CIRC X1",
+        "P1->y := rec(a)", "a := rec(i) + 1", "b := g(g(b / 3))", "a := a + 1", "WAIT(1)",
+        "P1->z := -b + 2 * 3", "X1->a4 := 10 * 2 + a", "b := b / (a - 3)", "P1->x := i * 2 + j",
+        "a := a * PI", "IF NOT (a < 2) AND b >= 1 OR a = 4 THEN\nLIN P1\nENDIF",
+    };
+    const std::vector<std::string> BODY = {
+        "t := t + x", "t := t * 2 - y", "P1->z := x + t", "LIN P1", "b := b + x", "WAIT(2)",
+        "IF x > 2 THEN\nRETURN x * 3\nENDIF", "IF t > 20 THEN\nRETURN t\nENDIF", "u := g(y) + t",
+    };
+    const char* const CONDITIONS[4] = {"a > 2", "b <> 5", "a * 2 >= b - 1", "(a < 2) AND b >= 1 OR a = 4"};
+
+    std::string block(int depth, const std::vector<std::string>& pool, bool loops){
+        const std::string level = std::to_string(depth);
+        std::string text;
+        const unsigned count = rng_() % 7;
+        for(unsigned k = 0; k < count; ++k){
+            unsigned kind = depth < 3 ? rng_() % 10 : 9;
+            if(!loops && kind >= 1 && kind <= 4){
+                kind = 9;
+            }
+            switch(kind){
+                case 0:
+                    text += std::string("IF ") + CONDITIONS[rng_() % 4] + " THEN\n" + block(depth + 1, pool, loops);
+                    if(rng_() % 2) text += "ELSE\n" + block(depth + 1, pool, loops);
+                    text += "ENDIF\n";
+                    break;
+                case 1:
+                    text += "FOR k" + level + " = " + std::to_string(static_cast<int>(rng_() % 4) - 1) + " TO " +
+                            std::to_string(rng_() % 4) + "\n" + block(depth + 1, pool, loops) + "ENDFOR\n";
+                    break;
+                case 2:
+                    text += "FOR m" + level + " = 10 TO 4.5 STEP -" + std::to_string(1 + rng_() % 3) + "\n" +
+                            block(depth + 1, pool, loops) + "ENDFOR\n";
+                    break;
+                case 3:
+                    text += "w" + level + " := 0\nWHILE w" + level + " < 3 AND a < 50\n" + block(depth + 1, pool, loops) +
+                            "w" + level + " := w" + level + " + 1\nENDWHILE\n";
+                    break;
+                case 4:
+                    text += "w" + level + " := 0\nREPEAT\n" + block(depth + 1, pool, loops) +
+                            "w" + level + " := w" + level + " + 1\nUNTIL w" + level + " >= 2 OR a > 40\n";
+                    break;
+                case 5:
+                    text += "SWITCH a\nCASE 1\n" + block(depth + 1, pool, loops) + "CASE 3, 4\n" + block(depth + 1, pool, loops);
+                    if(rng_() % 2) text += "DEFAULT\n" + block(depth + 1, pool, loops);
+                    text += "ENDSWITCH\n";
+                    break;
+                default:
+                    text += pool[rng_() % pool.size()] + "\n";
+                    break;
+            }
+        }
+        return text;
+    }
+};
+
+constexpr int GENERATED_PROGRAMS = 300;
+
+} // namespace
+
+int main(int argc, char** argv){
+    if(argc < 2){
+        std::cerr << "usage: vm_equivalence <dir with *.txt programs>\n";
+        return 2;
+    }
+
+    std::vector<std::filesystem::path> files;
+    for(const auto& entry : std::filesystem::directory_iterator(argv[1])){
+        if(entry.is_regular_file() && entry.path().extension() == ".txt"){
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    int same = 0, different = 0, skipped = 0;
+    const auto count = [&](Outcome outcome){
+        same += outcome == Outcome::SAME;
+        different += outcome == Outcome::DIFFERENT;
+        skipped += outcome == Outcome::SKIPPED;
+    };
+
+    for(const auto& path : files){
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream text;
+        text << file.rdbuf();
+        count(compare(path.filename().string(), text.str(), common::DEFAULT_CALL_DEPTH));
+    }
+    const int fromFiles = same;
+    for(const auto& [name, text] : INLINE_CASES){
+        // the inline cases must all run
+        const Outcome outcome = compare(name, text, 64);
+        if(outcome == Outcome::SKIPPED){
+            std::cerr << name << ": does not compile\n";
+            different++;
+        } else {
+            count(outcome);
+        }
+    }
+    ProgramGenerator programs(7);
+    for(int i = 0; i < GENERATED_PROGRAMS; ++i){
+        // every fourth one with a small call depth limit, so the limit is hit
+        count(compare("generated #" + std::to_string(i), programs.next(), i % 4 == 0 ? 5 : common::DEFAULT_CALL_DEPTH));
+    }
+
+    std::cout << same << " programs run the same (" << fromFiles << " from " << argv[1] << "), "
+              << different << " differ, " << skipped << " do not compile\n";
+    return different == 0 && fromFiles > 0 && skipped < GENERATED_PROGRAMS / 10 ? 0 : 1;
+}